@@ -3,7 +3,8 @@
 #PJM -L "rscgrp=lecture"
 #PJM -L "node=1"
 #PJM --mpi "proc=4"
+#PJM --omp "thread=1"
 #PJM -L "elapse=00:15:00"
 #PJM -j
 
-mpiexec.hydra -n ${PJM_MPI_PROC} ../../../Debug/abmac2d ../case.txt
+mpiexec.hydra -n ${PJM_MPI_PROC} ../../../Debug/abmac2d ../case.txt ${OMP_NUM_THREADS}
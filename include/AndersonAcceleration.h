@@ -0,0 +1,99 @@
+/*
+ * AndersonAcceleration.h
+ */
+
+#ifndef ANDERSONACCELERATION_H_
+#define ANDERSONACCELERATION_H_
+
+#include <AlignedAllocator.h>
+#include <cstddef>
+#include <vector>
+
+/*
+ * 不動点反復 x -> g(x) を Anderson 法で加速するクラス。
+ *
+ * 反復 k の前の値を x_k、反復後の値を g_k、残差を f_k = g_k - x_k とし、直近 depth 回分の
+ * 差分 dF_j = f_{j+1} - f_j, dG_j = g_{j+1} - g_j を覚えておく。
+ * |f_k - sum_j gamma_j dF_j| を最小にする係数 gamma を求め、次の値を
+ *   x_{k+1} = g_k - sum_j gamma_j dG_j
+ * とする。反復後の値 g_k に加える補正量 dx = -sum_j gamma_j dG_j を extrapolate() で返す。
+ *
+ * 値は各プロセスが自分の分 (要素の圧力など) を持ち、内積は全プロセスの和を使う。
+ * 内積の自プロセス分を localDots() で numDots() 個の配列に書くので、呼び出し側で
+ * 1回の MPI_Allreduce にまとめて足し合わせ、その結果を extrapolate() に渡す。
+ * 内積の行列 (dF_i . dF_j) は履歴が入れ替わるまで変わらないので、新しい差分の分だけを求める。
+ * 係数は全プロセスで同じ値から同じ手順で求めるので、全プロセスで一致する。
+ */
+class AndersonAcceleration {
+public:
+
+    AndersonAcceleration();
+
+    // n 個の値について、直近 depth 回分の差分を覚えられるように確保し、履歴を空にする
+    void init(size_t n, int depth);
+
+    // 履歴を空にする。値の変わり方が変わる時 (速度補正ループの初めなど) に呼ぶ
+    void clear();
+
+    // 覚える差分の数
+    int depth() const { return depth_; }
+    // 今覚えている差分の数
+    int historySize() const { return count_; }
+    // 係数が求まらずに履歴を捨てた回数
+    long restarts() const { return restarts_; }
+
+    // localDots() が書く値の数
+    size_t numDots() const { return 2 * depth_; }
+
+    // 反復の前の値 x を覚える
+    void begin(const double *x);
+    // begin() で覚えた値を x に書き戻す (反復を取り消す場合)
+    void restore(double *x) const;
+
+    // 反復後の値 g から残差と差分を求めて履歴に加え、内積の自プロセス分を dots に書く。
+    //   dots[j]          新しい差分 dF と dF_j の内積
+    //   dots[depth + j]  dF_j と今回の残差 f の内積
+    // 使っていない位置は0。
+    void localDots(const double *g, double *dots);
+
+    // localDots() の値の全プロセスでの和 dots から係数を求め、g に加える補正量を dx に書く。
+    // 補正しない場合 (履歴が空、残差が0、係数が求まらない) は false を返し、dx は変えない。
+    // 係数が求まらない場合は履歴を捨てる。
+    bool extrapolate(const double *dots, double *dx);
+
+    // 使っている配列のバイト数
+    size_t memoryBytes() const;
+
+private:
+
+    size_t n_;
+    int depth_;
+    // 覚えている差分の数と、次に差分を書く位置 (depth_ 個の位置を順に使い回す)
+    int count_;
+    int head_;
+    // 最後に localDots() で書いた位置。差分を書かなかった場合は -1
+    int last_;
+    // 前回の残差と反復後の値があるか
+    bool have_prev_;
+    long restarts_;
+
+    // 反復の前の値、前回の残差と反復後の値、今回の残差
+    AlignedDoubleArray x_;
+    AlignedDoubleArray f_prev_;
+    AlignedDoubleArray g_prev_;
+    AlignedDoubleArray f_;
+    // 位置 j の差分 dF_j, dG_j を [j*n_, (j+1)*n_) に持つ
+    AlignedDoubleArray dF_;
+    AlignedDoubleArray dG_;
+    // 全プロセスでの内積 dF_i . dF_j (depth_ x depth_)
+    std::vector<double> gram_;
+
+    // 位置 (0 .. depth_-1) の差分が今覚えている差分か
+    bool valid(int slot) const;
+
+    // count 元の連立1次方程式 a * x = b を部分ピボット選択付きのGaussの消去法で解く。
+    // a, b は壊れる。解が求まらなければ false を返す
+    static bool solve(int count, std::vector<double> &a, std::vector<double> &b);
+};
+
+#endif /* ANDERSONACCELERATION_H_ */
@@ -5,7 +5,7 @@
 #ifndef _BOUNDARY_H
 #define _BOUNDARY_H
 
-#include <Node.h>
+#include <NodeBlock.h>
 #include <vector>
 
 /*
@@ -25,16 +25,17 @@ public:
     // v(x,y)の係数
     double b0_, b1_, b2_, b3_, b4_, b5_;
 
-    // 境界上の節点の一覧
-    std::vector<Node *> nodes_;
+    // 境界上の節点のローカルな節点番号の一覧
+    std::vector<int> nodes_;
 
-    // 境界に節点を追加する
-    void addNode(Node *node) {
-        nodes_.push_back(node);
+    // 境界に節点をローカルな節点番号で追加する
+    void addNode(int local_index) {
+        nodes_.push_back(local_index);
     }
 
     // 境界上の節点の速度値を多項式により設定する。
-    void apply(double t, double t_ramp);
+    // OpenMPの並列領域の中から呼ぶと、節点をスレッドで分担する (全スレッドから呼ぶこと)。
+    void apply(NodeBlock &nodes, double t, double t_ramp);
 };
 
 #endif
@@ -7,7 +7,7 @@
 
 #include <Params.h>
 #include <State.h>
-#include <Node.h>
+#include <NodeBlock.h>
 #include <vector>
 
 /*
@@ -24,8 +24,8 @@ public:
     // 相手プロセスのrank番号
     int rank_;
 
-    // 相手プロセスとの境界上にあるNodeの一覧
-    std::vector<Node *> nodes_;
+    // 相手プロセスとの境界上にある節点のローカルな節点番号の一覧
+    std::vector<int> nodes_;
 
     // 送信バッファ。質量を送信する場合には質量値を保持する
     // 速度を送信する場合には x成分, y成分 を交互に保持する
@@ -36,21 +36,29 @@ public:
     std::vector<double> recv_buffer_;
 
     // この通信相手との境界上にあると判明したノードを追加する
-    void addNode(Node *node) {
-        nodes_.push_back(node);
+    void addNode(int local_index) {
+        nodes_.push_back(local_index);
+    }
+
+    // 送受信バッファの容量を速度変化量の分 (節点あたり2つと、末尾に付ける値1つ) 確保する。
+    // 以後の gather... でバッファの大きさを変えても、先頭アドレスは変わらない。
+    void reserveBuffers() {
+        send_buffer_.reserve(nodes_.size()*2 + 1);
+        recv_buffer_.reserve(nodes_.size()*2 + 1);
     }
 
     // 境界上のノードの質量値をsend_buffer_に集める
-    void gatherBoundaryNodeMass();
+    void gatherBoundaryNodeMass(const NodeBlock &nodes);
 
     // recv_bufer_に格納された質量値を境界上のノードに分配（加算）する
-    void distributeBoundaryNodeMass();
+    void distributeBoundaryNodeMass(NodeBlock &nodes);
 
     // 境界上のノードの質量値をsend_buffer_に集める
-    void gatherBoundaryNodeVelocityDelta();
+    // piggyback (0 か 1) 個の値を末尾に付け足す。その値は 0 にしておく
+    void gatherBoundaryNodeVelocityDelta(const NodeBlock &nodes, int piggyback = 0);
 
     // recv_bufer_に格納された質量値を境界上のノードに分配（加算）する
-    void distributeBoundaryNodeVelocityDelta();
+    void distributeBoundaryNodeVelocityDelta(NodeBlock &nodes);
 };
 
 /*
@@ -71,29 +79,49 @@ public:
     // CfdCommPeerBufferのコピーコンストラクタが呼ばれる
     std::vector<CfdCommPeerBuffer> peer_buffers_;
 
+    // 速度変化量の送信データの末尾に付け足す値の数 (0 か 1)。
+    // 計算条件の convergence_check_ が piggyback なら 1 で、自プロセスの周りで続けて
+    // 補正が起きなかった反復数 (CfdDriver::correctVelocity() を参照) を載せる。
+    int piggyback_;
+
     // バッファオブジェクトを初期化する。引数に渡されたポインタを記憶するだけ。
     void init(Params *params, State *state);
 
-    // 隣接プロセスとの境界にあると判明したノードを登録する。
+    // 隣接プロセスとの境界にあると判明したノードを、ローカルな節点番号で登録する。
     // この関数の中ではrankに対応するpeer bufferを必要に応じて作成し
     // そのpeer buffer にnodeを登録する。
-    void addBoundaryNode(int rank, Node *node);
+    void addBoundaryNode(int rank, int local_index);
 
     // rankに対応するpeer buffer を検索する。
     // 初出の場合は、新規に作成したうえで返す。(find, or otherwise create)
     CfdCommPeerBuffer *findOrCreatePeerBufferForRank(int rank);
 
+    // 全peerについて、送受信バッファの容量を確保する (CfdCommPeerBuffer::reserveBuffers())。
+    void reserveBuffers();
+
+    // peer と授受する速度変化量の送信データの大きさ (doubleの個数)
+    size_t velocityPayloadSize(const CfdCommPeerBuffer &peer) const {
+        return peer.nodes_.size()*2 + piggyback_;
+    }
+
+    // 全peerについて、速度変化量の送信データの末尾の値を value にする。
+    // gatherBoundaryNodeVelocityDelta() の後に呼ぶ。
+    void setPiggyback(double value);
+
+    // 全peerから受信した速度変化量の末尾の値の最小値。peerがなければ none を返す。
+    double minPiggyback(double none) const;
+
     // 全peerについて、境界ノードの質量をpeer buffer に集め、送信に備える。
-    void gatherBoundaryNodeMass();
+    void gatherBoundaryNodeMass(const NodeBlock &nodes);
 
     // 全peerについて、peer bufferに受信した質量を境界上のノードに加算する。
-    void distributeBoundaryNodeMass();
+    void distributeBoundaryNodeMass(NodeBlock &nodes);
 
     // 全peerについて、境界ノードの速度補正値をpeer buffer に集め、送信に備える。
-    void gatherBoundaryNodeVelocityDelta();
+    void gatherBoundaryNodeVelocityDelta(const NodeBlock &nodes);
 
     // 全peerについて、peer bufferに受信した速度補正値を境界上のノードに加算する。
-    void distributeBoundaryNodeVelocityDelta();
+    void distributeBoundaryNodeVelocityDelta(NodeBlock &nodes);
 };
 
 
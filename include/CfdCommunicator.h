@@ -30,7 +30,6 @@ class CfdCommunicator {
     // std::vectorの要素についてループする時は制御変数は size_t 型がよい。intだと警告が出る。
     size_t i;
     std::vector<MPI_Request> requests;
-    std::vector<MPI_Status> statuses;
 
     int tag;
     int rank,num_procs;
@@ -40,16 +39,136 @@ class CfdCommunicator {
     int send_data_count;
     double *recv_data_addr;
     int recv_data_count;
+
+    // 計算条件の halo_exchange_ が persistent なら true。
+    // neighbor でも、永続的な近傍集団通信 (MPI-4) を使う場合は true。
+    bool persistent_;
+    // 計算条件の halo_exchange_ が neighbor なら true
+    bool neighbor_;
+    // 永続的な送受信要求 (MPI_Send_init / MPI_Recv_init)。initRequests() で作る。
+    // 質量 (節点あたり1つ) と速度変化量 (節点あたり2つ) で別の組を持ち、
+    // peer i の送信が [2*i]、受信が [2*i+1]。
+    // 永続的な近傍集団通信の場合は、それぞれ MPI_Neighbor_alltoallw_init の要求1つ。
+    std::vector<MPI_Request> mass_requests_;
+    std::vector<MPI_Request> velocity_requests_;
+
+    // 近傍集団通信 (neighbor) 用。peer_buffers_ の順に隣接プロセスを並べた分散グラフの
+    // コミュニケータと、peerごとの送受信の個数 (質量、速度変化量)、送受信バッファの絶対アドレス、型
+    MPI_Comm graph_comm_;
+    std::vector<int> mass_counts_;
+    std::vector<int> velocity_counts_;
+    std::vector<MPI_Aint> send_addrs_;
+    std::vector<MPI_Aint> recv_addrs_;
+    std::vector<MPI_Datatype> types_;
+
+    // 共有メモリ (shared) 用。同じノードのプロセスのコミュニケータと、
+    // 各プロセスが MPI_Win_allocate_shared で確保した送信領域のウィンドウ。
+    // 各プロセスの領域は、先頭に公開済みの送受信の回数 (64バイト)、続いて同じノードの
+    // peerごとに、速度変化量の送信データの大きさ (CfdCommData::velocityPayloadSize()) の送信スロットを2つ (送受信の回数の偶奇で交互に使う) 持つ。
+    // 受信側は送信側の領域から直接読む。
+    // スロットが2つあるので、送信側が次に同じスロットに書くのは、受信側が読み終えて
+    // その次の送受信を始めた後になり、受信済みの通知は要らない。
+    MPI_Comm node_comm_;
+    MPI_Win shared_win_;
+    // peer_buffers_ の番号 → 同じノードのpeerの中での番号。別のノードなら -1
+    std::vector<int> shared_index_;
+    // 同じノードのpeerの peer_buffers_ の番号
+    std::vector<size_t> shared_peers_;
+    // 自分の領域の、各peer向けの送信スロット (2つ続けて並ぶ)
+    std::vector<double *> shared_send_;
+    // 各peerの領域の、自分向けの送信スロットと公開済みの送受信の回数
+    std::vector<const double *> shared_recv_;
+    std::vector<volatile long *> shared_published_;
+    // 自分の公開済みの送受信の回数
+    volatile long *published_;
+    // 共有メモリでの送受信の回数
+    long shared_seq_;
+    // startExchange() で始めた送受信要求 (requests, mass_requests_, velocity_requests_ のどれか)
+    std::vector<MPI_Request> *active_requests_;
+
+    // 非同期の速度補正 (correction_async on) 用。送信中のメッセージのバッファと送信要求。
+    // 送信が終わった要素は次の送信に使い回す
+    struct AsyncSend {
+        std::vector<double> buffer_;
+        MPI_Request request_;
+    };
+    std::vector<AsyncSend> async_sends_;
+    // peerごとの、これまでに送った / 受け取ったメッセージの数
+    std::vector<long> async_sent_;
+    std::vector<long> async_received_;
+    // 受信用の作業領域
+    std::vector<double> async_recv_;
+
+    // 送受信の回数と、startExchange(), waitExchange() の中で費やした時間の合計 [s]
+    size_t num_exchanges_;
+    double start_time_;
+    double wait_time_;
+
+    // 永続的な送受信要求を、質量 (velocity が false) または速度変化量の大きさで作る
+    void initPersistentRequests(std::vector<MPI_Request> &reqs, bool velocity);
+    // 近傍集団通信の分散グラフと、送受信の個数・アドレスを用意する
+    void initNeighborExchange();
+    // 同じノードのpeerを調べ、共有メモリのウィンドウを作る
+    void initSharedWindow();
+    // 同じノードのpeerへ送信スロットに書き込んで公開する / peerの公開を待って読む
+    void startSharedExchange();
+    void waitSharedExchange();
+    // 送受信バッファが速度変化量 (CfdCommData::velocityPayloadSize()) の大きさならtrue、質量ならfalse
+    bool isVelocityPayload();
 public:
 
     // 初期化関数
     // 渡されたポインタをメンバ変数に格納する。
     void init(Params *params, State *state, CfdCommData *commData);
 
+    // 隣接プロセスが決まった後 (CfdProcData::findOwnData() の後) に呼ぶ。
+    // 送受信バッファの容量を確保し、計算条件の halo_exchange_ が persistent なら
+    // 全peerとの永続的な送受信要求を、質量と速度変化量の分それぞれ作る。
+    // neighbor なら、隣接プロセスの分散グラフのコミュニケータを作り、以後の送受信を
+    // 近傍集団通信 (MPI_Ineighbor_alltoallw) で行う。
+    // shared なら、同じノードのpeerとは MPI_Win_allocate_shared で確保した共有メモリを
+    // 直接読み書きし、別のノードのpeerとは MPI_Isend / MPI_Irecv で送受信する。
+    // 以後の送受信では、バッファの大きさ (節点あたり1つか2つか) でどちらを使うか決める。
+    void initRequests();
+
+    // 送受信の回数と1回あたりの時間をログに出力し、永続的な送受信要求と
+    // 分散グラフのコミュニケータ、共有メモリのウィンドウを解放する。
+    // MPI_Finalize の前に呼ぶこと。
+    void finalize();
+
+    // 隣接プロセスの関係をグラフとした時の直径 (最も遠いプロセスどうしの間の辺の数) を求める。
+    // つながっていないプロセスどうしは数えない。MPI_COMM_WORLD の全プロセスで呼ぶこと。
+    int peerGraphDiameter();
+
+    /*
+     * 非同期の速度補正 (correction_async on) のための送受信。
+     * 送受信を待ち合わせず、各プロセスは届いている分だけを受け取って補正を続ける。
+     * 送受信バッファの使い方は exchangeBoundaryValues() と同じ。initRequests() の後に使う。
+     */
+    // 各peerの送信バッファの内容を、待ち合わせずに送る (MPI_Isend)。
+    // 送信バッファは戻った後すぐに書き換えてよい
+    void sendAsync();
+    // 各peerから届いているメッセージを全て受け取り、それらの和を受信バッファに入れる。
+    // 受け取ったメッセージの数を返す。何も届いていなければ受信バッファは0になる
+    int receiveAsync();
+    // 各peerと、これまでに送ったメッセージの数を教え合い、まだ届いていない分を待って受け取る。
+    // それらの和を受信バッファに入れ、受け取ったメッセージの数を返す。
+    // 終わった時点で、自プロセスが送ったメッセージも全て送り終えている
+    int finishAsync();
+    // これまでに送った / 受け取ったメッセージの数 (全peerの合計)
+    long asyncSent() const;
+    long asyncReceived() const;
+
     // CfdCommDataが保持するCfdCommPeerBufferが保持する送信データを
     // 全peerプロセスと送受信する。質量データを送受信する場合も、
     // 速度データを送受信する場合も、このメソッドを使う。
     void exchangeBoundaryValues();
+
+    // exchangeBoundaryValues() を2つに分けたもの。startExchange() で全peerとの
+    // 非同期の送受信を始め、waitExchange() でその完了を待つ。間に送受信バッファに
+    // 触れない計算を挟んで、通信と重ねることができる。
+    void startExchange();
+    void waitExchange();
     // void getRankAndProcs();
     void sendDataMPIPre();
     void sendDataMPI();
@@ -35,6 +35,23 @@ class CfdDriver {
     CfdCommData commData_;
 
     int correctVelocityCounter_;
+    // 収束を確かめるまでに余分に行った (何も補正しなかった) 補正の回数。
+    // convergence_check pipelined や convergence_interval 2以上の場合に生じる
+    int extraCorrectionCounter_;
+    // 隣接プロセスのグラフの直径。convergence_check が piggyback の場合に使う
+    int peerDiameter_;
+    // 要素の色の数の全プロセスでの最大値。correction_order が multicolor の場合に使う
+    int numColors_;
+    // active_set on の場合に、各反復の初めに判別式を計算する対象だった要素数の合計と、
+    // 全要素を計算した場合の要素数の合計
+    double activeElementCounter_;
+    double allElementCounter_;
+    // correction_acceleration anderson の場合に、外挿した補正量を加えた反復の数
+    int accelerationCounter_;
+    // correction_solver pcg の場合に、max_corrections に達した時間ステップの数と、
+    // 探索方向と行列の積の内積が正でなく途中で打ち切った時間ステップの数
+    int pressureSolveCapped_;
+    int pressureSolveBreakdowns_;
 
 public:
 
@@ -100,6 +117,12 @@ private:
     // 速度の補正ループ
     void correctVelocity();
 
+    // 隣接プロセスと待ち合わせない速度の補正ループ (correction_async on)
+    void correctVelocityAsync();
+
+    // 圧力補正量を連立1次方程式として解く速度補正 (correction_solver pcg)
+    void correctVelocityPcg();
+
 };
 
 #endif /* CFDDRIVER_H_ */
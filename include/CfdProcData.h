@@ -9,9 +9,13 @@
 #include <State.h>
 
 #include <Node.h>
+#include <NodeBlock.h>
 #include <QuadElement.h>
+#include <ElementBlock.h>
 #include <Boundary.h>
 #include <CfdCommData.h>
+#include <AndersonAcceleration.h>
+#include <PressureSolver.h>
 
 #include <vector>
 
@@ -25,6 +29,8 @@ class CfdProcData {
 
     // テストクラスから当クラスのprivateメンバーにアクセスできるようにするためのfriend宣言
     friend class TestCfdProcData;
+    friend class BenchElementBlock;
+    friend class BenchRelaxation;
 
     // 全プロセス分のノード一覧
     std::vector<Node> nodes_;
@@ -33,6 +39,10 @@ class CfdProcData {
     // 各ポインタの指す先は nodes_ 上の要素
     std::vector<Node *> my_nodes_;
 
+    // 当プロセスに属する節点の質量・速度などの配列。
+    // ローカルな節点番号は my_nodes_ の並び順 (Node::local_index_) と一致する。
+    NodeBlock node_block_;
+
     // 全プロセス分の四角形要素一覧
     std::vector<QuadElement> elements_;
 
@@ -40,9 +50,32 @@ class CfdProcData {
     // 各ポインタの指す先は elements_ 上の要素
     std::vector<QuadElement *> my_elements_;
 
+    // 当プロセスに属する四角形要素のループ不変量と状態変数。
+    // ローカルな要素番号は my_elements_ の並び順と一致する。
+    ElementBlock element_block_;
+
+    // 出力用の並び順。findOwnData() で節点・要素を並べ替えても、VTKファイルや
+    // リスタートファイルはメッシュファイルの順 (全体の番号順) で書くために使う。
+    // node_output_order_[k] はメッシュファイルでk番目に現れる担当節点のローカルな節点番号。
+    // 並べ替えない場合は k そのもの。element_output_order_ も同様。
+    std::vector<int32_t> node_output_order_;
+    std::vector<int32_t> element_output_order_;
+
     // 境界条件の一覧
     std::vector<Boundary> boundaries_;
 
+    // correction_acceleration anderson の場合に、要素の圧力の反復を加速する。
+    // acceleration_ は加速するか (storage lean では加速しない)、
+    // acceleration_dp_ は外挿した圧力の補正量
+    bool acceleration_;
+    AndersonAcceleration anderson_;
+    std::vector<double> acceleration_dp_;
+
+    // correction_solver pcg の場合に、速度補正の圧力補正量を連立1次方程式として解く。
+    // pressure_solve_ は calcInvariants2() で行列を組み立てたか
+    bool pressure_solve_;
+    PressureSolver pressure_solver_;
+
     // 計算条件クラス
     Params *params_;
 
@@ -68,6 +101,7 @@ public:
     void readMeshFile();
 
     // 境界条件ファイルの読み込みを行う。
+    // 境界上の節点はローカルな節点番号で登録するので、findOwnData()の後で呼ぶこと。
     // ファイルのパス名は計算条件オブジェクトから取得する。
     // 例外:
     //   IoException: ファイルが開けない場合
@@ -77,8 +111,31 @@ public:
     // 読み込んだメッシュファイルのデータと、自身のrank番号を元にして
     // 当プロセスで計算を担当すべき四角形要素と節点を特定し、
     // my_elements_, my_nodes_ に格納する。
+    // 特定した節点と要素から node_block_, element_block_ を作成する。
     void findOwnData();
 
+    // findOwnData() の付属関数。計算条件の renumber_ に従って my_nodes_, my_elements_ を
+    // 並べ替え、Node::local_index_ と出力用の並び順を設定する。
+    void renumberOwnData();
+
+    // findOwnData() の付属関数。計算条件の halo_overlap_ が on なら、隣接プロセスと共有する
+    // 節点を持つ要素 (境界の要素) が先頭に来るように my_elements_ を安定に並べ替え、
+    // element_output_order_ を合わせる。境界の要素の数を返す (off なら0)。
+    // 境界の要素を計算し終えれば共有節点の値は確定するので、その送受信の間に内部の要素を計算できる。
+    size_t splitBoundaryElements();
+
+    // findOwnData() の付属関数。計算条件の threads_ に従って、節点・要素の計算のスレッド数を設定し、
+    // 2スレッド以上なら thread_chunk_ 要素のチャンク単位で要素を色分けし直し、
+    // thread_schedule_ に従ってチャンクのスレッドへの割り当て方を設定する。
+    void setThreads();
+
+    // findOwnData() の付属関数。要素の色分けの色数と、色ごとの要素数をログに出力する。
+    void logColoring();
+
+    // thread_schedule が stealing の場合に、速度予測・速度補正のスレッドごとの
+    // busy/idle 時間、実行したチャンク数、盗んだ回数をログに出力する。
+    void logThreadStats();
+
     // リスタートファイルの読み込み
     void readTemporalData();
 
@@ -104,11 +161,87 @@ public:
     // 残りのループ不変量計算を行う。
     void calcInvariants2();
 
+    // 計算用配列のメモリ量をログに出力する (calcInvariants2() から呼ぶ)
+    void logMemoryUsage();
+
+    // calcInvariants2() の付属関数。correction_solver pcg の行列を組み立てる
+    void assemblePressureSolver();
+
     // 速度予測値を計算する。
-    void calcVelocityPrediction();
+    // part に PART_BOUNDARY, PART_INTERIOR を指定すると、その範囲の要素だけを計算する
+    // (splitBoundaryElements() を参照)。
+    void calcVelocityPrediction(ElementBlock::Part part = ElementBlock::PART_ALL);
 
     // 閾値を超える要素があれば補正してtrueを返す
-    bool calcDivergenceAndCorrect();
+    // part は calcVelocityPrediction() と同じ。
+    bool calcDivergenceAndCorrect(ElementBlock::Part part = ElementBlock::PART_ALL);
+
+    // 色 color の要素だけについて、閾値を超える要素があれば補正してtrueを返す
+    // (ElementBlock::calcDivergenceAndCorrectColor())。color が色の数以上なら何もしない。
+    bool calcDivergenceAndCorrectColor(size_t color);
+
+    // 速度補正で判別式を計算する要素の集合を更新する (ElementBlock::updateActiveElements())。
+    // all が true なら全要素を計算する。更新後の要素数を返す。
+    size_t updateActiveElements(bool all);
+
+    // 計算条件の relaxation_adaptive が on なら、要素ごとの緩和係数を調整する
+    // (ElementBlock::adaptRelaxation())。速度補正の反復ごとに補正の後で呼ぶ。
+    void adaptRelaxation();
+
+    // 要素ごとの緩和係数の調整で、前回の判別式を忘れる。速度補正ループの初めに呼ぶ。
+    void clearRelaxationHistory();
+
+    // 要素の緩和係数の平均
+    double meanRelaxation() const { return element_block_.meanRelaxation(); }
+
+    // 要素の色の数
+    size_t numColors() const { return element_block_.numColors(); }
+
+    /*
+     * correction_acceleration anderson の場合の速度補正の反復の加速 (AndersonAcceleration)。
+     * 反復ごとに beginAcceleration() の後で calcDivergenceAndCorrectAll() で全要素を補正し、
+     * calcAccelerationDots() の値の全プロセスでの和を accelerate() に渡す。accelerate() は
+     * 外挿した圧力の補正量とそれに見合う速度変化量を加えるので、その後で隣接プロセスと
+     * 速度変化量を送受信して反映する。全体で閾値を超える要素がなかった反復は
+     * cancelAcceleration() で圧力を戻し、速度変化量を捨てる。
+     * 閾値を超えた要素だけを補正すると反復が圧力の1次式にならず、外挿が効かないので、
+     * 閾値は収束の判定だけに使う。
+     */
+    // 加速するか (calcInvariants2() で決まる)
+    bool accelerationEnabled() const { return acceleration_; }
+    // 速度補正ループの初めに呼び、前のループの履歴を忘れる
+    void clearAccelerationHistory();
+    void beginAcceleration();
+    // 全要素を補正し、判別式の絶対値が閾値を超える要素があれば true を返す
+    bool calcDivergenceAndCorrectAll();
+    // calcAccelerationDots() が書く値の数
+    size_t numAccelerationDots() const { return anderson_.numDots(); }
+    void calcAccelerationDots(double *dots);
+    // 補正量を加えたら true を返す
+    bool accelerate(const double *dots);
+    // 圧力を beginAcceleration() の時に戻す
+    void cancelAcceleration();
+    // 係数が求まらずに履歴を捨てた回数
+    long accelerationRestarts() const { return anderson_.restarts(); }
+
+    /*
+     * correction_solver pcg の場合の速度補正 (PressureSolver)。beginPressureSolve() から
+     * updatePressureSolution() までは PressureSolver の同名のメソッドを自プロセスのデータに適用する。
+     * dots には自プロセスの分を書くので、全プロセスでの和を次のメソッドに渡す。
+     * 行列と探索方向の積は、gatherPressureDirection() で共有節点の分を送信バッファに集め、
+     * 送受信の間に multiplyPressureLocal() を行い、distributeVelocityDelta() の後で
+     * multiplyPressureInterface() で仕上げる。解き終えたら applyPressureSolution() で
+     * 圧力と速度変化量に加え、速度補正と同様に送受信して反映する。
+     */
+    bool pressureSolverEnabled() const { return pressure_solve_; }
+    size_t numPressureSolverDots() const { return PressureSolver::numDots(); }
+    void beginPressureSolve(double *dots);
+    void nextPressureDirection(const double *dots);
+    void gatherPressureDirection();
+    void multiplyPressureLocal();
+    void multiplyPressureInterface(double *dots);
+    bool updatePressureSolution(const double *dots, double *next);
+    void applyPressureSolution();
 
     // 速度の変化量及び補正量を初期化する
     void clearVelocityDelta();
@@ -0,0 +1,521 @@
+/*
+ * ElementBlock.h
+ */
+
+#ifndef ELEMENTBLOCK_H_
+#define ELEMENTBLOCK_H_
+
+#include <NodeBlock.h>
+#include <QuadElement.h>
+#include <Vector4.h>
+#include <AlignedAllocator.h>
+#include <WorkStealingScheduler.h>
+
+#include <vector>
+#include <stdint.h>
+
+// x86上のGCC/Clangでは、AVX2/AVX-512で書いた計算ルーチンを実行時に選択できるようにする。
+// (ElementBlockSimd.cpp を参照)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ELEMENTBLOCK_X86_SIMD
+#endif
+
+/*
+ * 速度補正ループで全要素について毎回読むループ不変量。
+ * Real は格納する型で、double または float。
+ * floatで格納する場合も、読み出した値はdoubleに変換して計算・加算する。
+ */
+template <class Real>
+class CorrectionInvariants {
+public:
+    typedef std::vector<Real, AlignedAllocator<Real> > Array;
+
+    // calcInvariants1() : Hx/A, Hy/A  [4*e + i]
+    Array hx_by_a_, hy_by_a_;
+    // calcInvariants2() : delta_t * M^-1 * Hx, delta_t * M^-1 * Hy  [4*e + i]
+    Array dt_hx_by_m_, dt_hy_by_m_;
+    // calcInvariants2() : 緩和係数を掛けた圧力補正の係数  [e]
+    Array lambda_relaxation_;
+
+    // 要素数 n 分の配列をゼロで確保する。
+    // lean なら lambda_relaxation_ だけを確保する (ElementBlock::STORAGE_LEAN)。
+    void assign(size_t n, bool lean) {
+        release();
+        lambda_relaxation_.assign(n, 0);
+        if (lean) {
+            return;
+        }
+        hx_by_a_.assign(4*n, 0);
+        hy_by_a_.assign(4*n, 0);
+        dt_hx_by_m_.assign(4*n, 0);
+        dt_hy_by_m_.assign(4*n, 0);
+    }
+
+    // 配列を解放する
+    void release() {
+        Array().swap(hx_by_a_);
+        Array().swap(hy_by_a_);
+        Array().swap(dt_hx_by_m_);
+        Array().swap(dt_hy_by_m_);
+        Array().swap(lambda_relaxation_);
+    }
+
+    // 確保しているバイト数
+    size_t bytes() const {
+        return (hx_by_a_.size() + hy_by_a_.size() + dt_hx_by_m_.size() + dt_hy_by_m_.size()
+                + lambda_relaxation_.size()) * sizeof(Real);
+    }
+};
+
+/*
+ * 当プロセスが担当する四角形要素のループ不変量と状態変数を、
+ * 不変量ごとの連続した配列(Structure of Arrays)として保持するクラス。
+ *
+ * 要素は0から始まるローカルな要素番号eで指定し、CfdProcData::my_elements_ の並び順と一致する。
+ * 4成分のベクトル量は要素eについて [4*e, 4*e+4) に、4x4行列は [16*e, 16*e+16) に
+ * 行優先で格納する。各配列の先頭は64バイト境界に揃っているので、
+ * 要素1個分の4成分ベクトル(32バイト)がキャッシュラインをまたぐことはない。
+ *
+ * 速度補正ループは全要素を何千回も走査するが、要素ごとに別々のヒープ領域を
+ * たどるのではなく、必要な不変量の配列だけを先頭から順に読む形になる。
+ *
+ * 節点は32bitのローカルな節点番号で参照し、節点のデータは各メソッドに渡される
+ * NodeBlockの配列から読み書きする。
+ *
+ * 速度の予測と判別式の計算は、SIMD命令が使えるCPUでは連続する4要素(AVX2)
+ * または8要素(AVX-512)を1組とし、レジスタの各レーンに1要素ずつ載せて同時に計算する。
+ * 節点への速度変化量の加算は、同じ節点を共有する要素が同じ組に入ることがあるので、
+ * 組の計算が終わってから要素番号順に1要素ずつ行う。加算の順序はスカラー版と同じになる。
+ *
+ * 速度補正ループで読むループ不変量 (CorrectionInvariants) は precision_ によって
+ * floatで格納することもできる。判別式や速度変化量の計算・加算はどちらの場合もdoubleで行う。
+ *
+ * storage_ を STORAGE_LEAN にすると、他の不変量から安く求まる量と中間的な計算値の
+ * 配列を持たず、計算ルーチンの中でその都度求める。メモリ量を減らしたい大きなメッシュ向け。
+ */
+class ElementBlock {
+public:
+
+    // 要素の計算に使う命令セット
+    enum SimdIsa {
+        SIMD_SCALAR = 0, // 1要素ずつ計算する
+        SIMD_AVX2 = 1,   // 4要素を1組として計算する
+        SIMD_AVX512 = 2  // 8要素を1組として計算する
+    };
+
+    // 速度補正ループのループ不変量を格納する精度
+    enum Precision {
+        PRECISION_DOUBLE = 0, // double で格納する (corr_)
+        PRECISION_MIXED = 1   // float で格納し、計算はdoubleで行う (corr_f_)
+    };
+
+    // 要素の配列の持ち方
+    enum Storage {
+        // 他の不変量から求まる量 (hx_, hy_, Hx/A, Hy/A, delta_t*M^-1*Hx, delta_t*M^-1*Hy)
+        // と中間的な計算値 (D_, div_) も配列に持つ
+        STORAGE_FULL = 0,
+        // それらを配列に持たず、計算ルーチンの中で a_Ny_, a_Nx_, size_ と
+        // 節点の delta_t_by_m_ から求める。要素あたりのメモリ量が少なくなる
+        STORAGE_LEAN = 1
+    };
+
+    // 要素から節点への加算 (集中化質量、速度変化量) の方法
+    enum Assembly {
+        // 要素ごとに節点の配列へ直接加算する
+        ASSEMBLY_SCATTER = 0,
+        // 要素ごとの4節点分の寄与をいったん要素の配列 (slot_x_, slot_y_) に書き、
+        // 節点ごとにその節点を持つ要素の寄与を要素番号順に足し込む。
+        // 書き込み先が重ならないので、色分けなしでスレッドに分担でき、
+        // 足し込む順序も1スレッドのSCATTERと同じになる
+        ASSEMBLY_GATHER = 1
+    };
+
+    // 計算する要素の範囲 (setBoundaryElements() を参照)
+    enum Part {
+        PART_ALL = 0,      // 全要素
+        PART_BOUNDARY = 1, // 要素 [0, split_)。隣接プロセスと共有する節点を持つ要素を全て含む
+        PART_INTERIOR = 2  // 要素 [split_, num_elements_)
+    };
+
+    // 2スレッド以上の場合のチャンクのスレッドへの割り当て方
+    enum Schedule {
+        // omp for schedule(dynamic) で、空いたスレッドが次のチャンクを取る
+        SCHEDULE_DYNAMIC = 0,
+        // scheduler_ で、スレッドごとに連続するチャンクを割り当て、
+        // 先に終わったスレッドが他のスレッドの残りを盗む
+        SCHEDULE_STEALING = 1
+    };
+
+    // 形状関数
+    static const double ai_[4];
+    static const double bi_[4];
+    static const double ci_[4];
+    static const double di_[4];
+
+    // adaptRelaxation() で要素の緩和係数を変える割合と範囲。
+    // 判別式の比 r = D / (前回のD) が RELAX_SLOW < r <= 1 (同じ符号のまま減り方が遅い) なら
+    // 緩和係数を RELAX_UP 倍にする。上限は最初 RELAX_MAX で、全要素の |D| の和が速度補正ループでの
+    // 最小値の RELAX_GUARD 倍を超えるたびに RELAX_GUARD_CUT 倍にする (下限は RELAX_MIN)。
+    // 要素ごとに見ると緩和係数2未満では発散しないが、全体では隣の要素の補正と重なって
+    // 1を少し超えたあたりから発散するので、上限はプロセス全体の判別式で決める
+    static const double RELAX_UP;
+    static const double RELAX_SLOW;
+    static const double RELAX_MIN;
+    static const double RELAX_MAX;
+    static const double RELAX_GUARD;
+    static const double RELAX_GUARD_CUT;
+
+    // 要素数
+    size_t num_elements_;
+
+    // 使用する命令セット。コンストラクタで実行中のCPUを調べて、使える中で最も幅の広いものを選ぶ。
+    // 比較のためにスカラー版などに切り替える場合は、実行中のCPUが対応しているものを設定すること。
+    SimdIsa simd_isa_;
+
+    // trueなら calcInvariants1() で移流項テンソル conv_ を作り、速度予測ではそれを使う。
+    // falseなら速度予測のたびに、節点速度と形状関数の係数から移流項を直接計算する。
+    // calcInvariants1() より前に設定すること。
+    bool precompute_convection_;
+
+    // 速度補正ループのループ不変量の精度。既定値は PRECISION_DOUBLE。
+    // calcInvariants1() より前に設定すること。
+    Precision precision_;
+
+    // 要素の配列の持ち方。既定値は STORAGE_FULL。
+    // calcInvariants1() より前に設定すること。
+    Storage storage_;
+
+    // 要素から節点への加算の方法。既定値は ASSEMBLY_SCATTER。
+    // calcInvariants1() より前に設定すること。
+    Assembly assembly_;
+
+    // 速度予測と速度補正のスレッド数。既定値は1。
+    // 2以上なら、色ごとにその色のチャンクをOpenMPのスレッドで分担する。チャンクの中は
+    // 1スレッドで要素番号順にSIMDで計算し、色が変わるところで全スレッドがそろうのを待つ。
+    // 節点への加算の順序が色の順になるので、1スレッドの場合とは丸め誤差の範囲で結果が異なる。
+    // ASSEMBLY_GATHER の場合は色を使わず、連続する color_chunk_ 要素ごとにスレッドで分担し、
+    // 節点への足し込みも節点をスレッドで分担する。結果は1スレッドの場合と同じになる。
+    // OpenMPを有効にせずにコンパイルした場合は、同じ順序で1スレッドで計算する。
+    // colorElements() でSIMDの組の幅の倍数のチャンクに色分けしてから使うこと。
+    int num_threads_;
+
+    // チャンクのスレッドへの割り当て方。既定値は SCHEDULE_DYNAMIC。
+    // どちらでも各色の (ASSEMBLY_GATHER では全体の) チャンクの集合は同じなので、結果は変わらない。
+    Schedule schedule_;
+
+    // SCHEDULE_STEALING で使うスケジューラ。スレッドごとの実行時間などの積算値を持つ。
+    // 足りなければ計算ルーチンの中で num_threads_ スレッド分を確保し直す。
+    WorkStealingScheduler scheduler_;
+
+    /*
+     * [part 1] 要素の構成
+     */
+    // 要素eの四隅の節点のローカルな節点番号。nodes_[4*e + i]
+    std::vector<int32_t> nodes_;
+    // 要素の色分け (init() で作る)。同じ色の要素どうしは節点を共有しないので、
+    // 1つの色の要素は節点への加算が衝突せず、並列に計算できる。
+    // 色cの要素番号は color_elements_[color_begin_[c]] から color_elements_[color_begin_[c+1]-1] まで
+    // (昇順)。色の数は color_begin_.size() - 1。
+    // colorElements() で color_chunk_ > 1 とした場合は、連続する color_chunk_ 個の要素
+    // (チャンク) を単位に色を付ける。チャンクの要素は同じ色のリストに連続して並ぶ。
+    std::vector<size_t> color_begin_;
+    std::vector<int32_t> color_elements_;
+    size_t color_chunk_;
+    // 先頭から num_boundary_elements_ 個が隣接プロセスと共有する節点を持つ要素 (setBoundaryElements())。
+    // split_ はそれを color_chunk_ とSIMDの組の幅 (8要素) の倍数に切り上げたもの (要素数以下)。
+    // チャンクは split_ をまたがない。
+    size_t num_boundary_elements_;
+    size_t split_;
+    // 節点 -> その節点を持つ要素の節点 の対応 (init() で作る)。節点kを持つ要素の
+    // 4*e + i (要素eの節点i) が node_slots_[node_slot_begin_[k]] から
+    // node_slots_[node_slot_begin_[k+1]-1] まで要素番号の昇順に並ぶ。
+    std::vector<size_t> node_slot_begin_;
+    std::vector<int32_t> node_slots_;
+
+    /*
+     * [part 2] ループ不変量
+     */
+    // calcInvariants1()
+    AlignedDoubleArray a_Ny_, a_Nx_;
+    AlignedDoubleArray b_Ny_, b_Nx_;
+    AlignedDoubleArray r_Ny_, r_Nx_;
+    // Hx = a_Ny/2, Hy = -a_Nx/2 (STORAGE_LEAN では確保しない)
+    AlignedDoubleArray hx_, hy_;
+    AlignedDoubleArray d_;
+    AlignedDoubleArray size_;
+    // 速度補正ループのループ不変量 (calcInvariants1(), calcInvariants2())
+    // precision_ に応じて一方だけを確保し、もう一方は空のままにする。
+    // STORAGE_LEAN では lambda_relaxation_ だけを確保する。
+    CorrectionInvariants<double> corr_;
+    CorrectionInvariants<float> corr_f_;
+    // 移流項テンソル (precompute_convection_ の場合のみ確保する)
+    // 移流項行列は節点速度 u, v について線形で A_ij = sum_k (Tu_kji * u_k + Tv_kji * v_k) と書ける。
+    // Tu_kji = conv_[128*e + 16*k + 4*j + i], Tv_kji = conv_[128*e + 64 + 16*k + 4*j + i]
+    // 添字を k, j, i の順に並べているのは、A の列jを i 方向の4成分ベクトルとして作るため。
+    AlignedDoubleArray conv_;
+
+    /*
+     * [part 3] 状態変数や、中間的な計算値
+     */
+    // 判別式D (STORAGE_LEAN では確保しない)
+    AlignedDoubleArray D_;
+    // 圧力
+    AlignedDoubleArray p_;
+    // 圧力補正値 (STORAGE_LEAN では確保しない)
+    AlignedDoubleArray div_;
+    // 要素eから節点iへの寄与 [4*e + i] (ASSEMBLY_GATHER の場合のみ確保する)。
+    // 速度変化量のx, y成分。集中化質量の計算では slot_x_ に質量を書く。
+    // 節点に足し込んだらゼロに戻す。
+    AlignedDoubleArray slot_x_, slot_y_;
+    // 速度補正で判別式を計算し直す要素 (updateActiveElements() を参照)。0以外なら計算する。
+    // 空なら全要素を計算する。
+    std::vector<uint8_t> active_;
+    // calcInvariants2() で受け取った緩和係数
+    double relaxation_;
+    // 要素ごとの緩和係数の relaxation_ に対する倍率と、倍率1での lambda_relaxation_、
+    // 前回 adaptRelaxation() を呼んだ時の判別式 (adaptRelaxation() を参照)。
+    // 空なら全要素で relaxation_ を使う。calcInvariants2() で空に戻す。
+    AlignedDoubleArray relax_factor_;
+    AlignedDoubleArray lambda_base_;
+    AlignedDoubleArray D_prev_;
+    // 緩和係数の上限と、速度補正ループでの全要素の |D| の和の最小値
+    double relax_cap_;
+    double D_sum_min_;
+
+    ElementBlock();
+
+    // 要素の一覧から配列を確保し、四隅の節点を登録する。
+    // elements[e] がローカルな要素番号eの要素になる。
+    // 四隅の節点の Node::local_index_ は設定済みであること。
+    void init(const std::vector<QuadElement *> &elements);
+
+    /*
+     * ループ不変量の計算
+     */
+    // 集中化質量の確定前。四隅の節点に集中化質量を加算する。
+    void calcInvariants1(NodeBlock &nodes, double Re);
+    // 集中化質量の確定後
+    void calcInvariants2(const NodeBlock &nodes, double delta_t, double relaxation);
+
+    /*
+     * 速度の予測値を計算し、節点の速度変化量に加算する。
+     * part を指定すると、その範囲の要素だけを計算する。
+     */
+    void calcVelocityPrediction(NodeBlock &nodes, Part part = PART_ALL);
+
+    /*
+     * 全要素の判別式を計算し、閾値を超える要素の速度を補正する。
+     * 補正した要素があればtrueを返す。
+     * part を指定すると、その範囲の要素だけを計算する。判別式は補正前の速度から求めるので、
+     * PART_BOUNDARY と PART_INTERIOR を続けて呼んだ結果は PART_ALL と同じになる。
+     */
+    bool calcDivergenceAndCorrect(NodeBlock &nodes, double epsilon, Part part = PART_ALL);
+
+    /*
+     * 色 color の要素だけ判別式を計算し、閾値を超える要素の速度を補正する。
+     * 補正した要素があればtrueを返す。color が色の数以上なら何もしない。
+     * 色ごとに呼んで、その都度速度変化量を速度に反映すれば、後の色の判別式は前の色の補正後の
+     * 速度から求まる (多色順序のGauss-Seidel法)。color_chunk_ > 1 の場合はチャンクを単位とした
+     * ブロック版になり、チャンクの中の要素どうしは calcDivergenceAndCorrect() と同様に
+     * 補正前の速度から求める。num_threads_ が2以上なら、その色のチャンクをスレッドで分担する。
+     */
+    bool calcDivergenceAndCorrectColor(NodeBlock &nodes, double epsilon, size_t color);
+
+    /*
+     * 速度補正で判別式を計算する要素の集合 (active_) を更新し、節点の NodeBlock::moved_ をクリアする。
+     * 初めて呼んだ時から有効になり、以後の calcDivergenceAndCorrect(),
+     * calcDivergenceAndCorrectColor() は active_ の要素を含む8要素の組 (SIMDの組の幅に揃えた
+     * 要素 [8k, 8k+8)) だけを計算する。計算した組の要素は、その組で補正した要素があれば
+     * 次も計算し、なければ外す。all が false なら、前回の呼び出しの後に速度が変わった節点を持つ
+     * 要素を加え、true なら全要素を加える。
+     * 判別式は四隅の節点速度だけで決まるので、外した要素の判別式は閾値以下のまま変わらず、
+     * 補正の結果は全要素を計算する場合と同じになる。速度補正ループの最初の反復や、
+     * 境界条件など速度変化量を経ずに速度を変えた後は all を true にすること。
+     */
+    void updateActiveElements(NodeBlock &nodes, bool all);
+
+    // active_ の要素数 (updateActiveElements() の直後の値)
+    size_t numActiveElements() const;
+
+    /*
+     * 全要素の圧力に dp[e] を加え、それに見合う速度変化量 delta_t*M^-1*Hx*dp[e] などを
+     * 節点の速度変化量に加算する。速度補正の補正量を外から与える場合 (Anderson法など) に使う。
+     * dp[e] が0の要素は飛ばす。num_threads_ が2以上なら、色ごとにチャンクをスレッドで分担する。
+     */
+    void addPressureDelta(NodeBlock &nodes, const double *dp);
+
+    // 判別式 D_ の絶対値が epsilon を超える要素があれば true を返す (STORAGE_LEAN では使えない)
+    bool discriminantExceeds(double epsilon) const;
+
+    // 全要素の圧力をゼロにする
+    void clearPressure();
+
+    /*
+     * 要素ごとの緩和係数を、前回呼んだ時からの判別式の変化に応じて調整する (RELAX_UP などを参照)。
+     * 速度補正の反復ごとに calcDivergenceAndCorrect() の後で呼ぶ。前回の判別式が閾値 epsilon 以下
+     * (前回は補正しなかった) 要素は変えない。調整した倍率は次の補正から使われ、
+     * 時間ステップをまたいで引き継ぐ。初めて呼んだ時に倍率1で配列を確保する。
+     * 判別式を配列に持たない STORAGE_LEAN では何もしない。
+     */
+    void adaptRelaxation(double epsilon);
+    // 前回の判別式を忘れる。速度補正ループの初めに呼ぶ (速度予測の前後の判別式は比べない)。
+    void clearRelaxationHistory();
+    // 要素の緩和係数の平均
+    double meanRelaxation() const;
+
+    // 実行中のCPUで使える最も幅の広い命令セットを返す
+    static SimdIsa detectSimdIsa();
+    // 命令セットの名前 (ログ出力用)
+    static const char *simdIsaName(SimdIsa isa);
+    // 1組で同時に計算する要素数
+    static size_t simdWidth(SimdIsa isa);
+
+    // 確保している配列のバイト数の合計
+    size_t memoryBytes() const;
+
+    // 色の数
+    size_t numColors() const { return color_begin_.size() - 1; }
+
+    // 連続する chunk 個の要素を単位として色分けをやり直す。
+    // init() では1要素単位で色分けする。スレッドで分担する場合は、SIMDの組が
+    // チャンクをまたがず配列の先頭が64バイト境界に揃うように、chunk を8の倍数にすること。
+    void colorElements(size_t chunk);
+
+    // 先頭から num 個の要素が隣接プロセスと共有する節点を持つことを登録し、
+    // その手前で分かれるように色分けをやり直す (チャンクの要素数は変えない)。
+    // 以後、PART_BOUNDARY と PART_INTERIOR で分けて計算できる。init() では0。
+    void setBoundaryElements(size_t num);
+
+private:
+
+    // calcInvariants1()の付属関数
+    void setAlphaBetaGamma_Nxy(size_t e, const Vector4 &x, const Vector4 &y);
+    void addMass(NodeBlock &nodes, size_t e, double a_xy, double b_xy, double r_xy);
+    void setDiffusionMatrix(size_t e, double a_xy, double b_xy, double r_xy, double Re);
+    void setPressureVector(size_t e);
+    void setSize(size_t e, const Vector4 &x, const Vector4 &y);
+    template <class Real>
+    void setPressureVectorBySize(CorrectionInvariants<Real> &corr, size_t e);
+    void setConvectionTensor(size_t e);
+
+    // 要素eの Hx, Hy。STORAGE_LEAN では a_Ny_, a_Nx_ から求める。
+    void getPressureVector(size_t e, double hx[4], double hy[4]) const;
+
+    // calcInvariants2()の付属関数
+    template <class Real>
+    void setDtHxyByM(CorrectionInvariants<Real> &corr, const NodeBlock &nodes, size_t e, double delta_t);
+    template <class Real>
+    void setLambda(CorrectionInvariants<Real> &corr, const NodeBlock &nodes, size_t e,
+            double delta_t, double relaxation);
+
+    // 要素eから節点iへの速度変化量の寄与を加算する。
+    // ASSEMBLY_GATHER では slot_x_, slot_y_ に書き、節点には gatherVelocityDelta() で足し込む。
+    void addVelocityDelta(NodeBlock &nodes, size_t e, int i, double dx, double dy) {
+        if (assembly_ == ASSEMBLY_GATHER) {
+            slot_x_[4*e + i] = dx;
+            slot_y_[4*e + i] = dy;
+        } else {
+            VectorXY &d_vel = nodes.d_vel_[nodes_[4*e + i]];
+            d_vel.x_ += dx;
+            d_vel.y_ += dy;
+        }
+    }
+    // slot_x_, slot_y_ を節点の速度変化量に足し込み、ゼロに戻す (ASSEMBLY_GATHER)
+    void gatherVelocityDelta(NodeBlock &nodes);
+
+    // init()の付属関数。node_slot_begin_, node_slots_ を作る。
+    void makeNodeSlots();
+
+    // 要素 [begin, end) の速度予測。1スレッドで要素番号順に計算する。
+    void calcVelocityPredictionRange(NodeBlock &nodes, size_t begin, size_t end);
+
+    // part の要素の範囲 [begin, end)
+    void partRange(Part part, size_t &begin, size_t &end) const;
+    // 色cの要素のうち [begin, end) にあるものの color_elements_ での位置 [first, last)
+    void colorRange(size_t c, size_t begin, size_t end, size_t &first, size_t &last) const;
+
+    // SCHEDULE_STEALING で scheduler_ に渡すタスク。タスクkはチャンク
+    // [chunkBegin(list, first, k), +color_chunk_) の計算。並列領域の中でスレッドごとに作る。
+    struct PredictionTask;
+    template <class Real>
+    struct CorrectionTask;
+    // list が NULL なら first + k*color_chunk_、そうでなければ list[k*color_chunk_] (色の要素のリスト)
+    size_t chunkBegin(const int32_t *list, size_t first, size_t k) const {
+        return list ? list[k*color_chunk_] : first + k*color_chunk_;
+    }
+    // 並列領域の中で全スレッドから呼び、要素 [begin, end) のチャンクを、ASSEMBLY_GATHER なら
+    // まとめて、そうでなければ色ごとに scheduler_ で実行する。
+    template <class Task>
+    void runChunks(Task &task, size_t begin, size_t end);
+
+    // calcVelocityPrediction() の付属関数。1要素分の速度変化量を節点に加算する。
+    // 移流項行列は作らずに、節点速度から直接計算する。
+    void calcVelocityPrediction(NodeBlock &nodes, size_t e);
+    void calcVelocityPredictionByTensor(NodeBlock &nodes, size_t e);
+
+    // calcDivergenceAndCorrect() の本体。corr は corr_ または corr_f_。
+    // num_threads_ に応じて、全要素を1スレッドで、または色ごとにチャンクをスレッドで分担して計算する。
+    template <class Real>
+    bool calcDivergenceAndCorrect(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, double epsilon,
+            Part part);
+    // adaptRelaxation() の本体。corr は corr_ または corr_f_。
+    template <class Real>
+    void adaptRelaxation(CorrectionInvariants<Real> &corr, double epsilon);
+    // addPressureDelta() の本体
+    template <class Real>
+    void addPressureDelta(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, const double *dp);
+    template <class Real>
+    void addPressureDeltaRange(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, const double *dp,
+            size_t begin, size_t end);
+    // calcDivergenceAndCorrectColor() の本体
+    template <class Real>
+    bool calcDivergenceAndCorrectColor(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, double epsilon,
+            size_t color);
+    // 要素 [begin, end) の判別式の計算と速度補正。1スレッドで要素番号順に計算する。
+    // active_ が空でなければ、active_ の要素を含む組だけを calcDivergenceAndCorrectDense() で計算する。
+    template <class Real>
+    bool calcDivergenceAndCorrectRange(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+            size_t begin, size_t end, double epsilon);
+    // 要素 [begin, end) を全て計算する
+    template <class Real>
+    bool calcDivergenceAndCorrectDense(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+            size_t begin, size_t end, double epsilon);
+    // 判別式を計算
+    template <class Real>
+    void calcDiscriminant(const CorrectionInvariants<Real> &corr, const NodeBlock &nodes, size_t e);
+    // 速度補正値の計算
+    template <class Real>
+    void correctVelocity(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, size_t e);
+
+    // STORAGE_LEAN の場合の calcDivergenceAndCorrectDense() の本体
+    template <class Real>
+    bool calcDivergenceAndCorrectLean(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+            size_t begin, size_t end, double epsilon);
+    // 判別式を計算して返す (STORAGE_LEAN)
+    double calcDiscriminantLean(const NodeBlock &nodes, size_t e) const;
+    // 判別式 D から速度補正値を計算する (STORAGE_LEAN)
+    template <class Real>
+    void correctVelocityLean(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, size_t e, double D);
+
+#ifdef ELEMENTBLOCK_X86_SIMD
+    // 要素e から始まる1組分の計算 (ElementBlockSimd.cpp)
+    void calcVelocityPredictionAvx2(NodeBlock &nodes, size_t e);
+    template <class Real>
+    bool calcDivergenceAndCorrectAvx2(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+            size_t e, double epsilon);
+    void calcVelocityPredictionAvx512(NodeBlock &nodes, size_t e);
+    template <class Real>
+    bool calcDivergenceAndCorrectAvx512(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+            size_t e, double epsilon);
+    template <class Real>
+    bool calcDivergenceAndCorrectLeanAvx2(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+            size_t e, double epsilon);
+    template <class Real>
+    bool calcDivergenceAndCorrectLeanAvx512(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+            size_t e, double epsilon);
+    // 移流項テンソルを使う速度予測 (要素eの1要素分、i方向の4成分をAVX2で計算する)
+    void calcVelocityPredictionTensorAvx2(NodeBlock &nodes, size_t e);
+#endif
+};
+
+#endif /* ELEMENTBLOCK_H_ */
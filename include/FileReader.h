@@ -103,6 +103,11 @@ public:
     //   IoException : End of File など。
     void readLine();
 
+    // 空行を読み飛ばして、次の行をバッファに読み込む。
+    // ファイルの終わりに達していて読む行がなければfalseを返す。
+    // 省略できる行がファイルの最後に並んでいる場合に使う。
+    bool readNextLine();
+
     // バッファからキーワードを読み込み、引数と比較する
     // 期待したキーワードが登場することを確認するメソッド。
     // 例外:
@@ -131,6 +136,12 @@ public:
     //   DataException : 読み込みに失敗した
     void readString(std::string &val, const char *label);
 
+    // 読み込んだ単語 word が想定していないものだった場合に、現在のファイル名と行番号を含む
+    // DataExceptionを挙げる。
+    // 例外:
+    //   DataException : 常に
+    void throwUnexpectedWord(const std::string &word, const char *label);
+
 private:
 
     // stringstreamに、読み込み中のファイル名と行番号を、エラーメッセージに適する形式で書き加える。
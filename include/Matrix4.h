@@ -3,9 +3,12 @@
  */
 
 #include <iostream>
-#include <vector>
 #include "Vector4.h"
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #ifndef MATRIX4_H_
 #define MATRIX4_H_
 
@@ -13,35 +16,85 @@
  * 4x4行列のクラス。
  *
  * 行列間の四則演算，ベクトルと行列の掛け算，行列の転置
+ *
+ * Vector4と同様に値はオブジェクト内の固定長配列(行優先、32バイト境界)に保持する。
+ * 時間発展ループの中で呼ばれる演算はヘッダー内でinline定義し、
+ * 行列とベクトルの積はAVX2が有効な場合には4行分を並列に計算する。
  */
 class Matrix4
 {
 private:
-    std::vector<double> val_;
+    alignas(32) double val_[16];
 public:
-    ~Matrix4();
+    // 零行列で初期化する
+    constexpr Matrix4() : val_{} {}
 
-    Matrix4();
-    Matrix4(const Matrix4 &o);
+    // コピーコンストラクタ、代入、デストラクタはコンパイラが生成するものを使う
 
     void unit();
 
-    void set(int row, int col, double val);
-    void set(int rowcol, double val);
-    double get(int row, int col) const;
-    double get(int rowcol) const;
-
-    Matrix4 &operator=(const Matrix4 &o);
-
-    Matrix4 operator+(const Matrix4 &o) const;
-
-    Matrix4 operator-(const Matrix4 &o) const;
+    void set(int row, int col, double val) {
+        val_[row*4 + col] = val;
+    }
+    void set(int rowcol, double val) {
+        val_[rowcol] = val;
+    }
+    constexpr double get(int row, int col) const {
+        return val_[row*4 + col];
+    }
+    constexpr double get(int rowcol) const {
+        return val_[rowcol];
+    }
+
+    Matrix4 operator+(const Matrix4 &o) const {
+        Matrix4 result;
+        for (int i = 0; i < 16; i++) {
+            result.val_[i] = val_[i] + o.val_[i];
+        }
+        return result;
+    }
+
+    Matrix4 operator-(const Matrix4 &o) const {
+        Matrix4 result;
+        for (int i = 0; i < 16; i++) {
+            result.val_[i] = val_[i] - o.val_[i];
+        }
+        return result;
+    }
 
     Matrix4 operator*(const Matrix4 &o) const;
 
-    Vector4 operator*(const Vector4 &o) const;
-
-    Matrix4 operator*(double x) const;
+    Vector4 operator*(const Vector4 &o) const {
+        Vector4 result;
+#ifdef __AVX2__
+        __m256d x = _mm256_load_pd(o.val_);
+        __m256d p0 = _mm256_mul_pd(_mm256_load_pd(val_ + 0), x);
+        __m256d p1 = _mm256_mul_pd(_mm256_load_pd(val_ + 4), x);
+        __m256d p2 = _mm256_mul_pd(_mm256_load_pd(val_ + 8), x);
+        __m256d p3 = _mm256_mul_pd(_mm256_load_pd(val_ + 12), x);
+        // s01 = [p0_0+p0_1, p1_0+p1_1, p0_2+p0_3, p1_2+p1_3], s23も同様
+        __m256d s01 = _mm256_hadd_pd(p0, p1);
+        __m256d s23 = _mm256_hadd_pd(p2, p3);
+        // 128bitレーンを組み替えて足すと各行の和が並ぶ
+        __m256d lo = _mm256_permute2f128_pd(s01, s23, 0x20);
+        __m256d hi = _mm256_permute2f128_pd(s01, s23, 0x31);
+        _mm256_store_pd(result.val_, _mm256_add_pd(lo, hi));
+#else
+        for (int i = 0; i < 4; i++) {
+            result.val_[i] = val_[i*4 + 0]*o.val_[0] + val_[i*4 + 1]*o.val_[1]
+                           + val_[i*4 + 2]*o.val_[2] + val_[i*4 + 3]*o.val_[3];
+        }
+#endif
+        return result;
+    }
+
+    Matrix4 operator*(double x) const {
+        Matrix4 result;
+        for (int i = 0; i < 16; i++) {
+            result.val_[i] = val_[i]*x;
+        }
+        return result;
+    }
 
     Matrix4 T() const;
     // Matrix4 inv(){
@@ -173,6 +226,8 @@ public:
 
 Vector4 operator*(const Vector4 &v, const Matrix4 &m);
 
-Matrix4 operator*(double x, const Matrix4 &m);
+inline Matrix4 operator*(double x, const Matrix4 &m) {
+    return m * x;
+}
 
 #endif // MATRIX4_H_
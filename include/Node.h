@@ -44,28 +44,11 @@ public:
     std::vector<int> ranks_;
 
     /*
-     * [part 2] ループ不変量
+     * 質量などのループ不変量や、速度などの状態変数はNodeBlockに配列として保持する。
      */
-    // 集中化近似された質量
-    double m_;
-    // 質量の逆数
-    double inv_m_;
-    double delta_t_by_m_;
-
-    /*
-     * [part 3] 状態変数(時間と共に変化する値や、計算のための中間的な値）
-     */
-    // 節点での速度, 速度補正
-    VectorXY vel_;
-    VectorXY d_vel_;
 
     // コンストラクタ
     Node() {
-        // 質量への代入は += で周囲から加算されていくので、0に初期化する必要がある。
-        m_ = 0;
-        // 速度の補正, m_ と同様に += で加算される．
-        d_vel_.x_ = 0;
-        d_vel_.y_ = 0;
         // この節点には領域番号が一つも設定されていないことを示す。
         first_rank_ = -1;
     }
@@ -75,9 +58,7 @@ public:
     Node(const Node &o) : ranks_(o.ranks_) {
         // 一般のコピーコンストラクタでは、全メンバ変数をコピーするが、
         // ここでは、処理手順を考慮して、コピーが必須のメンバ変数だけ、コピーする。
-        m_ = o.m_;
         pos_ = o.pos_;
-        vel_ = o.vel_;
         first_rank_ = o.first_rank_;
     }
 
@@ -122,33 +103,6 @@ public:
         return ranks_.size() > 1;
     }
 
-    // 質量をゼロでクリアする。
-    // ※コンストラクタでもやっているので、冗長な処理。
-    void clearMass() {
-        m_ = 0;
-    }
-
-    // 集中化質量が計算された後で、その逆数を求めて記録する。
-    void calcInvMass() {
-        assert(m_ > 0.0);
-        inv_m_ = 1.0 / m_;
-    }
-
-    void calcDtByM(double delta_t){
-        delta_t_by_m_ = delta_t * inv_m_;
-    }
-
-    void clearVelocityDelta(){
-        d_vel_.x_ = 0;
-        d_vel_.y_ = 0;
-    }
-
-    void applyVelocityDelta(){
-        // 変化量の適用
-        vel_.x_ += d_vel_.x_;
-        vel_.y_ += d_vel_.y_;
-    }
-
 };
 
 #endif
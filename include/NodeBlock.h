@@ -0,0 +1,88 @@
+/*
+ * NodeBlock.h
+ */
+
+#ifndef NODEBLOCK_H_
+#define NODEBLOCK_H_
+
+#include <Node.h>
+#include <VectorXY.h>
+#include <AlignedAllocator.h>
+
+#include <vector>
+#include <stdint.h>
+
+// 64バイト境界に揃えたVectorXYの配列
+typedef std::vector<VectorXY, AlignedAllocator<VectorXY> > AlignedXYArray;
+
+/*
+ * 当プロセスが担当する節点の計算用データを、量ごとの連続した配列として保持するクラス。
+ *
+ * 節点は0から始まるローカルな節点番号 (Node::local_index_, CfdProcData::my_nodes_ の並び順) で指定する。
+ * 要素の計算で節点の速度を集める処理や、速度変化量を加算する処理は
+ * vel_ や d_vel_ の配列だけに触れ、領域番号などのNodeの他のメンバは読まない。
+ * Nodeクラスには入力ファイルから定まる情報(座標・領域番号)だけが残る。
+ */
+class NodeBlock {
+public:
+
+    // 節点数
+    size_t num_nodes_;
+
+    // 節点ごとに独立な配列の更新 (速度変化量の適用とクリア) のスレッド数。既定値は1。
+    // OpenMPを有効にせずにコンパイルした場合は常に1スレッドで計算する。
+    int num_threads_;
+
+    /*
+     * [part 1] 入力ファイルから定まる情報
+     */
+    // 座標
+    AlignedXYArray pos_;
+
+    /*
+     * [part 2] ループ不変量
+     */
+    // 集中化近似された質量
+    AlignedDoubleArray m_;
+    // 質量の逆数
+    AlignedDoubleArray inv_m_;
+    AlignedDoubleArray delta_t_by_m_;
+
+    /*
+     * [part 3] 状態変数
+     */
+    // 節点での速度, 速度補正
+    AlignedXYArray vel_;
+    AlignedXYArray d_vel_;
+    // 速度変化量を適用して速度が変わった節点なら0以外 (ElementBlock::updateActiveElements() を参照)。
+    // 空なら記録しない。ElementBlock::updateActiveElements() が確保し、読んだらクリアする。
+    std::vector<uint8_t> moved_;
+
+    NodeBlock();
+
+    // 節点の一覧から配列を確保し、座標をコピーする。
+    // nodes[i] がローカルな節点番号iの節点になる。
+    void init(const std::vector<Node *> &nodes);
+
+    // 質量をゼロでクリアする。
+    void clearMass();
+
+    // 集中化質量が計算された後で、その逆数を求めて記録する。
+    void calcInvMass();
+
+    void calcDtByM(double delta_t);
+
+    // 速度と速度補正をゼロにする
+    void clearVelocity();
+
+    void clearVelocityDelta();
+
+    // 速度補正を速度に反映させた後、速度補正をゼロにする。
+    // moved_ が空でなければ、速度補正がゼロでない節点を記録する。
+    void applyVelocityDeltaAndClear();
+
+    // 確保している配列のバイト数の合計
+    size_t memoryBytes() const;
+};
+
+#endif /* NODEBLOCK_H_ */
@@ -56,6 +56,138 @@ public:
     // リスタートファイルのパス名
     std::string temporal_file_name_;
 
+    /*
+     * 省略可能な設定。計算条件ファイルでは上記の行の後に "ラベル 値" の行を任意の順に書く。
+     * 書かなければ既定値になる。
+     */
+    // 移流項の計算方法 (ラベル convection)
+    //   recompute   : 毎ステップ、節点速度と形状関数の係数から移流項を直接計算する (既定値)
+    //   precomputed : ループ不変量として要素ごとの移流項テンソル(要素あたり1KB)を作っておき、
+    //                 毎ステップはそれと節点速度の積和だけを計算する。
+    //                 演算量は減るがメモリの読み出しが増えるので、キャッシュに収まる
+    //                 要素数でないと速くならない (bench_ElementBlock で確認できる)
+    std::string convection_;
+    // 速度補正ループのループ不変量の精度 (ラベル precision)
+    //   double : doubleで格納する (既定値)
+    //   mixed  : Hx/A, Hy/A, delta_t*M^-1*Hx, delta_t*M^-1*Hy, lambda をfloatで格納する。
+    //            読み出しのメモリ量は約半分になる。計算と速度変化量の加算はdoubleで行う
+    std::string precision_;
+    // 要素の配列の持ち方 (ラベル storage)
+    //   full : 他の不変量から求まる量や中間的な計算値も要素ごとの配列に持つ (既定値)
+    //   lean : それらを配列に持たず、計算のたびに求める。要素あたりのメモリ量が少ない
+    std::string storage_;
+    // 担当する節点・要素の並べ替え (ラベル renumber)
+    //   none    : メッシュファイルの順のまま (既定値)
+    //   rcm     : 節点を Reverse Cuthill-McKee 順に並べ、要素はそれに合わせる
+    //   hilbert : 要素を重心の Hilbert 曲線順に並べ、節点はそれに合わせる
+    // VTKファイルとリスタートファイルはどの場合もメッシュファイルの順で書く
+    std::string renumber_;
+    // 要素から節点への加算の方法 (ラベル assembly)
+    //   scatter : 要素ごとに節点の集中化質量・速度変化量へ直接加算する (既定値)
+    //   gather  : 要素ごとの寄与をいったん要素の配列に書き、節点ごとに足し込む。
+    //             スレッドで分担する場合に色分けが要らない。要素あたり64バイト多く使う
+    std::string assembly_;
+    // 1プロセスあたりのスレッド数 (ラベル threads)。既定値は1。
+    // 2以上なら速度予測・速度補正・速度変化量の適用・境界条件の適用をOpenMPのスレッドで分担する。
+    // OpenMPを有効にしてコンパイルした場合のみ効果がある。abmac2d の第2引数で上書きできる。
+    int threads_;
+    // スレッドで分担する単位の要素数 (ラベル thread_chunk)。既定値は512。8の倍数に切り上げる。
+    // 同じ節点を共有しないチャンクどうしを同じ色にまとめ、色ごとに並列に計算する。
+    int thread_chunk_;
+    // チャンクのスレッドへの割り当て方 (ラベル thread_schedule)
+    //   dynamic  : 空いたスレッドが次のチャンクを取る (omp for schedule(dynamic), 既定値)
+    //   stealing : スレッドごとに連続するチャンクを割り当て、先に終わったスレッドが
+    //              他のスレッドの残りを盗む。スレッドごとの busy/idle 時間をログに出す
+    std::string thread_schedule_;
+    // 隣接プロセスとの速度変化量の送受信を、内部の要素の計算と重ねるか (ラベル halo_overlap)
+    //   off : 全要素を計算してから送受信する (既定値)
+    //   on  : 隣接プロセスと共有する節点を持つ要素を先に計算して送受信を始め、
+    //         受信を待つ間に残りの要素を計算する。要素の並び順が変わる
+    std::string halo_overlap_;
+    // 隣接プロセスとの送受信の方法 (ラベル halo_exchange)
+    //   isend      : 送受信のたびに MPI_Isend / MPI_Irecv を発行する (既定値)
+    //   persistent : MPI_Send_init / MPI_Recv_init で作っておいた送受信要求を
+    //                MPI_Startall で開始する
+    //   neighbor   : 隣接プロセスの分散グラフ (MPI_Dist_graph_create_adjacent) 上の
+    //                近傍集団通信 MPI_Ineighbor_alltoallw で送受信する。
+    //                MPI-4 なら永続的な MPI_Neighbor_alltoallw_init を使う
+    //   shared     : 同じノードのプロセスとは MPI-3 の共有メモリのウィンドウ
+    //                (MPI_Win_allocate_shared) を直接読み書きし、他は isend と同じ
+    std::string halo_exchange_;
+    // 速度補正ループで全体の収束を確かめる方法 (ラベル convergence_check)
+    //   blocking  : 確かめる反復で MPI_Allreduce し、結果を待ってから次へ進む (既定値)
+    //   pipelined : 確かめる反復で MPI_Iallreduce を発行し、結果は次の反復の補正の後に受け取る。
+    //               全体の通信の待ちは補正の計算と重なるが、収束した後の補正を1回余分に行う
+    //   piggyback : 全体の通信を行わない。速度変化量の送信データの末尾に、自プロセスの周りで
+    //               続けて補正が起きなかった反復数を載せ、それが隣接プロセスのグラフの直径を
+    //               越えたら全プロセスが同じ反復で終える。収束した後の補正を直径の回数
+    //               (halo_overlap on なら2倍) 余分に行う。convergence_interval は使わない
+    // 全体で補正が止まった後の補正は何も変えないので、結果はどちらも同じ。余分に行った
+    // 補正の回数は補正の総数に含めず、終了時にログに出す
+    std::string convergence_check_;
+    // 速度補正ループで全体の収束を確かめる間隔 (ラベル convergence_interval)。既定値は1。
+    // N なら N 回に1回だけ確かめる。余分に行う補正は最大 N-1 回 (pipelined なら N 回) になる
+    int convergence_interval_;
+    // 速度補正ループを隣接プロセスと待ち合わせずに進めるか (ラベル correction_async)
+    //   off : 反復ごとに隣接プロセスと速度変化量を送受信し、全体の収束を確かめる (既定値)
+    //   on  : 各プロセスは自分の要素を補正して速度変化量を送り、その時までに届いている
+    //         隣接プロセスの速度変化量だけを反映して次の反復へ進む (chaotic relaxation)。
+    //         全体の収束は、補正も受信もなかったことと、送ったメッセージが全て届いたことを
+    //         MPI_Iallreduce で確かめる。max_corrections はプロセスごとの反復数の上限になる。
+    //         halo_overlap, halo_exchange, convergence_check, convergence_interval,
+    //         correction_order は使わない。
+    //         反映する順序が実行ごとに変わるので、結果は off と丸め誤差の範囲で一致しない
+    std::string correction_async_;
+    // 速度補正ループで要素を補正する順序 (ラベル correction_order)
+    //   jacobi     : 全要素の判別式を補正前の速度から求め、補正を全てまとめて反映する (既定値)
+    //   multicolor : 要素の色ごとに補正し、隣接プロセスと速度変化量を送受信して反映してから
+    //                次の色を補正する (多色順序のGauss-Seidel法)。1回の補正で色の数
+    //                (全プロセスでの最大値) だけ送受信する。threads が2以上なら
+    //                thread_chunk 要素のチャンク単位の色になる。halo_overlap は速度補正では使わない
+    std::string correction_order_;
+    // 速度補正ループで判別式を計算する要素を絞るか (ラベル active_set)
+    //   off : 毎回全要素の判別式を計算する (既定値)
+    //   on  : 前の反復で補正した要素と、速度が変わった節点を持つ要素だけを計算する。
+    //         速度が変わらない要素の判別式は変わらないので、結果は off と同じになる。
+    //         correction_async では使わない
+    std::string active_set_;
+    // active_set on の場合に、念のため全要素を計算し直す反復の間隔 (ラベル active_set_recheck)。
+    // 既定値は16。速度補正ループの最初の反復は常に全要素を計算する
+    int active_set_recheck_;
+    // 要素ごとに緩和係数を調整するか (ラベル relaxation_adaptive)
+    //   off : 全要素で relaxation を使う (既定値)
+    //   on  : relaxation から始めて、速度補正の反復ごとの判別式の減り方に応じて要素ごとに
+    //         緩和係数を上げ下げする (ElementBlock::adaptRelaxation())。storage lean と
+    //         correction_async では使わない
+    std::string relaxation_adaptive_;
+    // 速度補正の反復を加速するか (ラベル correction_acceleration)
+    //   off      : 加速しない (既定値)
+    //   anderson : 要素の圧力についての不動点反復とみなし、直近 anderson_depth 回分の
+    //              反復での圧力と補正量 (緩和係数を掛けた判別式) の変化から、次の圧力を
+    //              外挿する (Anderson法)。反復を圧力の1次式にするため、毎回全要素を補正し、
+    //              epsilon は収束の判定だけに使う。外挿に使う全体の内積と収束の確認は
+    //              反復ごとに1回の MPI_Allreduce にまとめるので、convergence_check と
+    //              convergence_interval は使わない。correction_order jacobi の場合だけ使い、
+    //              halo_overlap は速度補正では使わない。storage lean と correction_async では使わない
+    std::string correction_acceleration_;
+    // correction_acceleration anderson で覚えておく反復の数 (ラベル anderson_depth)。既定値は5
+    int anderson_depth_;
+    // 速度補正の方法 (ラベル correction_solver)
+    //   abmac : 閾値を超える要素の圧力と速度を補正する反復を、全要素が閾値以下になるまで繰り返す (既定値)
+    //   pcg   : 速度の発散をゼロにする圧力補正量の連立1次方程式を calcInvariants で組み立てておき、
+    //           前処理付き共役勾配法で解いてから、圧力と速度を1度に補正する (PressureSolver)。
+    //           全要素の判別式が epsilon 以下になったら解き終え、反復数の上限は max_corrections。
+    //           反復ごとに隣接プロセスと1回送受信し (halo_overlap on なら局所行列の積と重ねる)、
+    //           内積のために2回 MPI_Allreduce する。relaxation, relaxation_adaptive,
+    //           convergence_check, convergence_interval, correction_async, correction_order,
+    //           active_set, correction_acceleration は使わない
+    std::string correction_solver_;
+    // correction_solver pcg の前処理 (ラベル pcg_preconditioner)
+    //   jacobi : 対角成分の逆数を掛ける (既定値)
+    //   ilu    : 自プロセスの要素どうしの局所行列の不完全LU分解 ILU(0)。他プロセスとの結合は無視する
+    //            (ブロックJacobi法)。反復数は減るが、前進・後退代入はスレッドで分担しない
+    std::string pcg_preconditioner_;
+
     // 初期化。MPIの初期化関数を呼んでから当関数を呼ぶこと。
     // np : 総プロセス数
     // rank : 自プロセスのrank
@@ -0,0 +1,158 @@
+/*
+ * PressureSolver.h
+ */
+
+#ifndef PRESSURESOLVER_H_
+#define PRESSURESOLVER_H_
+
+#include <ElementBlock.h>
+#include <NodeBlock.h>
+#include <AlignedAllocator.h>
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * 速度補正の圧力補正量を、要素の圧力についての連立1次方程式として前処理付き共役勾配法 (PCG) で
+ * 解くクラス (correction_solver pcg)。
+ *
+ * 要素eの圧力に dp_e を加えると、節点kの速度は delta_t*M^-1 * sum_e H_ek dp_e だけ変わる
+ * (H_ek は要素eの節点kでの Hx, Hy)。境界条件で速度を与える節点の変化は境界条件の適用で消える。
+ * 補正後の速度 u' の発散 H u' をゼロにする dp は
+ *   K dp = -H u,   K_ef = sum_k delta_t/m_k * (Hx_ek Hx_fk + Hy_ek Hy_fk)
+ * (k は要素e, fが共有する、境界条件で速度を与えない節点) を満たす。K は対称半正定値で、
+ * ABMAC法の速度補正はこの方程式に緩和係数を掛けたJacobi法を適用したものになっている。
+ *
+ * 行列は assemble() で一度だけ組み立てる。自プロセスの要素どうしの結合 (隣接プロセスと
+ * 共有する節点を通るものも含む) を圧縮行格納 (CSR) の局所行列に、共有節点での
+ * 自プロセスの要素の Hx, Hy をインターフェース行列に持つ。他プロセスの要素との結合は、
+ * 探索方向による共有節点の速度変化量 delta_t/m_k * sum_f H_fk p_f を速度変化量の送受信で
+ * 交換して求めるので、行列とベクトルの積1回につき速度補正の反復1回と同じ1回の送受信で済む。
+ *
+ * 収束の判定は ABMAC法と同じく、全要素で判別式 D_e = (H u')_e / A_e の絶対値が epsilon 以下で
+ * あることとし、残差 r = -H u' から求める。四隅の節点の速度がすべて境界条件で与えられる要素は
+ * どの圧力でも速度が変わらないので、方程式から外し、判定にも使わない。
+ *
+ * 内積と、閾値を超える要素の数は各プロセスの分を dots に書くので、呼び出し側で全プロセスの和を
+ * 求めて次のメソッドに渡す。反復の手順は次の通り。
+ *   begin(dots) -> 和で閾値を超える要素がなければ終わり
+ *   反復: nextDirection(和) -> scatterInterface(nodes) -> (送信バッファに集めて送信を始める)
+ *         -> multiplyLocal(nodes) -> (受信して d_vel_ に分配する) -> multiplyInterface(nodes, dots)
+ *         -> update(和, dots) -> 和で閾値を超える要素がなければ終わり
+ * 解いた補正量は solution() にあり、ElementBlock::addPressureDelta() で圧力と速度変化量に加える。
+ */
+class PressureSolver {
+public:
+
+    // 前処理
+    enum Preconditioner {
+        // 対角成分の逆数を掛ける
+        PRECONDITIONER_JACOBI = 0,
+        // 局所行列の不完全LU分解 ILU(0)。他プロセスとの結合は無視する (ブロックJacobi法)。
+        // 前進・後退代入は1スレッドで行う
+        PRECONDITIONER_ILU = 1
+    };
+
+    PressureSolver();
+
+    /*
+     * 行列を組み立てる。節点の delta_t_by_m_ を使うので、集中化質量の確定後に呼ぶ。
+     * fixed[k] が0以外の節点kは境界条件で速度を与える節点。
+     * interface_nodes は隣接プロセスと共有する節点のローカルな節点番号 (重複なし)。
+     * num_threads は行列とベクトルの積などのOpenMPのスレッド数。
+     */
+    void assemble(const ElementBlock &elements, const NodeBlock &nodes, const std::vector<uint8_t> &fixed,
+            const std::vector<int32_t> &interface_nodes, Preconditioner preconditioner, int num_threads);
+
+    // begin(), multiplyInterface(), update() が dots に書く値の数 (multiplyInterface() は dots[0] だけ)。
+    //   dots[0] 内積
+    //   dots[1] 判別式の絶対値が閾値を超える要素の数
+    static size_t numDots() { return 2; }
+
+    // 現在の速度から残差を求め、補正量をゼロにする。dots に r.z と閾値を超える要素の数を書く
+    void begin(const ElementBlock &elements, const NodeBlock &nodes, double epsilon, double *dots);
+
+    // 全プロセスでの r.z の和 dots[0] から、次の探索方向を求める
+    void nextDirection(const double *dots);
+
+    // 探索方向による共有節点の速度変化量の自プロセス分を節点の d_vel_ に書く。
+    // 呼び出し側で送信バッファに集めること
+    void scatterInterface(NodeBlock &nodes) const;
+
+    // 局所行列と探索方向の積を求め、共有節点の d_vel_ をゼロに戻す。
+    // 送信バッファに集めた後、受信した速度変化量を分配する前に呼ぶ
+    void multiplyLocal(NodeBlock &nodes);
+
+    // 分配された共有節点の速度変化量 (他プロセスの分) を積に加え、d_vel_ をゼロに戻す。
+    // dots[0] に探索方向と積の内積を書く
+    void multiplyInterface(NodeBlock &nodes, double *dots);
+
+    // 全プロセスでの探索方向と積の内積の和 dots[0] から補正量と残差を更新し、
+    // next に r.z と閾値を超える要素の数を書く。
+    // 内積が正でなく更新できない場合は false を返す
+    bool update(const double *dots, double epsilon, double *next);
+
+    // 求めた圧力の補正量 (要素数分)
+    const double *solution() const { return x_.data(); }
+
+    // 局所行列の非ゼロ成分の数
+    size_t numNonzeros() const { return cols_.size(); }
+    // インターフェース行列の節点数
+    size_t numInterfaceNodes() const { return iface_nodes_.size(); }
+    // 方程式から外した要素の数
+    size_t numFixedElements() const { return num_fixed_elements_; }
+    // ILU(0) で小さすぎるピボットを対角成分に置き換えた数
+    size_t numPivotFixes() const { return pivot_fixes_; }
+
+    // 使っている配列のバイト数
+    size_t memoryBytes() const;
+
+private:
+
+    size_t n_;
+    int num_threads_;
+    Preconditioner preconditioner_;
+
+    // 局所行列 (CSR)。行eの列番号 cols_[row_begin_[e]] .. cols_[row_begin_[e+1]-1] は昇順で、
+    // 対角成分は必ず持ち、その位置は diag_pos_[e]
+    std::vector<size_t> row_begin_;
+    std::vector<int32_t> cols_;
+    AlignedDoubleArray vals_;
+    std::vector<size_t> diag_pos_;
+    // 対角成分の逆数。方程式から外した要素は0
+    AlignedDoubleArray inv_diag_;
+    // ILU(0) の L (対角は1) と U を vals_ と同じ位置に持つ
+    AlignedDoubleArray lu_;
+    size_t pivot_fixes_;
+    size_t num_fixed_elements_;
+
+    // インターフェース行列。共有節点 iface_nodes_[j] を持つ要素と、その節点での Hx, Hy を
+    // [iface_begin_[j], iface_begin_[j+1]) に持つ。iface_dt_by_m_[j] は節点の delta_t/m
+    std::vector<int32_t> iface_nodes_;
+    std::vector<size_t> iface_begin_;
+    std::vector<int32_t> iface_elements_;
+    AlignedDoubleArray iface_hx_;
+    AlignedDoubleArray iface_hy_;
+    AlignedDoubleArray iface_dt_by_m_;
+
+    // 要素の面積 (閾値の判定に使う)
+    AlignedDoubleArray area_;
+
+    // 補正量、残差、前処理後の残差、探索方向、行列と探索方向の積
+    AlignedDoubleArray x_;
+    AlignedDoubleArray r_;
+    AlignedDoubleArray z_;
+    AlignedDoubleArray p_;
+    AlignedDoubleArray q_;
+    // 全プロセスでの r.z と、探索方向があるか
+    double rz_;
+    bool have_direction_;
+
+    // 局所行列の ILU(0) 分解を lu_ に作る
+    void factorize();
+    // z = M^-1 r を求め、r.z と閾値を超える要素の数を dots に書く
+    void precondition(double epsilon, double *dots);
+};
+
+#endif /* PRESSURESOLVER_H_ */
@@ -6,8 +6,6 @@
 #define QUADELEMENT_H_
 
 #include <Node.h>
-#include <Matrix4.h>
-#include <Vector4.h>
 
 /*
  * 四角形要素の情報を保持するクラス
@@ -34,37 +32,9 @@ public:
     int global_index_;
 
     /*
-     * [part 2] ループ不変量
+     * ループ不変量や圧力などの状態変数は、要素ごとのオブジェクトには持たせず、
+     * ElementBlockに不変量ごとの配列として保持する。
      */
-    // 形状関数
-    static double ai_[4];
-    static double bi_[4];
-    static double ci_[4];
-    static double di_[4];
-
-    // calcInvariants1()
-    Vector4 a_Ny_, a_Nx_;
-    Vector4 b_Ny_, b_Nx_;
-    Vector4 r_Ny_, r_Nx_;
-    Vector4 hx_, hy_;
-    Vector4 hx_by_a_, hy_by_a_;
-    Matrix4 d_;
-    double size_;
-    // calcInvariants2()
-    Vector4 dt_hx_by_m_, dt_hy_by_m_;
-    double lambda_relaxation_;
-
-    /*
-     * [part 3] 状態変数や、中間的な計算値
-     */
-    // 移流項A
-    Matrix4 A_;
-    // 判別式D
-    double D_;
-    // 圧力
-    double p_;
-    // 圧力補正値
-    double div_;
 
     // コンストラクタ、デストラクタはコンパイラが生成するデフォルトのものをそのまま使う
 
@@ -73,41 +43,6 @@ public:
      */
     void setRank(int rank);
 
-    /*
-     * ループ不変量の計算
-     */
-    // 集中化質量の確定前
-    void calcInvariants1(double Re);
-        // calcInvariants1()の付属関数
-        void setAlphaBetaGamma_Nxy(const Vector4 &x, const Vector4 &y);
-        void addMass(double a_xy, double b_xy, double r_xy);
-        void setDiffusionMatrix(double a_xy, double b_xy, double r_xy, double Re);
-        void setPressureVector();
-        void setSize(const Vector4 &x, const Vector4 &y);
-        void setPressureVectorBySize();
-    // 集中化質量の確定後
-    void calcInvariants2(double delta_t, double relaxation);
-        // calcInvariants2()の付属関数
-        void setDtHxyByM(double delta_t);
-        void setLambda(double delta_t, double relaxation);
-
-    /*
-     * 速度の予測値の計算
-     */
-    void calcVelocityPrediction();
-        // calcVelocityPrediction() の付属関数
-        void calcConvectionMatrix();
-        void addVelocityDelta(const Vector4 &u, const Vector4 &v);
-
-    /*
-     * 判別式を計算
-     */
-    void calcDiscriminant();
-    /*
-     * 速度補正値の計算
-     */
-    void correctVelocity();
-
 };
 
 //void setShapeMatrix(QuadElement &element);
@@ -0,0 +1,67 @@
+/*
+ * Renumbering.h
+ */
+
+#ifndef RENUMBERING_H_
+#define RENUMBERING_H_
+
+#include <VectorXY.h>
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+/*
+ * 当プロセスが担当する節点・要素のローカルな番号を、メモリ上の局所性が良くなるように
+ * 付け直すための関数群。
+ *
+ * 要素の構成は elem_nodes[4*e + i] (要素eの節点iのローカルな節点番号) で渡す。
+ * 並べ替えの結果は order[新しい番号] = 元の番号 の形の配列で返す。
+ *
+ *   Reverse Cuthill-McKee : 節点グラフの帯幅が小さくなるように節点を並べ、
+ *                           要素はその節点番号の最小値の順に並べる。
+ *   Hilbert曲線           : 要素の重心をHilbert曲線に沿って並べ、
+ *                           節点はその要素順で最初に現れる順に並べる。
+ */
+class Renumbering {
+public:
+
+    /*
+     * 要素順の計算が節点の配列をどれだけ飛び飛びに読むかの指標
+     */
+    class Locality {
+    public:
+        // 要素内の節点番号の差の最大値 (節点グラフの帯幅)
+        int bandwidth_;
+        // 要素内の節点番号の差の平均値
+        double mean_span_;
+        // 要素順に四隅の節点の速度(16バイト)を読むとき、容量 cache_bytes のLRUキャッシュ
+        // (64バイトのライン、フルアソシアティブ)で起きるキャッシュミスの回数
+        size_t cache_misses_;
+        size_t cache_bytes_;
+    };
+
+    // 節点グラフの Reverse Cuthill-McKee 順。連結成分ごとに、次数の小さい周辺の節点から始める。
+    static std::vector<int32_t> rcmNodeOrder(size_t num_nodes, const std::vector<int32_t> &elem_nodes);
+
+    // 要素の重心の Hilbert 曲線順
+    static std::vector<int32_t> hilbertElementOrder(const std::vector<int32_t> &elem_nodes,
+            const std::vector<VectorXY> &pos);
+
+    // 節点の並び順 node_order に合わせた要素の並び順 (要素の新しい節点番号の最小値の順)
+    static std::vector<int32_t> elementOrderByNodes(size_t num_nodes, const std::vector<int32_t> &node_order,
+            const std::vector<int32_t> &elem_nodes);
+
+    // 要素の並び順 element_order に合わせた節点の並び順 (要素順に最初に現れる順)。
+    // どの要素にも属さない節点は最後に元の順で並べる。
+    static std::vector<int32_t> nodeOrderByElements(size_t num_nodes, const std::vector<int32_t> &element_order,
+            const std::vector<int32_t> &elem_nodes);
+
+    // order[新] = 旧 の逆の対応 inverse[旧] = 新
+    static std::vector<int32_t> inverse(const std::vector<int32_t> &order);
+
+    // 局所性の指標を計算する
+    static Locality measure(size_t num_nodes, const std::vector<int32_t> &elem_nodes, size_t cache_bytes);
+};
+
+#endif /* RENUMBERING_H_ */
@@ -0,0 +1,38 @@
+/*
+ * TestGrid.h
+ */
+
+#ifndef TESTGRID_H_
+#define TESTGRID_H_
+
+#include <Node.h>
+#include <QuadElement.h>
+
+#include <vector>
+
+/*
+ * 単体テストとベンチマーク用の、nx x ny 要素の歪んだ格子。
+ *
+ * 節点 (i, j) は nodes_[j*(nx+1) + i]、要素 (i, j) は elems_[j*nx + i] で、番号は格子の行ごとに付ける。
+ * 節点の local_index_ は nodes_ での番号にする。node_list_, elem_list_ は同じ順序のポインタで、
+ * NodeBlock::init(), ElementBlock::init() にそのまま渡せる。
+ * ポインタが自身の配列を指すのでコピーはできない。
+ */
+class TestGrid {
+public:
+    std::vector<Node> nodes_;
+    std::vector<QuadElement> elems_;
+    std::vector<Node *> node_list_;
+    std::vector<QuadElement *> elem_list_;
+
+    TestGrid() {}
+
+    // nx x ny 要素の格子を作る。作り直す場合は前の格子を捨てる
+    void make(int nx, int ny);
+
+private:
+    TestGrid(const TestGrid &);
+    TestGrid &operator=(const TestGrid &);
+};
+
+#endif /* TESTGRID_H_ */
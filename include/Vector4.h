@@ -2,43 +2,98 @@
  * Vector4.h
  */
 #include <iostream>
-#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #ifndef VECTOR4_H_
 #define VECTOR4_H_
 
 /*
  * ４次元ベクトルクラス
+ *
+ * 要素の計算の中では一時オブジェクトとして大量に生成・破棄されるので、
+ * 値はstd::vectorではなくオブジェクト内の固定長配列に保持し、
+ * ヒープ割り当てが一切起きないようにしている。
+ * 配列は32バイト境界に揃えてあり、AVX2を有効にしてコンパイルした場合
+ * (-mavx2 や -march=native) には4成分を一命令でロードして計算する。
  */
 class Vector4
 {
+    friend class Matrix4;
 private:
-    std::vector<double> val_;
+    alignas(32) double val_[4];
 public:
-    ~Vector4();
-    Vector4();
-    Vector4(const Vector4 &o);
-    Vector4(const double x0, const double x1, const double x2, const double x3);
+    // 零ベクトルで初期化する
+    constexpr Vector4() : val_{0.0, 0.0, 0.0, 0.0} {}
+    constexpr Vector4(const double x0, const double x1, const double x2, const double x3)
+        : val_{x0, x1, x2, x3} {}
+
+    // コピーコンストラクタ、代入、デストラクタはコンパイラが生成するものを使う
 
-    void set(int dim, double val);
+    void set(int dim, double val) {
+        val_[dim] = val;
+    }
 
-    double get(int dim) const;
+    constexpr double get(int dim) const {
+        return val_[dim];
+    }
 
-    double &operator[] (const int dim);
+    double &operator[] (const int dim) {
+        return val_[dim];
+    }
 
-    Vector4 &operator=(const Vector4 &o);
+    // 先頭要素のアドレス(32バイト境界)
+    double *data() {
+        return val_;
+    }
+    const double *data() const {
+        return val_;
+    }
 
-    Vector4 operator+(const Vector4 &o) const;
+    Vector4 operator+(const Vector4 &o) const {
+        Vector4 result;
+        for (int i = 0; i < 4; i++) {
+            result.val_[i] = val_[i] + o.val_[i];
+        }
+        return result;
+    }
 
-    Vector4 operator-(const Vector4 &o) const;
+    Vector4 operator-(const Vector4 &o) const {
+        Vector4 result;
+        for (int i = 0; i < 4; i++) {
+            result.val_[i] = val_[i] - o.val_[i];
+        }
+        return result;
+    }
 
-    Vector4 operator*(double r) const;
+    Vector4 operator*(double r) const {
+        Vector4 result;
+        for (int i = 0; i < 4; i++) {
+            result.val_[i] = val_[i]*r;
+        }
+        return result;
+    }
 
-    double dot(const Vector4 &o) const;
+    double dot(const Vector4 &o) const {
+#ifdef __AVX2__
+        __m256d p = _mm256_mul_pd(_mm256_load_pd(val_), _mm256_load_pd(o.val_));
+        // 上位128bitと下位128bitを足してから、残る2成分を足す
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(p), _mm256_extractf128_pd(p, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+#else
+        return val_[0]*o.val_[0] + val_[1]*o.val_[1] + val_[2]*o.val_[2] + val_[3]*o.val_[3];
+#endif
+    }
 };
 
-Vector4 operator*(double r, const Vector4 &o);
+inline Vector4 operator*(double r, const Vector4 &o) {
+    return o*r;
+}
 
-double dot(const Vector4 &v1, const Vector4 &v2);
+inline double dot(const Vector4 &v1, const Vector4 &v2) {
+    return v1.dot(v2);
+}
 
 #endif // VECTOR4_H_
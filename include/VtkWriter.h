@@ -9,8 +9,8 @@
 #include <sstream>
 #include <vector>
 
-#include <Node.h>
-#include <QuadElement.h>
+#include <NodeBlock.h>
+#include <ElementBlock.h>
 
 #include <IoException.h>
 #include <DataException.h>
@@ -25,15 +25,19 @@ private:
     std::fstream out_;
     std::stringstream cur_line_;
 
-    std::vector<Node *> my_nodes_;
-    std::vector<QuadElement *> my_elements_;
+    const NodeBlock *node_block_;
+    const ElementBlock *element_block_;
+    // 節点・要素を書く順番 (出力でk番目の節点のローカルな節点番号など)
+    const std::vector<int32_t> *node_order_;
+    const std::vector<int32_t> *element_order_;
 
 public:
     // constructor, destructor
     VtkWriter();
     ~VtkWriter();
-    // 現在の節点と要素の情報を渡して初期化
-    void init(const std::vector<Node *> my_nodes, const std::vector<QuadElement *> my_elements);
+    // 現在の節点と要素の情報と、それらを書く順番を渡して初期化
+    void init(const NodeBlock *node_block, const ElementBlock *element_block,
+            const std::vector<int32_t> *node_order, const std::vector<int32_t> *element_order);
     // ファイルを生成して開く ファイル名にプロセッサー番号と時間発展回数が入る
     void open(const std::string filename, const int rank, const int round);
     // ファイルを閉じる
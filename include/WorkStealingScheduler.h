@@ -0,0 +1,126 @@
+/*
+ * WorkStealingScheduler.h
+ */
+
+#ifndef WORKSTEALINGSCHEDULER_H_
+#define WORKSTEALINGSCHEDULER_H_
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/*
+ * 番号 0 .. num_tasks-1 のタスク (要素のバッチなど) を、OpenMPのスレッドで分担して実行する
+ * ワークスティーリング方式のスケジューラ。
+ *
+ * タスクは最初にスレッド数で等分し、スレッドごとのキュー (両端キュー) に連続する番号の範囲として
+ * 積む。各スレッドは自分のキューの先頭から番号順に取り出して実行し、空になったら他のスレッドの
+ * キューを順に見て、残っている範囲の後ろ半分を盗んで自分のキューに移す。
+ * タスクの重さが不揃いでも空いたスレッドが待たずに済み、しかも各スレッドはほぼ番号順に
+ * 連続したタスクを実行するので、omp for schedule(dynamic) のように全スレッドで1つの
+ * カウンタを取り合う場合よりデータの局所性が保たれる。
+ *
+ * スレッドごとに、タスクを実行していた時間 (busy)、それ以外の時間 (idle : 盗む相手を探す時間と
+ * 全スレッドがそろうのを待つ時間)、実行したタスク数、盗んだ回数を積算する。
+ * OpenMPを有効にせずにコンパイルした場合は、1スレッドで番号順に実行する。
+ */
+class WorkStealingScheduler {
+public:
+
+    // スレッドごとの積算値
+    struct Counters {
+        double busy_;    // タスクを実行していた時間 [s]
+        double idle_;    // run() の中でタスクを実行していなかった時間 [s]
+        size_t tasks_;   // 実行したタスク数
+        size_t steals_;  // 他のスレッドからタスクを盗んだ回数
+    };
+
+    WorkStealingScheduler();
+
+    // num_threads スレッドまでで使えるようにキューを確保し、積算値をゼロにする。
+    // 並列領域の外で呼ぶこと。
+    void init(int num_threads);
+
+    // init() で確保したスレッド数
+    int maxThreads() const { return (int)queues_.size(); }
+
+    // タスク 0 .. num_tasks-1 を実行する。task(k) でタスクkを実行する。
+    // 並列領域の中で全スレッドから、同じ num_tasks で呼ぶこと。全タスクが終わり、
+    // 全スレッドがそろってから戻る。task は呼んだスレッドの中だけで使う。
+    template <class Task>
+    void run(size_t num_tasks, Task &task);
+
+    // スレッド thread の積算値
+    const Counters &counters(int thread) const { return counters_[thread].counters_; }
+
+    // 積算値をゼロにする
+    void clearCounters();
+
+private:
+
+    // スレッドのキュー。まだ実行していないタスクの番号 [head_, tail_)。
+    // 持ち主は head_ から取り出し、他のスレッドは tail_ の側から盗む。
+    // 隣のスレッドのキューとキャッシュラインを共有しないようにする。
+    struct alignas(64) Queue {
+        std::mutex lock_;
+        size_t head_;
+        size_t tail_;
+    };
+
+    struct alignas(64) PaddedCounters {
+        Counters counters_;
+    };
+
+    std::vector<Queue> queues_;
+    std::vector<PaddedCounters> counters_;
+
+    // 自分のスレッド番号とスレッド数
+    static int threadNum();
+    static int numThreads();
+    // 経過時間 [s]
+    static double now();
+
+    // スレッド thread のキューに最初の分担を積む
+    void fill(int thread, int num_threads, size_t num_tasks);
+    // 自分のキューの先頭からタスクを1つ取り出す。空ならfalseを返す。
+    bool pop(int thread, size_t &task);
+    // 他のスレッドのキューから残りの後ろ半分を盗んで自分のキューに移す。
+    // どのキューも空ならfalseを返す。
+    bool steal(int thread, int num_threads);
+};
+
+template <class Task>
+void WorkStealingScheduler::run(size_t num_tasks, Task &task) {
+    int thread = threadNum();
+    int num_threads = numThreads();
+    Counters &counters = counters_[thread].counters_;
+    double start = now();
+    double busy = 0;
+    size_t k;
+
+    fill(thread, num_threads, num_tasks);
+    // 全スレッドのキューが積まれてから盗み始める
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
+    while (true) {
+        if (pop(thread, k)) {
+            double t = now();
+            task(k);
+            busy += now() - t;
+            counters.tasks_++;
+        } else if (steal(thread, num_threads)) {
+            counters.steals_++;
+        } else {
+            // タスクは新しく生まれないので、全キューが空なら残りは実行中のものだけ
+            break;
+        }
+    }
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
+    counters.busy_ += busy;
+    counters.idle_ += now() - start - busy;
+}
+
+#endif /* WORKSTEALINGSCHEDULER_H_ */
@@ -4,48 +4,487 @@
 #include <CfdCommunicator.h>
 #include <mpi.h>
 #include <cassert>
+#include <algorithm>
+#include <thread>
 #include <Logger.h>
 
+/*
+ * 隣接プロセス数の最大値
+ * 単純な四角い格子状のプロセス配置でも、周辺プロセス数は8個に及ぶ。
+ * 格子の形状の都合により、鋭角状の領域分割がなされるとさらに増える。
+ * ここでは最大値を100と決めて実装し、もし100を越えるデータが与えられたら
+ * それを検知してエラー終了するようにする。
+ */
+#define MAX_NEIGHBORS 100
+
+/*
+ * 共有メモリで相手の送信を待つ時に、CPUを譲らずに待つ回数
+ */
+#define MAX_SPINS 100
+
+/*
+ * 非同期の速度補正で使うメッセージのタグ。
+ * 通常の送受信 (タグ0) と混ざらないようにする
+ */
+#define TAG_ASYNC_DATA 1
+#define TAG_ASYNC_COUNT 2
+
 void CfdCommunicator::init(Params *params, State *state, CfdCommData *commData) {
     params_ = params;
     state_ = state;
     commData_ = commData;
 
+    persistent_ = false;
+    neighbor_ = false;
+    graph_comm_ = MPI_COMM_NULL;
+    node_comm_ = MPI_COMM_NULL;
+    shared_win_ = MPI_WIN_NULL;
+    published_ = NULL;
+    shared_seq_ = 0;
+    active_requests_ = &requests;
+    num_exchanges_ = 0;
+    start_time_ = 0;
+    wait_time_ = 0;
+}
+
+void CfdCommunicator::initRequests() {
+    // 永続的な送受信要求はバッファのアドレスを覚えるので、以後の gather... で
+    // バッファの大きさを変えても再確保が起きないように、大きい方 (速度変化量) の分を確保しておく
+    commData_->reserveBuffers();
+    assert(commData_->peer_buffers_.size() <= MAX_NEIGHBORS);
+    async_sent_.assign(commData_->peer_buffers_.size(), 0);
+    async_received_.assign(commData_->peer_buffers_.size(), 0);
+    if (params_->halo_exchange_ == "persistent") {
+        persistent_ = true;
+        initPersistentRequests(mass_requests_, false);
+        initPersistentRequests(velocity_requests_, true);
+        Logger::out << "halo exchange : persistent requests for " << commData_->peer_buffers_.size()
+                << " peers" << std::endl;
+    } else if (params_->halo_exchange_ == "neighbor") {
+        neighbor_ = true;
+        initNeighborExchange();
+    } else if (params_->halo_exchange_ == "shared") {
+        initSharedWindow();
+    }
+}
+
+void CfdCommunicator::initPersistentRequests(std::vector<MPI_Request> &reqs, bool velocity) {
+    reqs.resize(2*commData_->peer_buffers_.size());
+    for (i = 0; i < commData_->peer_buffers_.size(); i++) {
+        peer = &commData_->peer_buffers_[i];
+        int count = velocity ? (int)commData_->velocityPayloadSize(*peer) : (int)peer->nodes_.size();
+        MPI_Send_init(peer->send_buffer_.data(), count, MPI_DOUBLE, peer->rank_, 0, MPI_COMM_WORLD, &reqs[2*i]);
+        MPI_Recv_init(peer->recv_buffer_.data(), count, MPI_DOUBLE, peer->rank_, 0, MPI_COMM_WORLD, &reqs[2*i+1]);
+    }
 }
 
 /*
- * 隣接プロセス数の最大値
- * 単純な四角い格子状のプロセス配置でも、周辺プロセス数は8個に及ぶ。
- * 格子の形状の都合により、鋭角状の領域分割がなされるとさらに増える。
- * ここでは最大値を100と決めて実装し、もし100を越えるデータが与えられたら
- * それを検知してエラー終了するようにする。
+ * peer_buffers_ の順に隣接プロセスを並べた分散グラフのコミュニケータを作る。
+ * 送受信バッファは peer ごとに別の配列なので、MPI_BOTTOM からの絶対アドレスを
+ * 変位とする MPI_Neighbor_alltoallw で、詰め替えずに送受信する。
+ * 要素の分割はMPI_COMM_WORLDのランク番号で決まっているので、ランクの並べ替えは許さない。
  */
-#define MAX_NEIGHBORS 100
+void CfdCommunicator::initNeighborExchange() {
+    size_t n = commData_->peer_buffers_.size();
+    std::vector<int> ranks(n);
+    mass_counts_.resize(n);
+    velocity_counts_.resize(n);
+    send_addrs_.resize(n);
+    recv_addrs_.resize(n);
+    types_.assign(n, MPI_DOUBLE);
+    for (i = 0; i < n; i++) {
+        peer = &commData_->peer_buffers_[i];
+        ranks[i] = peer->rank_;
+        mass_counts_[i] = (int)peer->nodes_.size();
+        velocity_counts_[i] = (int)commData_->velocityPayloadSize(*peer);
+        MPI_Get_address(peer->send_buffer_.data(), &send_addrs_[i]);
+        MPI_Get_address(peer->recv_buffer_.data(), &recv_addrs_[i]);
+    }
+    MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD, n, ranks.data(), MPI_UNWEIGHTED,
+            n, ranks.data(), MPI_UNWEIGHTED, MPI_INFO_NULL, 0, &graph_comm_);
+#if MPI_VERSION >= 4
+    // 永続的な近傍集団通信が使える場合は、質量と速度変化量の分を1つずつ作っておく
+    persistent_ = true;
+    mass_requests_.resize(1);
+    velocity_requests_.resize(1);
+    MPI_Neighbor_alltoallw_init(MPI_BOTTOM, mass_counts_.data(), send_addrs_.data(), types_.data(),
+            MPI_BOTTOM, mass_counts_.data(), recv_addrs_.data(), types_.data(),
+            graph_comm_, MPI_INFO_NULL, &mass_requests_[0]);
+    MPI_Neighbor_alltoallw_init(MPI_BOTTOM, velocity_counts_.data(), send_addrs_.data(), types_.data(),
+            MPI_BOTTOM, velocity_counts_.data(), recv_addrs_.data(), types_.data(),
+            graph_comm_, MPI_INFO_NULL, &velocity_requests_[0]);
+#endif
+    Logger::out << "halo exchange : neighborhood collective on a distributed graph of " << n << " peers"
+            << (persistent_ ? " (persistent)" : "") << std::endl;
+}
+
+/*
+ * 同じノードのプロセスのコミュニケータを作り、peerのうち同じノードにあるものに
+ * 共有メモリのスロットを割り当てる。各プロセスは、自分の領域の中で相手向けのスロットが
+ * どこにあるかを相手に知らせ、相手の領域の先頭アドレスは MPI_Win_shared_query で得る。
+ * MPI_COMM_WORLD の全プロセスで呼ぶこと。
+ */
+void CfdCommunicator::initSharedWindow() {
+    size_t n = commData_->peer_buffers_.size();
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, params_->my_rank_, MPI_INFO_NULL, &node_comm_);
+
+    // peerのランク番号を、ノード内のランク番号に変換する
+    MPI_Group world_group, node_group;
+    std::vector<int> ranks(n), node_ranks(n);
+    for (i = 0; i < n; i++) {
+        ranks[i] = commData_->peer_buffers_[i].rank_;
+    }
+    MPI_Comm_group(MPI_COMM_WORLD, &world_group);
+    MPI_Comm_group(node_comm_, &node_group);
+    MPI_Group_translate_ranks(world_group, n, ranks.data(), node_group, node_ranks.data());
+    MPI_Group_free(&world_group);
+    MPI_Group_free(&node_group);
+
+    // 自分の領域の大きさ (doubleの個数)。先頭の64バイトは公開済みの送受信の回数
+    const size_t header = 64 / sizeof(double);
+    std::vector<long> offsets;
+    size_t size = header;
+    shared_index_.assign(n, -1);
+    for (i = 0; i < n; i++) {
+        if (node_ranks[i] != MPI_UNDEFINED) {
+            shared_index_[i] = shared_peers_.size();
+            shared_peers_.push_back(i);
+            offsets.push_back(size);
+            size += 2 * commData_->velocityPayloadSize(commData_->peer_buffers_[i]);
+        }
+    }
+    double *base;
+    MPI_Win_allocate_shared(size * sizeof(double), sizeof(double), MPI_INFO_NULL, node_comm_, &base, &shared_win_);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, shared_win_);
+    published_ = (volatile long *)base;
+    *published_ = 0;
+    MPI_Win_sync(shared_win_);
+
+    // 相手向けのスロットの位置を互いに知らせる。相手は、この通知を受け取るまで自分の領域を読まない
+    size_t m = shared_peers_.size();
+    std::vector<long> peer_offsets(m);
+    std::vector<MPI_Request> reqs(2*m);
+    for (size_t k = 0; k < m; k++) {
+        int other = commData_->peer_buffers_[shared_peers_[k]].rank_;
+        MPI_Isend(&offsets[k], 1, MPI_LONG, other, 0, MPI_COMM_WORLD, &reqs[2*k]);
+        MPI_Irecv(&peer_offsets[k], 1, MPI_LONG, other, 0, MPI_COMM_WORLD, &reqs[2*k+1]);
+    }
+    if (m > 0) {
+        MPI_Waitall(2*m, &reqs[0], MPI_STATUSES_IGNORE);
+    }
+
+    shared_send_.resize(m);
+    shared_recv_.resize(m);
+    shared_published_.resize(m);
+    for (size_t k = 0; k < m; k++) {
+        MPI_Aint peer_size;
+        int disp_unit;
+        double *peer_base;
+        MPI_Win_shared_query(shared_win_, node_ranks[shared_peers_[k]], &peer_size, &disp_unit, &peer_base);
+        shared_send_[k] = base + offsets[k];
+        shared_recv_[k] = peer_base + peer_offsets[k];
+        shared_published_[k] = (volatile long *)peer_base;
+    }
+    int node_size;
+    MPI_Comm_size(node_comm_, &node_size);
+    Logger::out << "halo exchange : shared memory window for " << m << " of " << n
+            << " peers (" << node_size << " processes on this node)" << std::endl;
+}
+
+/*
+ * 同じノードのpeerの送信スロットに送信バッファを写し、全て書き終えてから
+ * 送受信の回数を公開する。回数の偶奇で2つのスロットを交互に使う。
+ */
+void CfdCommunicator::startSharedExchange() {
+    shared_seq_++;
+    for (size_t k = 0; k < shared_peers_.size(); k++) {
+        peer = &commData_->peer_buffers_[shared_peers_[k]];
+        size_t stride = commData_->velocityPayloadSize(*peer);
+        assert(peer->send_buffer_.size() <= stride);
+        double *slot = shared_send_[k] + (shared_seq_ % 2) * stride;
+        std::copy(peer->send_buffer_.begin(), peer->send_buffer_.end(), slot);
+    }
+    // スロットへの書き込みが、回数より先に他のプロセスから見えるようにする
+    MPI_Win_sync(shared_win_);
+    *published_ = shared_seq_;
+}
+
+/*
+ * 同じノードのpeerが同じ回数の送受信を公開するのを待ち、そのスロットから受信バッファに写す。
+ */
+void CfdCommunicator::waitSharedExchange() {
+    for (size_t k = 0; k < shared_peers_.size(); k++) {
+        peer = &commData_->peer_buffers_[shared_peers_[k]];
+        for (int spin = 0; *shared_published_[k] < shared_seq_; spin++) {
+            MPI_Win_sync(shared_win_);
+            // しばらく待っても公開されなければCPUを譲る。コア数より多いプロセスを
+            // 動かした場合に、相手が動けずに待ち続けるのを避ける
+            if (spin >= MAX_SPINS) {
+                std::this_thread::yield();
+            }
+        }
+        // 回数を読んだ後に、スロットの内容を読む
+        MPI_Win_sync(shared_win_);
+        const double *slot = shared_recv_[k] + (shared_seq_ % 2) * commData_->velocityPayloadSize(*peer);
+        std::copy(slot, slot + peer->recv_buffer_.size(), peer->recv_buffer_.begin());
+    }
+}
+
+bool CfdCommunicator::isVelocityPayload() {
+    for (i = 0; i < commData_->peer_buffers_.size(); i++) {
+        peer = &commData_->peer_buffers_[i];
+        // 永続的な送受信要求やアドレスを記録した時とアドレスが変わっていないこと
+        assert(peer->send_buffer_.capacity() >= commData_->velocityPayloadSize(*peer));
+        if (peer->send_buffer_.size() == commData_->velocityPayloadSize(*peer) && !peer->nodes_.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CfdCommunicator::finalize() {
+    Logger::out << "halo exchange : " << params_->halo_exchange_ << ", "
+            << num_exchanges_ << " exchanges";
+    if (num_exchanges_ > 0) {
+        Logger::out << ", per exchange : start " << 1.0e6 * start_time_ / num_exchanges_
+                << " us, wait " << 1.0e6 * wait_time_ / num_exchanges_ << " us";
+    }
+    Logger::out << std::endl;
+    if (asyncSent() > 0 || asyncReceived() > 0) {
+        Logger::out << "async correction : " << asyncSent() << " messages sent, "
+                << asyncReceived() << " received" << std::endl;
+    }
+    for (i = 0; i < mass_requests_.size(); i++) {
+        MPI_Request_free(&mass_requests_[i]);
+    }
+    for (i = 0; i < velocity_requests_.size(); i++) {
+        MPI_Request_free(&velocity_requests_[i]);
+    }
+    mass_requests_.clear();
+    velocity_requests_.clear();
+    if (graph_comm_ != MPI_COMM_NULL) {
+        MPI_Comm_free(&graph_comm_);
+    }
+    if (shared_win_ != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(shared_win_);
+        MPI_Win_free(&shared_win_);
+    }
+    if (node_comm_ != MPI_COMM_NULL) {
+        MPI_Comm_free(&node_comm_);
+    }
+}
+
+/*
+ * 各プロセスの隣接プロセスの一覧を全プロセスで集め、全プロセスから幅優先探索を行う。
+ * 初期化の時に1度だけ呼ぶので、プロセス数の2乗の手間でかまわない。
+ */
+int CfdCommunicator::peerGraphDiameter() {
+    int np = params_->num_procs_;
+    int degree = commData_->peer_buffers_.size();
+    std::vector<int> degrees(np), offsets(np + 1, 0), ranks(degree);
+    MPI_Allgather(&degree, 1, MPI_INT, degrees.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < np; r++) {
+        offsets[r+1] = offsets[r] + degrees[r];
+    }
+    for (i = 0; i < commData_->peer_buffers_.size(); i++) {
+        ranks[i] = commData_->peer_buffers_[i].rank_;
+    }
+    std::vector<int> adjacency(offsets[np]);
+    MPI_Allgatherv(ranks.data(), degree, MPI_INT, adjacency.data(), degrees.data(), offsets.data(),
+            MPI_INT, MPI_COMM_WORLD);
+
+    int diameter = 0;
+    std::vector<int> distance(np), queue(np);
+    for (int source = 0; source < np; source++) {
+        std::fill(distance.begin(), distance.end(), -1);
+        int head = 0, tail = 0;
+        distance[source] = 0;
+        queue[tail++] = source;
+        while (head < tail) {
+            int r = queue[head++];
+            diameter = std::max(diameter, distance[r]);
+            for (int k = offsets[r]; k < offsets[r+1]; k++) {
+                if (distance[adjacency[k]] < 0) {
+                    distance[adjacency[k]] = distance[r] + 1;
+                    queue[tail++] = adjacency[k];
+                }
+            }
+        }
+    }
+    return diameter;
+}
+
+void CfdCommunicator::sendAsync() {
+    size_t n = commData_->peer_buffers_.size();
+    size_t k = 0;
+    for (i = 0; i < n; i++) {
+        peer = &commData_->peer_buffers_[i];
+        // 送り終えたバッファを探す。なければ増やす
+        for (; k < async_sends_.size(); k++) {
+            int done = 1;
+            if (async_sends_[k].request_ != MPI_REQUEST_NULL) {
+                MPI_Test(&async_sends_[k].request_, &done, MPI_STATUS_IGNORE);
+            }
+            if (done) {
+                break;
+            }
+        }
+        if (k == async_sends_.size()) {
+            async_sends_.push_back(AsyncSend());
+        }
+        AsyncSend &send = async_sends_[k++];
+        send.buffer_ = peer->send_buffer_;
+        MPI_Isend(send.buffer_.data(), send.buffer_.size(), MPI_DOUBLE, peer->rank_, TAG_ASYNC_DATA,
+                MPI_COMM_WORLD, &send.request_);
+        async_sent_[i]++;
+    }
+}
+
+int CfdCommunicator::receiveAsync() {
+    size_t n = commData_->peer_buffers_.size();
+    int received = 0;
+    for (i = 0; i < n; i++) {
+        peer = &commData_->peer_buffers_[i];
+        size_t size = commData_->velocityPayloadSize(*peer);
+        peer->recv_buffer_.assign(size, 0.0);
+        async_recv_.resize(size);
+        while (true) {
+            int flag;
+            MPI_Iprobe(peer->rank_, TAG_ASYNC_DATA, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+            if (!flag) {
+                break;
+            }
+            MPI_Recv(async_recv_.data(), size, MPI_DOUBLE, peer->rank_, TAG_ASYNC_DATA,
+                    MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            for (size_t j = 0; j < size; j++) {
+                peer->recv_buffer_[j] += async_recv_[j];
+            }
+            async_received_[i]++;
+            received++;
+        }
+    }
+    return received;
+}
+
+int CfdCommunicator::finishAsync() {
+    size_t n = commData_->peer_buffers_.size();
+    // 相手が送ったメッセージの数を受け取る
+    std::vector<long> expected(n);
+    requests.resize(2*n);
+    for (i = 0; i < n; i++) {
+        peer = &commData_->peer_buffers_[i];
+        MPI_Isend(&async_sent_[i], 1, MPI_LONG, peer->rank_, TAG_ASYNC_COUNT, MPI_COMM_WORLD, &requests[2*i]);
+        MPI_Irecv(&expected[i], 1, MPI_LONG, peer->rank_, TAG_ASYNC_COUNT, MPI_COMM_WORLD, &requests[2*i+1]);
+    }
+    if (n > 0) {
+        MPI_Waitall(2*n, &requests[0], MPI_STATUSES_IGNORE);
+    }
+
+    int received = 0;
+    for (i = 0; i < n; i++) {
+        peer = &commData_->peer_buffers_[i];
+        size_t size = commData_->velocityPayloadSize(*peer);
+        peer->recv_buffer_.assign(size, 0.0);
+        async_recv_.resize(size);
+        for (; async_received_[i] < expected[i]; async_received_[i]++) {
+            MPI_Recv(async_recv_.data(), size, MPI_DOUBLE, peer->rank_, TAG_ASYNC_DATA,
+                    MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            for (size_t j = 0; j < size; j++) {
+                peer->recv_buffer_[j] += async_recv_[j];
+            }
+            received++;
+        }
+    }
+    for (size_t k = 0; k < async_sends_.size(); k++) {
+        MPI_Wait(&async_sends_[k].request_, MPI_STATUS_IGNORE);
+    }
+    return received;
+}
+
+long CfdCommunicator::asyncSent() const {
+    long total = 0;
+    for (size_t k = 0; k < async_sent_.size(); k++) {
+        total += async_sent_[k];
+    }
+    return total;
+}
+
+long CfdCommunicator::asyncReceived() const {
+    long total = 0;
+    for (size_t k = 0; k < async_received_.size(); k++) {
+        total += async_received_[k];
+    }
+    return total;
+}
 
 /*
  * 全ての隣接プロセスと、共有している節点のデータを授受する。
  */
 void CfdCommunicator::exchangeBoundaryValues() {
+    startExchange();
+    waitExchange();
+}
+
+void CfdCommunicator::startExchange() {
+    double t = MPI_Wtime();
+    num_exchanges_++;
+    if (persistent_) {
+        // バッファの大きさで質量か速度変化量かを判断し、作っておいた送受信要求を開始する
+        active_requests_ = isVelocityPayload() ? &velocity_requests_ : &mass_requests_;
+        if (!active_requests_->empty()) {
+            MPI_Startall(active_requests_->size(), &(*active_requests_)[0]);
+        }
+        start_time_ += MPI_Wtime() - t;
+        return;
+    }
+    active_requests_ = &requests;
+    if (neighbor_) {
+        const int *counts = isVelocityPayload() ? velocity_counts_.data() : mass_counts_.data();
+        requests.resize(1);
+        MPI_Ineighbor_alltoallw(MPI_BOTTOM, counts, send_addrs_.data(), types_.data(),
+                MPI_BOTTOM, counts, recv_addrs_.data(), types_.data(), graph_comm_, &requests[0]);
+        start_time_ += MPI_Wtime() - t;
+        return;
+    }
+
     /*
      * 隣接プロセス数が想定内に収まっているのか確認する。
      */
     assert(commData_->peer_buffers_.size() <= MAX_NEIGHBORS);
 
     requests.resize(2*commData_->peer_buffers_.size());
-    statuses.resize(2*commData_->peer_buffers_.size());
 
     // MPI_Barrier(MPI_COMM_WORLD);
     // 全隣接プロセスについてのループ
     for (i = 0; i < commData_->peer_buffers_.size(); i++) {
+        if (!shared_index_.empty() && shared_index_[i] >= 0) {
+            // 同じノードのpeerとは共有メモリで授受する
+            requests[2*i] = MPI_REQUEST_NULL;
+            requests[2*i+1] = MPI_REQUEST_NULL;
+            continue;
+        }
         // 通信準備
         sendDataMPIPre();
 
         // 通信処理の本体
         sendDataMPI();
     }
+    if (shared_win_ != MPI_WIN_NULL) {
+        startSharedExchange();
+    }
+    start_time_ += MPI_Wtime() - t;
+}
 
+void CfdCommunicator::waitExchange() {
+    double t = MPI_Wtime();
     // 同期
-    MPI_Waitall(requests.size(),&requests[0], &statuses[0]);
+    if (!active_requests_->empty()) {
+        MPI_Waitall(active_requests_->size(), &(*active_requests_)[0], MPI_STATUSES_IGNORE);
+    }
+    if (shared_win_ != MPI_WIN_NULL) {
+        waitSharedExchange();
+    }
+    wait_time_ += MPI_Wtime() - t;
 }
 
 // 通信処理の準備
@@ -6,6 +6,8 @@
 #include <Logger.h>
 
 #include <mpi.h>
+#include <algorithm>
+#include <vector>
 
 CfdDriver::~CfdDriver() {
 }
@@ -29,6 +31,14 @@ void CfdDriver::init(int np, int rank, const char *filename) {
     state_.reset();
 
     correctVelocityCounter_=0;
+    extraCorrectionCounter_=0;
+    peerDiameter_=0;
+    numColors_=1;
+    activeElementCounter_=0;
+    allElementCounter_=0;
+    accelerationCounter_=0;
+    pressureSolveCapped_=0;
+    pressureSolveBreakdowns_=0;
 
     // 一旦同期を取る
     MPI_Barrier(MPI_COMM_WORLD);
@@ -39,6 +49,20 @@ void CfdDriver::readDataFile() {
     procData_.readMeshFile();
     // 読み込んだ形状データの中から、自プロセスが担当するデータを特定する
     procData_.findOwnData();
+    // 隣接プロセスが決まったので、送受信の準備をする
+    communicator_.initRequests();
+    if (params_.convergence_check_ == "piggyback") {
+        peerDiameter_ = communicator_.peerGraphDiameter();
+        Logger::out << "convergence check : piggyback, peer graph diameter " << peerDiameter_ << std::endl;
+    }
+    if (params_.correction_order_ == "multicolor") {
+        // 色ごとの送受信の回数をそろえるため、全プロセスでの色の数の最大値を使う
+        int colors = procData_.numColors();
+        MPI_Allreduce(&colors, &numColors_, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        numColors_ = std::max(numColors_, 1);
+        Logger::out << "correction order : multicolor, " << colors << " colors ("
+                << numColors_ << " on all processes)" << std::endl;
+    }
     // 境界条件データを読む
     procData_.readBoundaryFile();
 }
@@ -61,12 +85,22 @@ void CfdDriver::calcInvariants() {
 }
 
 void CfdDriver::doStep() {
-    // 速度予測値の計算
-    procData_.calcVelocityPrediction();
-
-    // 隣接プロセッサーと速度変化量の共有
-    procData_.gatherVelocityDelta();
-    communicator_.exchangeBoundaryValues();
+    if (params_.halo_overlap_ == "on") {
+        // 境界の要素の速度予測値を計算し、隣接プロセッサーとの速度変化量の送受信を始める。
+        // 受信を待つ間に内部の要素を計算する。
+        procData_.calcVelocityPrediction(ElementBlock::PART_BOUNDARY);
+        procData_.gatherVelocityDelta();
+        communicator_.startExchange();
+        procData_.calcVelocityPrediction(ElementBlock::PART_INTERIOR);
+        communicator_.waitExchange();
+    } else {
+        // 速度予測値の計算
+        procData_.calcVelocityPrediction();
+
+        // 隣接プロセッサーと速度変化量の共有
+        procData_.gatherVelocityDelta();
+        communicator_.exchangeBoundaryValues();
+    }
     procData_.distributeVelocityDelta();
 
     // 速度変化の適用
@@ -89,31 +123,342 @@ void CfdDriver::doStep() {
 
 // 速度補正ループ
 void CfdDriver::correctVelocity() {
+    if (procData_.pressureSolverEnabled()) {
+        correctVelocityPcg();
+        return;
+    }
+    if (params_.correction_async_ == "on") {
+        correctVelocityAsync();
+        return;
+    }
     bool isNotDivergence;
-    bool isNotDivergenceAll;
     size_t i = 0;
     int max_corrections = params_.max_corrections_;
+    // multicolor の場合は、色ごとに送受信するので境界と内部に分けない
+    bool multicolor = (params_.correction_order_ == "multicolor");
+    // correction_acceleration anderson の場合は、全要素を補正した後に外挿した補正量を加えてから
+    // 送受信するので、境界と内部に分けない
+    bool anderson = (procData_.accelerationEnabled() && !multicolor);
+    bool overlap = (params_.halo_overlap_ == "on" && !multicolor && !anderson);
+    // anderson の場合に、外挿に使う内積の自プロセス分と全体の和。
+    // 末尾には閾値を超える要素があったプロセスの数を載せ、収束の確認も同じ MPI_Allreduce で行う
+    std::vector<double> dots(anderson ? procData_.numAccelerationDots() + 1 : 0);
+    std::vector<double> dotsAll(dots.size());
+    // active_set on の場合に、判別式を計算する要素を反復ごとに更新する。
+    // 最初の反復と active_set_recheck 回ごとの反復では全要素を計算する
+    bool activeSet = (params_.active_set_ == "on");
+    size_t numElements = 0;
+    bool pipelined = (params_.convergence_check_ == "pipelined");
+    int interval = params_.convergence_interval_;
+    // 自プロセスで最後に補正した反復と、その全体での最大値 (補正していなければ -1)。
+    // 収束を確かめる反復までに全体で補正が止まっていれば、止まった反復が分かる
+    long lastCorrected = -1;
+    long lastCorrectedAll;
+    // pipelined の場合に、発行して結果をまだ受け取っていない収束確認と、それを発行した反復。
+    // 送信側の値は受け取るまで変えないように、別の変数に写しておく
+    MPI_Request checkRequest = MPI_REQUEST_NULL;
+    long lastCorrectedPosted;
+    size_t checkStep = 0;
+    // piggyback の場合に、自プロセスとその周りで続けて補正が起きなかった反復数の下限と、
+    // 隣接プロセスから受け取ったその最小値。隣接プロセスの値には、それが届くまでの反復数 lag を
+    // 足して使う。全体で補正が止まった後は、どのプロセスでも同じ値になる
+    bool piggyback = (params_.convergence_check_ == "piggyback" && !anderson);
+    long quiet = 0;
+    long quietReceived = 0;
+    long lag = overlap ? 2 : 1;
+    // quiet がこれ以上なら、最も遠いプロセスも含めて全体で補正が止まった反復がある
+    long threshold = lag * peerDiameter_ + 1;
+    // 全体で何も補正しなくなった反復。それ以後の反復も何も補正しない
+    bool converged = false;
+    size_t convergedStep = 0;
+    // relaxation_adaptive on の場合に、速度予測の前の判別式と比べないようにする
+    procData_.clearRelaxationHistory();
+    // 圧力の反復の変わり方は時間ステップごとに変わるので、前のステップの履歴は使わない
+    procData_.clearAccelerationHistory();
     for(i = 0; i < max_corrections; i++){
+        if (activeSet) {
+            bool all = (i % params_.active_set_recheck_ == 0);
+            size_t active = procData_.updateActiveElements(all);
+            if (all) {
+                numElements = active;
+            }
+            activeElementCounter_ += active;
+            allElementCounter_ += numElements;
+        }
         // 閾値を超える要素があれば補正してtrueを返す
-        isNotDivergence=procData_.calcDivergenceAndCorrect();
+        if (multicolor) {
+            // 最後の色以外は、その色を補正したら隣接プロセスと速度変化量を送受信して
+            // 速度に反映し、次の色は反映後の速度から判別式を求める。
+            // 最後の色の補正は、jacobi と同様に反復の終わりに送受信して反映する
+            isNotDivergence = false;
+            for (int c = 0; c + 1 < numColors_; c++) {
+                if (procData_.calcDivergenceAndCorrectColor(c)) {
+                    isNotDivergence = true;
+                }
+                procData_.gatherVelocityDelta();
+                communicator_.exchangeBoundaryValues();
+                procData_.distributeVelocityDelta();
+                procData_.applyVelocityDeltaAndClear();
+                procData_.applyBoundaryConditions();
+                if (activeSet) {
+                    // 次の色の判別式は、この色の補正で速度が変わった節点を持つ要素も計算する
+                    procData_.updateActiveElements(false);
+                }
+            }
+            if (procData_.calcDivergenceAndCorrectColor(numColors_ - 1)) {
+                isNotDivergence = true;
+            }
+        } else if (overlap) {
+            // doStepと同様に、境界の要素を補正して送受信を始めてから内部の要素を補正する。
+            // 全体で収束していた場合は、送った速度変化量は使わずに捨てる。
+            isNotDivergence=procData_.calcDivergenceAndCorrect(ElementBlock::PART_BOUNDARY);
+            procData_.gatherVelocityDelta();
+            if (piggyback) {
+                // 今回の補正が終わる前に送るので、前回の値を載せる
+                commData_.setPiggyback(quiet);
+            }
+            communicator_.startExchange();
+            if (procData_.calcDivergenceAndCorrect(ElementBlock::PART_INTERIOR)) {
+                isNotDivergence = true;
+            }
+        } else if (anderson) {
+            // 全要素を補正し、外挿に使う内積と収束の確認を1回の MPI_Allreduce でまとめて足し合わせる
+            procData_.beginAcceleration();
+            isNotDivergence=procData_.calcDivergenceAndCorrectAll();
+            procData_.calcAccelerationDots(dots.data());
+            dots.back() = isNotDivergence ? 1 : 0;
+            MPI_Allreduce(dots.data(), dotsAll.data(), (int)dots.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+            if (dotsAll.back() == 0) {
+                // 全体で閾値を超える要素がなかった。閾値以下の要素の補正は取り消す
+                procData_.cancelAcceleration();
+                converged = true;
+                convergedStep = i;
+            } else if (procData_.accelerate(dotsAll.data())) {
+                accelerationCounter_++;
+            }
+        } else {
+            isNotDivergence=procData_.calcDivergenceAndCorrect();
+        }
+
+        if (isNotDivergence) {
+            lastCorrected = i;
+        }
+        // 次の補正で使う要素ごとの緩和係数を調整する (relaxation_adaptive on)
+        procData_.adaptRelaxation();
+
+        if (piggyback) {
+            quiet = isNotDivergence ? 0 : std::min(quiet + 1, quietReceived + lag);
+            if (quiet >= threshold) {
+                converged = true;
+                convergedStep = i + 1 - quiet;
+            }
+        }
 
-        // MPI_Allreduce(void* send_data,void* recv_data,int count,MPI_Datatype datatype,MPI_Op op,MPI_Comm communicator)
-        MPI_Allreduce(&isNotDivergence, &isNotDivergenceAll, 1, MPI_C_BOOL, MPI_LOR, MPI_COMM_WORLD);
-        if(!isNotDivergenceAll){
+        // 前の反復で発行した収束確認の結果を受け取る。
+        // 収束していたら、その後の補正 (今回の分を含む) は何も変えていない
+        if (checkRequest != MPI_REQUEST_NULL) {
+            MPI_Wait(&checkRequest, MPI_STATUS_IGNORE);
+            if (lastCorrectedAll < (long)checkStep) {
+                converged = true;
+                convergedStep = lastCorrectedAll + 1;
+            }
+        }
+        if (!converged && !piggyback && !anderson && i % interval == 0) {
+            if (pipelined) {
+                lastCorrectedPosted = lastCorrected;
+                MPI_Iallreduce(&lastCorrectedPosted, &lastCorrectedAll, 1, MPI_LONG, MPI_MAX,
+                        MPI_COMM_WORLD, &checkRequest);
+                checkStep = i;
+            } else {
+                // MPI_Allreduce(void* send_data,void* recv_data,int count,MPI_Datatype datatype,MPI_Op op,MPI_Comm communicator)
+                MPI_Allreduce(&lastCorrected, &lastCorrectedAll, 1, MPI_LONG, MPI_MAX, MPI_COMM_WORLD);
+                if (lastCorrectedAll < (long)i) {
+                    converged = true;
+                    convergedStep = lastCorrectedAll + 1;
+                }
+            }
+        }
+        if(converged){
+            if (overlap) {
+                communicator_.waitExchange();
+            }
             procData_.clearVelocityDelta();
-            Logger::out << "Correction ended at correction step : " << i << std::endl;
+            Logger::out << "Correction ended at correction step : " << convergedStep;
+            if (i > convergedStep) {
+                Logger::out << " (" << i - convergedStep << " extra corrections)";
+            }
+            Logger::out << std::endl;
             break;//収束してないのがなければ速度補正ループ終了．
         }
 
         // doStepと同様な操作
-        procData_.gatherVelocityDelta();
-        communicator_.exchangeBoundaryValues();
+        if (overlap) {
+            communicator_.waitExchange();
+        } else {
+            procData_.gatherVelocityDelta();
+            if (piggyback) {
+                commData_.setPiggyback(quiet);
+            }
+            communicator_.exchangeBoundaryValues();
+        }
+        if (piggyback) {
+            quietReceived = (long)commData_.minPiggyback(quiet);
+        }
         procData_.distributeVelocityDelta();
 
         procData_.applyVelocityDeltaAndClear();
 
         procData_.applyBoundaryConditions();
     }
+    if (checkRequest != MPI_REQUEST_NULL) {
+        // max_corrections に達した場合。結果は使わない
+        MPI_Wait(&checkRequest, MPI_STATUS_IGNORE);
+    }
+    if (converged) {
+        // 全体で補正が止まった後、収束を確かめるまでに行った補正は数えずに、別に数える
+        extraCorrectionCounter_ += i - convergedStep;
+        i = convergedStep;
+    }
+    correctVelocityCounter_+=i;
+    Logger::out << "Correction Total is : " << correctVelocityCounter_ << std::endl;
+}
+
+/*
+ * 非同期の速度補正ループ (correction_async on)。
+ * 隣接プロセスとは待ち合わせず、補正した反復だけ速度変化量を送り、届いている分を反映して進む。
+ * 全体の収束は、前回の確認の後に補正も受信もしなかったプロセスばかりで、
+ * 送ったメッセージが全て届いている (送った数と受け取った数の合計が等しい) ことで確かめる。
+ * 各プロセスは前回の確認の結果を受け取ってから次の確認を発行するので、確認の間に
+ * 少なくとも1回の反復があり、確認より後に送られたメッセージが数に紛れ込むことはない。
+ */
+void CfdDriver::correctVelocityAsync() {
+    bool isNotDivergence;
+    bool received;
+    int i;
+    int max_corrections = params_.max_corrections_;
+    // 前回の確認を発行した後に、補正したか、速度変化量を受け取ったか
+    bool active = false;
+    // 確認の値と、その全体での和
+    //   [0] 補正か受信があったプロセスの数
+    //   [1] 送ったメッセージの数 - 受け取ったメッセージの数
+    //   [2] 反復数の上限に達したプロセスの数
+    long check[3];
+    long checkAll[3];
+    MPI_Request checkRequest = MPI_REQUEST_NULL;
+    bool finished = false;
+    for (i = 0; !finished; i++) {
+        isNotDivergence = procData_.calcDivergenceAndCorrect();
+        if (isNotDivergence) {
+            // 補正しなかった反復では速度変化量は0なので送らない
+            procData_.gatherVelocityDelta();
+            communicator_.sendAsync();
+        }
+        received = (communicator_.receiveAsync() > 0);
+        if (received) {
+            procData_.distributeVelocityDelta();
+        }
+        if (isNotDivergence || received) {
+            procData_.applyVelocityDeltaAndClear();
+            procData_.applyBoundaryConditions();
+            active = true;
+        }
+
+        bool limit = (i + 1 >= max_corrections);
+        if (checkRequest != MPI_REQUEST_NULL) {
+            int done = 1;
+            if (limit) {
+                // 反復数の上限に達したら、それ以上補正せずに確認の結果を待つ
+                MPI_Wait(&checkRequest, MPI_STATUS_IGNORE);
+            } else {
+                MPI_Test(&checkRequest, &done, MPI_STATUS_IGNORE);
+            }
+            if (done && ((checkAll[0] == 0 && checkAll[1] == 0) || checkAll[2] > 0)) {
+                finished = true;
+            }
+        }
+        if (!finished && checkRequest == MPI_REQUEST_NULL) {
+            check[0] = active ? 1 : 0;
+            check[1] = communicator_.asyncSent() - communicator_.asyncReceived();
+            check[2] = limit ? 1 : 0;
+            MPI_Iallreduce(check, checkAll, 3, MPI_LONG, MPI_SUM, MPI_COMM_WORLD, &checkRequest);
+            active = false;
+            if (limit) {
+                MPI_Wait(&checkRequest, MPI_STATUS_IGNORE);
+                finished = true;
+            }
+        }
+    }
+    // 反復数の上限で終えた場合は、まだ届いていない速度変化量を受け取って反映する
+    int late = communicator_.finishAsync();
+    if (late > 0) {
+        procData_.distributeVelocityDelta();
+        procData_.applyVelocityDeltaAndClear();
+        procData_.applyBoundaryConditions();
+    }
+    procData_.clearVelocityDelta();
+    Logger::out << "Correction ended at correction step : " << i << " (async";
+    if (late > 0) {
+        Logger::out << ", " << late << " late messages";
+    }
+    Logger::out << ")" << std::endl;
+    correctVelocityCounter_+=i;
+    Logger::out << "Correction Total is : " << correctVelocityCounter_ << std::endl;
+}
+
+/*
+ * 圧力補正量の連立1次方程式を前処理付き共役勾配法で解く速度補正 (correction_solver pcg)。
+ * 反復ごとに、探索方向による共有節点の速度変化量を隣接プロセスと送受信して行列との積を求め、
+ * 内積と閾値を超える要素の数を MPI_Allreduce で足し合わせる。全体で閾値を超える要素が
+ * なくなったら、解いた補正量で圧力と速度を1度に補正し、速度補正の反復と同様に反映する。
+ * 反復数は速度補正の反復数として数える。
+ */
+void CfdDriver::correctVelocityPcg() {
+    int i;
+    int max_corrections = params_.max_corrections_;
+    // 送受信の間に局所行列と探索方向の積を求める
+    bool overlap = (params_.halo_overlap_ == "on");
+    std::vector<double> dots(procData_.numPressureSolverDots());
+    std::vector<double> dotsAll(dots.size());
+    procData_.beginPressureSolve(dots.data());
+    MPI_Allreduce(dots.data(), dotsAll.data(), (int)dots.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    bool breakdown = false;
+    for (i = 0; i < max_corrections && dotsAll[1] > 0; i++) {
+        procData_.nextPressureDirection(dotsAll.data());
+        procData_.gatherPressureDirection();
+        if (overlap) {
+            communicator_.startExchange();
+            procData_.multiplyPressureLocal();
+            communicator_.waitExchange();
+        } else {
+            communicator_.exchangeBoundaryValues();
+            procData_.multiplyPressureLocal();
+        }
+        procData_.distributeVelocityDelta();
+        procData_.multiplyPressureInterface(dots.data());
+        MPI_Allreduce(dots.data(), dotsAll.data(), 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        if (!procData_.updatePressureSolution(dotsAll.data(), dots.data())) {
+            breakdown = true;
+            break;
+        }
+        MPI_Allreduce(dots.data(), dotsAll.data(), (int)dots.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    }
+    Logger::out << "Correction ended at correction step : " << i << " (pcg";
+    if (breakdown) {
+        pressureSolveBreakdowns_++;
+        Logger::out << ", breakdown";
+    } else if (dotsAll[1] > 0) {
+        pressureSolveCapped_++;
+        Logger::out << ", " << dotsAll[1] << " elements above epsilon";
+    }
+    Logger::out << ")" << std::endl;
+    if (i > 0) {
+        procData_.applyPressureSolution();
+        procData_.gatherVelocityDelta();
+        communicator_.exchangeBoundaryValues();
+        procData_.distributeVelocityDelta();
+        procData_.applyVelocityDeltaAndClear();
+        procData_.applyBoundaryConditions();
+    }
     correctVelocityCounter_+=i;
     Logger::out << "Correction Total is : " << correctVelocityCounter_ << std::endl;
 }
@@ -124,6 +469,50 @@ void CfdDriver::outputVariables() {
 }
 
 void CfdDriver::finalize() {
+    procData_.logThreadStats();
+    communicator_.finalize();
+    if (procData_.pressureSolverEnabled()) {
+        Logger::out << "correction solver : pcg, preconditioner " << params_.pcg_preconditioner_
+                << ", capped steps " << pressureSolveCapped_ << ", breakdowns " << pressureSolveBreakdowns_
+                << ", halo exchanges per iteration : 1" << std::endl;
+    } else if (params_.correction_async_ == "on") {
+        // 非同期の場合はプロセスごとに反復数が違うので、その最小値と最大値を出す
+        int minCounter, maxCounter;
+        MPI_Allreduce(&correctVelocityCounter_, &minCounter, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        MPI_Allreduce(&correctVelocityCounter_, &maxCounter, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        Logger::out << "async correction : corrections per process min " << minCounter
+                << ", max " << maxCounter << std::endl;
+    } else {
+        if (procData_.accelerationEnabled() && params_.correction_order_ != "multicolor") {
+            // 外挿に使う内積と同じ MPI_Allreduce で毎回確かめる
+            Logger::out << "convergence check : with correction acceleration, extra corrections : "
+                    << extraCorrectionCounter_ << std::endl;
+        } else {
+            Logger::out << "convergence check : " << params_.convergence_check_ << ", interval "
+                    << params_.convergence_interval_ << ", extra corrections : " << extraCorrectionCounter_ << std::endl;
+        }
+        Logger::out << "correction order : " << params_.correction_order_ << ", halo exchanges per correction : "
+                << (params_.correction_order_ == "multicolor" ? numColors_ : 1) << std::endl;
+        if (params_.relaxation_adaptive_ == "on") {
+            Logger::out << "relaxation adaptive : mean " << procData_.meanRelaxation()
+                    << " (initial " << params_.relaxation_ << ")" << std::endl;
+        }
+        if (procData_.accelerationEnabled()) {
+            if (params_.correction_order_ == "multicolor") {
+                Logger::out << "correction acceleration : anderson is not used with correction order multicolor"
+                        << std::endl;
+            } else {
+                Logger::out << "correction acceleration : anderson, depth " << params_.anderson_depth_
+                        << ", accelerated corrections " << accelerationCounter_
+                        << ", restarts " << procData_.accelerationRestarts() << std::endl;
+            }
+        }
+        if (params_.active_set_ == "on") {
+            Logger::out << "active set : recheck " << params_.active_set_recheck_ << ", elements evaluated "
+                    << (allElementCounter_ > 0 ? 100.0 * activeElementCounter_ / allElementCounter_ : 0.0)
+                    << " % of all" << std::endl;
+        }
+    }
     // 最後まで達したことをログに記録してクローズ
     Logger::out << "Ending." << std::endl;
     Logger::closeLog();
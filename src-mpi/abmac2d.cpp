@@ -3,6 +3,7 @@
  */
 #include <CfdDriver.h>
 #include <iostream>
+#include <cstdlib>
 
 #include <mpi.h>
 
@@ -15,6 +16,10 @@
  * MPIの起動時のプロセス数は、計算対象データと整合している必要がある。
  *
  * 引数は計算条件ファイル名。
+ * 第2引数を与えると、計算条件ファイルの threads (1プロセスあたりのスレッド数) を上書きする。
+ * mpirun -np 4 abmac2d <casefile> 4
+ * スレッドはOpenMPを有効にしてコンパイルした場合のみ使われる。
+ * MPIの関数はメインスレッドだけが呼ぶ (MPI_THREAD_FUNNELED)。
  */
 int main(int argc, char *argv[]) {
 
@@ -23,18 +28,27 @@ int main(int argc, char *argv[]) {
     int rank;
     int num_procs;
     double real_time_start;
+    int threads = 0;
+    int provided;
 
-    if (argc != 2) {
-        std::cerr << "Usage : abmac2d casefile\n";
+    if (argc != 2 && argc != 3) {
+        std::cerr << "Usage : abmac2d casefile [threads]\n";
         exit(1);
     }
 
     const char *filename = argv[1];
+    if (argc == 3) {
+        threads = std::atoi(argv[2]);
+        if (threads < 1) {
+            std::cerr << "threads must be a positive integer : " << argv[2] << "\n";
+            exit(1);
+        }
+    }
 
     // CfdDriverが上げる例外に備えて try 節で囲む
     try {
-        // MPIを初期化する
-        MPI_Init(&argc, &argv);
+        // MPIを初期化する。スレッドを使う場合もMPIの関数は並列領域の外でメインスレッドだけが呼ぶ。
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 
         real_time_start = MPI_Wtime();
 
@@ -48,6 +62,13 @@ int main(int argc, char *argv[]) {
          */
         // (1) ドライバーの初期化。計算条件ファイルの読み込みとrankの記録。
         driver.init(num_procs, rank, filename);
+        if (threads > 0) {
+            driver.getParams()->threads_ = threads;
+        }
+        if (driver.getParams()->threads_ > 1 && provided < MPI_THREAD_FUNNELED) {
+            std::cerr << "MPI does not support MPI_THREAD_FUNNELED. Running with 1 thread per rank\n";
+            driver.getParams()->threads_ = 1;
+        }
 
         driver.tryMain(real_time_start);
 
@@ -0,0 +1,104 @@
+/*
+ * bench_CfdCommunicator.cpp
+ *
+ * 隣接プロセスとの送受信1回あたりの時間を、送受信の方法ごとに測るプログラム。
+ *
+ * 使い方:
+ *   mpirun -np <プロセス数> bench_CfdCommunicator [nodes [repeat]]
+ *
+ * 各プロセスはランク番号の前後 (±1, ±2) のプロセスを隣接プロセスとし、それぞれと
+ * nodes 個の節点を共有しているものとして、質量 (節点あたり1つ) と速度変化量
+ * (節点あたり2つ) の送受信を repeat 回ずつ行う。
+ * 送受信の方法 (isend, persistent, neighbor, shared) ごとに、1回あたりの時間の全プロセスでの最大値を
+ * rank 0 が表示する。各プロセスの内訳は bench_CfdCommunicator.log.<rank>.txt に出力される。
+ */
+
+#include <CfdCommunicator.h>
+#include <Logger.h>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+/*
+ * 1つの方法で計測する。payload は節点あたりの値の数。
+ */
+double measure(const char *exchange, int nodes, int payload, int repeat, int rank, int np) {
+    Params params;
+    State state;
+    CfdCommData data;
+    CfdCommunicator comm;
+    int i, j, r;
+
+    params.num_procs_ = np;
+    params.my_rank_ = rank;
+    params.halo_exchange_ = exchange;
+    state.reset();
+    data.init(&params, &state);
+    for (i = -2; i <= 2; i++) {
+        int peer = ((rank + i) % np + np) % np;
+        if (i == 0 || peer == rank) {
+            continue;
+        }
+        // プロセス数が少ないと同じ相手が2度出てくる
+        CfdCommPeerBuffer *buffer = data.findOrCreatePeerBufferForRank(peer);
+        if (!buffer->nodes_.empty()) {
+            continue;
+        }
+        for (j = 0; j < nodes; j++) {
+            buffer->addNode(j);
+        }
+    }
+    comm.init(&params, &state, &data);
+    comm.initRequests();
+    for (i = 0; i < (int)data.peer_buffers_.size(); i++) {
+        data.peer_buffers_[i].send_buffer_.assign(nodes*payload, 1.0);
+        data.peer_buffers_[i].recv_buffer_.resize(nodes*payload);
+    }
+
+    // 1回目は計測に含めない
+    comm.exchangeBoundaryValues();
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    for (r = 0; r < repeat; r++) {
+        comm.exchangeBoundaryValues();
+    }
+    double t = (MPI_Wtime() - start) / repeat;
+    comm.finalize();
+
+    double t_max;
+    MPI_Reduce(&t, &t_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    return t_max;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    int rank, np;
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+    Logger::openLog("bench_CfdCommunicator", rank);
+
+    int nodes = argc >= 2 ? std::atoi(argv[1]) : 100;
+    int repeat = argc >= 3 ? std::atoi(argv[2]) : 10000;
+    if (rank == 0) {
+        std::cout << "processes : " << np << ", nodes per peer : " << nodes
+                << ", repeat : " << repeat << std::endl;
+    }
+    const char *exchanges[] = {"isend", "persistent", "neighbor", "shared"};
+    const char *payloads[] = {"", "mass", "velocity"};
+    for (int payload = 1; payload <= 2; payload++) {
+        for (int k = 0; k < 4; k++) {
+            double t = measure(exchanges[k], nodes, payload, repeat, rank, np);
+            if (rank == 0) {
+                std::cout << exchanges[k] << " " << payloads[payload] << " : "
+                        << 1.0e6 * t << " us per exchange" << std::endl;
+            }
+        }
+    }
+
+    Logger::closeLog();
+    MPI_Finalize();
+    return 0;
+}
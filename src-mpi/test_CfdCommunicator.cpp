@@ -34,7 +34,19 @@ public:
     void setup();
 
     // 項目別テスト（１）exchangeBoundaryValuesのテスト
-    void testExchange();
+    // split なら startExchange と waitExchange に分けて呼ぶ
+    void testExchange(bool split);
+
+    // 項目別テスト（3）initRequests() の後に、質量と速度変化量を交互に送受信するテスト
+    // exchange は送受信の方法 (persistent : 永続的な送受信要求、neighbor : 近傍集団通信、
+    // shared : 共有メモリ)。piggyback は速度変化量の末尾に付け足す値の数
+    void testPersistent(const char *exchange, int piggyback = 0);
+
+    // 項目別テスト（4）隣接プロセスのグラフの直径を求めるテスト
+    void testDiameter();
+
+    // 項目別テスト（5）非同期の速度補正のための送受信のテスト
+    void testAsync();
 
     // 項目別テスト（2）収束を全体で確認するテスト
     void testDivergence(int);
@@ -52,7 +64,7 @@ void TestCfdCommunicator::setup()
 
 }
 
-void TestCfdCommunicator::testExchange()
+void TestCfdCommunicator::testExchange(bool split)
 {
     /* prepare buffers and data for all other ranks except myself */
     int i;
@@ -77,7 +89,12 @@ void TestCfdCommunicator::testExchange()
     }
 
     /* MPI communication. send out send_buffers and receive to recv_buffers */
-    comm_.exchangeBoundaryValues();
+    if (split) {
+        comm_.startExchange();
+        comm_.waitExchange();
+    } else {
+        comm_.exchangeBoundaryValues();
+    }
 
     /* check that we received correct data. */
     for (i = 0; i < num_procs_; i++) {
@@ -96,6 +113,141 @@ void TestCfdCommunicator::testExchange()
     }
 }
 
+void TestCfdCommunicator::testPersistent(const char *exchange, int piggyback)
+{
+    Params params;
+    CfdCommData data;
+    CfdCommunicator comm;
+    int i, j, round;
+    params.num_procs_ = num_procs_;
+    params.my_rank_ = my_rank_;
+    params.halo_exchange_ = exchange;
+    data.init(&params, &state_);
+    data.piggyback_ = piggyback;
+    /* 3 boundary nodes with every other rank */
+    for (i = 0; i < num_procs_; i++) {
+        if (i != my_rank_) {
+            for (j = 0; j < 3; j++) {
+                data.addBoundaryNode(i, j);
+            }
+        }
+    }
+    comm.init(&params, &state_, &data);
+    comm.initRequests();
+
+    /* the same requests are started again in each round */
+    for (round = 0; round < 2; round++) {
+        /* payload 1 : mass (1 value per node), 2 : velocity delta (2 values per node) */
+        for (int payload = 1; payload <= 2; payload++) {
+            int size = (payload == 1) ? 3 : 6 + piggyback;
+            for (i = 0; i < (int)data.peer_buffers_.size(); i++) {
+                CfdCommPeerBuffer &peer = data.peer_buffers_[i];
+                peer.send_buffer_.resize(size);
+                peer.recv_buffer_.resize(size);
+                for (j = 0; j < size; j++) {
+                    /* 10000 * sender_rank + 100 * receiver_rank + 10 * round + array index */
+                    peer.send_buffer_[j] = 10000*my_rank_ + 100*peer.rank_ + 10*round + j;
+                }
+            }
+            comm.exchangeBoundaryValues();
+            for (i = 0; i < (int)data.peer_buffers_.size(); i++) {
+                CfdCommPeerBuffer &peer = data.peer_buffers_[i];
+                dbl_equals(peer.recv_buffer_[0], 10000*peer.rank_ + 100*my_rank_ + 10*round);
+                dbl_equals(peer.recv_buffer_[size - 1], 10000*peer.rank_ + 100*my_rank_ + 10*round + size - 1);
+            }
+        }
+    }
+    comm.finalize();
+}
+
+void TestCfdCommunicator::testDiameter()
+{
+    // setup 後の testExchange で全プロセスどうしが隣接している
+    int_equals(comm_.peerGraphDiameter(), num_procs_ > 1 ? 1 : 0);
+
+    /* ranks in a line : rank-1 and rank+1 are the peers */
+    Params params;
+    CfdCommData data;
+    CfdCommunicator comm;
+    params.num_procs_ = num_procs_;
+    params.my_rank_ = my_rank_;
+    data.init(&params, &state_);
+    if (my_rank_ > 0) {
+        data.addBoundaryNode(my_rank_ - 1, 0);
+    }
+    if (my_rank_ < num_procs_ - 1) {
+        data.addBoundaryNode(my_rank_ + 1, 0);
+    }
+    comm.init(&params, &state_, &data);
+    int_equals(comm.peerGraphDiameter(), num_procs_ - 1);
+}
+
+void TestCfdCommunicator::testAsync()
+{
+    Params params;
+    CfdCommData data;
+    CfdCommunicator comm;
+    int i, j;
+    params.num_procs_ = num_procs_;
+    params.my_rank_ = my_rank_;
+    data.init(&params, &state_);
+    /* 3 boundary nodes with every other rank */
+    for (i = 0; i < num_procs_; i++) {
+        if (i != my_rank_) {
+            for (j = 0; j < 3; j++) {
+                data.addBoundaryNode(i, j);
+            }
+        }
+    }
+    comm.init(&params, &state_, &data);
+    comm.initRequests();
+    int num_peers = data.peer_buffers_.size();
+
+    /* two messages to every peer. 100 * sender_rank + 10 * message + array index */
+    for (int message = 1; message <= 2; message++) {
+        for (i = 0; i < num_peers; i++) {
+            CfdCommPeerBuffer &peer = data.peer_buffers_[i];
+            peer.send_buffer_.resize(6);
+            for (j = 0; j < 6; j++) {
+                peer.send_buffer_[j] = 100*my_rank_ + 10*message + j;
+            }
+        }
+        comm.sendAsync();
+    }
+    /* the buffer can be overwritten right after sendAsync() */
+    for (i = 0; i < num_peers; i++) {
+        data.peer_buffers_[i].send_buffer_.assign(6, -1.0);
+    }
+    /* wait for the rest, the received values are summed up */
+    int received = comm.finishAsync();
+    int_equals(received, 2*num_peers);
+    for (i = 0; i < num_peers; i++) {
+        CfdCommPeerBuffer &peer = data.peer_buffers_[i];
+        dbl_equals(peer.recv_buffer_[0], 2*100*peer.rank_ + 30);
+        dbl_equals(peer.recv_buffer_[5], 2*100*peer.rank_ + 30 + 10);
+    }
+
+    /* poll until one more message from every peer has arrived */
+    for (i = 0; i < num_peers; i++) {
+        data.peer_buffers_[i].send_buffer_.assign(6, my_rank_ + 1.0);
+    }
+    comm.sendAsync();
+    double sum = 0;
+    received = 0;
+    while (received < num_peers) {
+        received += comm.receiveAsync();
+        for (i = 0; i < num_peers; i++) {
+            sum += data.peer_buffers_[i].recv_buffer_[0];
+        }
+    }
+    int_equals(received, num_peers);
+    dbl_equals(sum, num_procs_*(num_procs_ + 1)/2 - (my_rank_ + 1));
+    int_equals(comm.finishAsync(), 0);
+    int_equals(comm.asyncSent(), 3*num_peers);
+    int_equals(comm.asyncReceived(), 3*num_peers);
+    comm.finalize();
+}
+
 void TestCfdCommunicator::testDivergence(int my_rank_)
 {
     bool isNotDivergence;
@@ -113,7 +265,16 @@ void TestCfdCommunicator::testDivergence(int my_rank_)
 void TestCfdCommunicator::run()
 {
     setup();
-    testExchange();
+    testExchange(false);
+    testExchange(true);
+    testPersistent("persistent");
+    testPersistent("neighbor");
+    testPersistent("shared");
+    testPersistent("persistent", 1);
+    testPersistent("neighbor", 1);
+    testPersistent("shared", 1);
+    testDiameter();
+    testAsync();
     // testDivergence(my_rank_);
     // Logger::out << my_rank_ << std::endl;
 }
@@ -0,0 +1,187 @@
+/*
+ * AndersonAcceleration.cpp
+ */
+
+#include <AndersonAcceleration.h>
+#include <algorithm>
+#include <cmath>
+
+// 内積の行列の対角成分の最大値に対する、対角に足す値の割合。
+// 差分がほぼ1次従属になっても係数が発散しないようにする
+static const double REGULARIZATION = 1.0e-10;
+
+AndersonAcceleration::AndersonAcceleration() {
+    init(0, 1);
+}
+
+void AndersonAcceleration::init(size_t n, int depth) {
+    n_ = n;
+    depth_ = std::max(depth, 1);
+    x_.assign(n, 0.0);
+    f_prev_.assign(n, 0.0);
+    g_prev_.assign(n, 0.0);
+    f_.assign(n, 0.0);
+    dF_.assign(n * depth_, 0.0);
+    dG_.assign(n * depth_, 0.0);
+    gram_.assign(depth_ * depth_, 0.0);
+    restarts_ = 0;
+    clear();
+}
+
+void AndersonAcceleration::clear() {
+    count_ = 0;
+    head_ = 0;
+    last_ = -1;
+    have_prev_ = false;
+}
+
+bool AndersonAcceleration::valid(int slot) const {
+    // 履歴が一杯になるまでは位置 0 から順に使う
+    return slot < count_;
+}
+
+void AndersonAcceleration::begin(const double *x) {
+    std::copy(x, x + n_, x_.begin());
+}
+
+void AndersonAcceleration::restore(double *x) const {
+    std::copy(x_.begin(), x_.end(), x);
+}
+
+void AndersonAcceleration::localDots(const double *g, double *dots) {
+    size_t k;
+    int j;
+    for (k = 0; k < n_; k++) {
+        f_[k] = g[k] - x_[k];
+    }
+    last_ = -1;
+    if (have_prev_) {
+        last_ = head_;
+        double *dF = &dF_[last_ * n_];
+        double *dG = &dG_[last_ * n_];
+        for (k = 0; k < n_; k++) {
+            dF[k] = f_[k] - f_prev_[k];
+            dG[k] = g[k] - g_prev_[k];
+        }
+        head_ = (head_ + 1) % depth_;
+        count_ = std::min(count_ + 1, depth_);
+    }
+    std::copy(f_.begin(), f_.end(), f_prev_.begin());
+    std::copy(g, g + n_, g_prev_.begin());
+    have_prev_ = true;
+
+    std::fill(dots, dots + numDots(), 0.0);
+    for (j = 0; j < depth_; j++) {
+        if (!valid(j)) {
+            continue;
+        }
+        const double *dF_j = &dF_[j * n_];
+        double s_new = 0, s_f = 0;
+        if (last_ >= 0) {
+            const double *dF_new = &dF_[last_ * n_];
+            for (k = 0; k < n_; k++) {
+                s_new += dF_new[k] * dF_j[k];
+            }
+        }
+        for (k = 0; k < n_; k++) {
+            s_f += dF_j[k] * f_[k];
+        }
+        dots[j] = s_new;
+        dots[depth_ + j] = s_f;
+    }
+}
+
+bool AndersonAcceleration::extrapolate(const double *dots, double *dx) {
+    int i, j;
+    if (last_ >= 0) {
+        for (j = 0; j < count_; j++) {
+            gram_[last_ * depth_ + j] = dots[j];
+            gram_[j * depth_ + last_] = dots[j];
+        }
+    }
+    if (count_ == 0) {
+        return false;
+    }
+    // 覚えている差分は位置 0 .. count_-1 にある
+    std::vector<double> a(count_ * count_), b(count_);
+    double diag = 0;
+    bool zero = true;
+    for (i = 0; i < count_; i++) {
+        for (j = 0; j < count_; j++) {
+            a[i * count_ + j] = gram_[i * depth_ + j];
+        }
+        b[i] = dots[depth_ + i];
+        diag = std::max(diag, a[i * count_ + i]);
+        if (b[i] != 0) {
+            zero = false;
+        }
+    }
+    if (zero) {
+        // 全体で補正がなかった。補正量は0
+        return false;
+    }
+    for (i = 0; i < count_; i++) {
+        a[i * count_ + i] += REGULARIZATION * diag;
+    }
+    if (!(diag > 0) || !solve(count_, a, b)) {
+        count_ = 0;
+        head_ = 0;
+        restarts_++;
+        return false;
+    }
+
+    size_t k;
+    std::fill(dx, dx + n_, 0.0);
+    for (j = 0; j < count_; j++) {
+        const double *dG = &dG_[j * n_];
+        double gamma = b[j];
+        for (k = 0; k < n_; k++) {
+            dx[k] -= gamma * dG[k];
+        }
+    }
+    return true;
+}
+
+bool AndersonAcceleration::solve(int count, std::vector<double> &a, std::vector<double> &b) {
+    int i, j, r;
+    for (i = 0; i < count; i++) {
+        int pivot = i;
+        for (r = i + 1; r < count; r++) {
+            if (std::fabs(a[r * count + i]) > std::fabs(a[pivot * count + i])) {
+                pivot = r;
+            }
+        }
+        if (!(std::fabs(a[pivot * count + i]) > 0)) {
+            return false;
+        }
+        if (pivot != i) {
+            for (j = 0; j < count; j++) {
+                std::swap(a[i * count + j], a[pivot * count + j]);
+            }
+            std::swap(b[i], b[pivot]);
+        }
+        for (r = i + 1; r < count; r++) {
+            double factor = a[r * count + i] / a[i * count + i];
+            for (j = i; j < count; j++) {
+                a[r * count + j] -= factor * a[i * count + j];
+            }
+            b[r] -= factor * b[i];
+        }
+    }
+    for (i = count - 1; i >= 0; i--) {
+        double s = b[i];
+        for (j = i + 1; j < count; j++) {
+            s -= a[i * count + j] * b[j];
+        }
+        b[i] = s / a[i * count + i];
+        if (!std::isfinite(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t AndersonAcceleration::memoryBytes() const {
+    return (x_.capacity() + f_prev_.capacity() + g_prev_.capacity() + f_.capacity()
+            + dF_.capacity() + dG_.capacity() + gram_.capacity()) * sizeof(double);
+}
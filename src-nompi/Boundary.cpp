@@ -5,22 +5,27 @@
 #include <Logger.h>
 #include <cmath>
 
-void Boundary::apply(double t, double t_ramp)
+void Boundary::apply(NodeBlock &nodes, double t, double t_ramp)
 {
     // 境界上の速度値を多項式に基づいて設定する
-    size_t i;
+    long i;
+    const long num = nodes_.size();
     double x, y;
     double weight;
     double pi = M_PI;
-    for(i = 0; i < nodes_.size(); i++){
-        x = nodes_[i]->pos_.x_;
-        y = nodes_[i]->pos_.y_;
+#ifdef _OPENMP
+#pragma omp for
+#endif
+    for(i = 0; i < num; i++){
+        int n = nodes_[i];
+        x = nodes.pos_[n].x_;
+        y = nodes.pos_[n].y_;
         if(t < t_ramp){
             weight = (1.0 - std::cos(pi*t / t_ramp))/2.0;
         }else{
             weight = 1.0;
         }
-        nodes_[i]->vel_.x_ = (a0_ + a1_*x + a2_*y + a3_*x*x + a4_*x*y + a5_*y*y)*weight;
-        nodes_[i]->vel_.y_ = (b0_ + b1_*x + b2_*y + b3_*x*x + b4_*x*y + b5_*y*y)*weight;
+        nodes.vel_[n].x_ = (a0_ + a1_*x + a2_*y + a3_*x*x + a4_*x*y + a5_*y*y)*weight;
+        nodes.vel_[n].y_ = (b0_ + b1_*x + b2_*y + b3_*x*x + b4_*x*y + b5_*y*y)*weight;
     }
 }
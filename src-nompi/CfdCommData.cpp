@@ -11,15 +11,16 @@ void CfdCommData::init(Params *params, State *state) {
     // 後に呼ばれるメソッドの中で使えるようにparamsとstateを保存しておく。
     params_ = params;
     state_ = state;
+    piggyback_ = (params_->convergence_check_ == "piggyback") ? 1 : 0;
 }
 
-void CfdCommData::addBoundaryNode(int rank, Node *node) {
+void CfdCommData::addBoundaryNode(int rank, int local_index) {
     // rank番号に対応するpeer bufferを取得する。
     // 初めて登場したrank番号の場合は、このタイミングでpeer bufferを作成する。
     CfdCommPeerBuffer *peer_buffer = findOrCreatePeerBufferForRank(rank);
 
     // そのpeer bufferにnodeを登録する。
-    peer_buffer->addNode(node);
+    peer_buffer->addNode(local_index);
 }
 
 CfdCommPeerBuffer *CfdCommData::findOrCreatePeerBufferForRank(int rank) {
@@ -43,34 +44,59 @@ CfdCommPeerBuffer *CfdCommData::findOrCreatePeerBufferForRank(int rank) {
     return peer_buffer;
 }
 
-void CfdCommData::gatherBoundaryNodeMass() {
+void CfdCommData::reserveBuffers() {
+    size_t i;
+    for (i = 0; i < peer_buffers_.size(); i++) {
+        peer_buffers_[i].reserveBuffers();
+    }
+}
+
+void CfdCommData::gatherBoundaryNodeMass(const NodeBlock &nodes) {
     // 全peer bufferに、境界上の節点の質量値を送信バッファに取り込むことを命じる
     size_t i;
     for (i = 0; i < peer_buffers_.size(); i++) {
-        peer_buffers_[i].gatherBoundaryNodeMass();
+        peer_buffers_[i].gatherBoundaryNodeMass(nodes);
     }
 }
 
-void CfdCommData::distributeBoundaryNodeMass() {
+void CfdCommData::distributeBoundaryNodeMass(NodeBlock &nodes) {
     // 全peer bufferに、受信バッファ上の質量値を節点の質量に加えることを命じる
     size_t i;
     for (i = 0; i < peer_buffers_.size(); i++) {
-        peer_buffers_[i].distributeBoundaryNodeMass();
+        peer_buffers_[i].distributeBoundaryNodeMass(nodes);
     }
 }
 
-void CfdCommData::gatherBoundaryNodeVelocityDelta() {
+void CfdCommData::gatherBoundaryNodeVelocityDelta(const NodeBlock &nodes) {
     // 全peer bufferに、境界上の節点の質量値を送信バッファに取り込むことを命じる
     size_t i;
     for (i = 0; i < peer_buffers_.size(); i++) {
-        peer_buffers_[i].gatherBoundaryNodeVelocityDelta();
+        peer_buffers_[i].gatherBoundaryNodeVelocityDelta(nodes, piggyback_);
     }
 }
-void CfdCommData::distributeBoundaryNodeVelocityDelta() {
+
+void CfdCommData::setPiggyback(double value) {
+    size_t i;
+    for (i = 0; i < peer_buffers_.size(); i++) {
+        peer_buffers_[i].send_buffer_.back() = value;
+    }
+}
+
+double CfdCommData::minPiggyback(double none) const {
+    double value = none;
+    size_t i;
+    for (i = 0; i < peer_buffers_.size(); i++) {
+        if (i == 0 || peer_buffers_[i].recv_buffer_.back() < value) {
+            value = peer_buffers_[i].recv_buffer_.back();
+        }
+    }
+    return value;
+}
+void CfdCommData::distributeBoundaryNodeVelocityDelta(NodeBlock &nodes) {
     // 全peer bufferに、受信バッファ上の質量値を節点の質量に加えることを命じる
     size_t i;
     for (i = 0; i < peer_buffers_.size(); i++) {
-        peer_buffers_[i].distributeBoundaryNodeVelocityDelta();
+        peer_buffers_[i].distributeBoundaryNodeVelocityDelta(nodes);
     }
 }
 
@@ -83,7 +109,7 @@ void CfdCommData::distributeBoundaryNodeVelocityDelta() {
  * ここから先は CfdCommPeerBufferのメソッド定義
  */
 
-void CfdCommPeerBuffer::gatherBoundaryNodeMass() {
+void CfdCommPeerBuffer::gatherBoundaryNodeMass(const NodeBlock &nodes) {
 
     // 送信バッファの長さを節点の数に合わせる。
     send_buffer_.resize(nodes_.size());
@@ -93,39 +119,44 @@ void CfdCommPeerBuffer::gatherBoundaryNodeMass() {
     // 節点の質量値を取得して、送信バッファの該当個所に格納する。
     size_t j;
     for (j = 0; j < nodes_.size(); j++) {
-        send_buffer_[j] = nodes_[j]->m_;
+        send_buffer_[j] = nodes.m_[nodes_[j]];
     }
 }
 
-void CfdCommPeerBuffer::distributeBoundaryNodeMass() {
+void CfdCommPeerBuffer::distributeBoundaryNodeMass(NodeBlock &nodes) {
     // 受信バッファの質量値を、対応する節点の質量値に加える。
     size_t j;
     for (j = 0; j < nodes_.size(); j++) {
-        nodes_[j]->m_ += recv_buffer_[j];
+        nodes.m_[nodes_[j]] += recv_buffer_[j];
     }
 }
 
-void CfdCommPeerBuffer::gatherBoundaryNodeVelocityDelta() {
+void CfdCommPeerBuffer::gatherBoundaryNodeVelocityDelta(const NodeBlock &nodes, int piggyback) {
     // 送信バッファの長さを節点の数に合わせる。
-    send_buffer_.resize(nodes_.size()*2);
+    send_buffer_.resize(nodes_.size()*2 + piggyback);
     // 同数のデータを相手から受信するはずなので、受信バッファの長さも同じ数に合わせる。
-    recv_buffer_.resize(nodes_.size()*2);
+    recv_buffer_.resize(nodes_.size()*2 + piggyback);
+    if (piggyback > 0) {
+        send_buffer_.back() = 0;
+    }
 
     // 節点の速度補正値を取得して、送信バッファの該当個所に格納する。
     size_t j;
     // Logger::out << "start set buffer" << std::endl;
 
     for (j = 0; j < nodes_.size(); j++) {
-        send_buffer_[2*j] = nodes_[j]->d_vel_.x_;
-        send_buffer_[2*j+1] = nodes_[j]->d_vel_.y_;
+        const VectorXY &d_vel = nodes.d_vel_[nodes_[j]];
+        send_buffer_[2*j] = d_vel.x_;
+        send_buffer_[2*j+1] = d_vel.y_;
     }
 }
 
-void CfdCommPeerBuffer::distributeBoundaryNodeVelocityDelta() {
+void CfdCommPeerBuffer::distributeBoundaryNodeVelocityDelta(NodeBlock &nodes) {
     // 受信バッファの速度補正値を、対応する節点の速度補正値に加える。
     size_t j;
     for (j = 0; j < nodes_.size(); j++) {
-        nodes_[j]->d_vel_.x_ += recv_buffer_[2*j];
-        nodes_[j]->d_vel_.y_ += recv_buffer_[2*j+1];
+        VectorXY &d_vel = nodes.d_vel_[nodes_[j]];
+        d_vel.x_ += recv_buffer_[2*j];
+        d_vel.y_ += recv_buffer_[2*j+1];
     }
 }
@@ -86,9 +86,68 @@ void CfdDriver_sp::correctVelocity() {
     // bool isNotDivergenceAll;
     int i, j;
     int max_corrections = params_.max_corrections_;
+    bool activeSet = (params_.active_set_ == "on");
+    bool anderson = procData_.accelerationEnabled();
+    // 1プロセスなので、外挿に使う内積は自プロセス分がそのまま全体の和になる
+    std::vector<double> dots(anderson ? procData_.numAccelerationDots() : 0);
+    if (procData_.pressureSolverEnabled()) {
+        // 1プロセスなので、内積は自プロセス分がそのまま全体の和になり、送受信もない
+        std::vector<double> dots(procData_.numPressureSolverDots());
+        std::vector<double> next(dots.size());
+        procData_.beginPressureSolve(dots.data());
+        for (i = 0; i < max_corrections && dots[1] > 0; i++) {
+            procData_.nextPressureDirection(dots.data());
+            procData_.gatherPressureDirection();
+            procData_.multiplyPressureLocal();
+            procData_.multiplyPressureInterface(dots.data());
+            if (!procData_.updatePressureSolution(dots.data(), next.data())) {
+                break;
+            }
+            dots = next;
+        }
+        if (i > 0) {
+            procData_.applyPressureSolution();
+            procData_.applyVelocityDeltaAndClear();
+            procData_.applyBoundaryConditions();
+        }
+        Logger::out << "Ended at correction step : " << i << " (pcg)" << std::endl;
+        return;
+    }
+    procData_.clearRelaxationHistory();
+    procData_.clearAccelerationHistory();
     for(i = 0; i < max_corrections; i++){
+        if (activeSet) {
+            // 最初の反復と active_set_recheck 回ごとの反復では全要素を計算する
+            procData_.updateActiveElements(i % params_.active_set_recheck_ == 0);
+        }
         // 閾値を超える要素があれば補正してtrueを返す
-        isNotDivergence=procData_.calcDivergenceAndCorrect();
+        if (params_.correction_order_ == "multicolor") {
+            // 色ごとに補正して速度に反映し、次の色は反映後の速度から判別式を求める
+            isNotDivergence = false;
+            for (j = 0; j < (int)procData_.numColors(); j++) {
+                if (procData_.calcDivergenceAndCorrectColor(j)) {
+                    isNotDivergence = true;
+                    procData_.applyVelocityDeltaAndClear();
+                    procData_.applyBoundaryConditions();
+                    if (activeSet) {
+                        procData_.updateActiveElements(false);
+                    }
+                }
+            }
+        } else if (anderson) {
+            // 全要素を補正し、閾値を超える要素がなかったら補正を取り消す
+            procData_.beginAcceleration();
+            isNotDivergence=procData_.calcDivergenceAndCorrectAll();
+            if (isNotDivergence) {
+                procData_.calcAccelerationDots(dots.data());
+                procData_.accelerate(dots.data());
+            } else {
+                procData_.cancelAcceleration();
+            }
+        } else {
+            isNotDivergence=procData_.calcDivergenceAndCorrect();
+        }
+        procData_.adaptRelaxation();
 
         // MPI_Allreduce(void* send_data,void* recv_data,int count,MPI_Datatype datatype,MPI_Op op,MPI_Comm communicator)
         // MPI_Allreduce(&isNotDivergence, &isNotDivergenceAll, 1, MPI_LOGICAL, MPI_LOR, MPI_COMM_WORLD);
@@ -113,6 +172,7 @@ void CfdDriver_sp::outputVariables() {
 }
 
 void CfdDriver_sp::finalize() {
+    procData_.logThreadStats();
     // 最後まで達したことをログに記録してクローズ
     Logger::out << "Ending." << std::endl;
     Logger::closeLog();
@@ -7,6 +7,7 @@
 #include <FileReader.h>
 #include <VtkWriter.h>
 #include <Logger.h>
+#include <Renumbering.h>
 
 #include <cmath>
 #include <cassert>
@@ -19,6 +20,8 @@ void CfdProcData::init(Params *params, State *state, CfdCommData *commData) {
     params_ = params;
     state_ = state;
     commData_ = commData;
+    acceleration_ = false;
+    pressure_solve_ = false;
 }
 
 void CfdProcData::readMeshFile() {
@@ -51,7 +54,7 @@ void CfdProcData::readMeshFile() {
     int j;
     for (j = 1; j <= n_nodes; j++) {
         Node &node = nodes_[j-1];
-        // node.global_index_ = j;
+        node.global_index_ = j;
         // 内容: 節点番号(1～) X Y
         rdr.readLine();
         // 節点番号が期待と違ったら不整合とみなす（DataExceptionが上がる)
@@ -129,7 +132,7 @@ void CfdProcData::readBoundaryFile() {
             // 指定された節点が、当プロセスで計算対象となっている場合だけ
             // boundaryオブジェクトに登録する。（境界条件の計算対象になる）
             if (node->isOnRank(params_->my_rank_)) {
-                b->addNode(node);
+                b->addNode(node->local_index_);
             }
         }
         // 内容: 速度 u(x,y)の係数
@@ -165,22 +168,213 @@ void CfdProcData::findOwnData() {
     for (i = 0; i < nodes_.size(); i++) {
         Node &node = nodes_[i];
         if (node.isOnRank(params_->my_rank_)) {
-            Logger::out << "node " << i << " is local, and the local index is " << my_nodes_.size() << std::endl;
             node.local_index_ = my_nodes_.size();
             my_nodes_.push_back(&node);
+        }
+    }
+
+    // メモリ上の局所性が良くなるように並べ替える
+    renumberOwnData();
+
+    // 境界上の節点は、隣接プロセスと同じ順番 (メッシュファイルの節点番号順) で登録する
+    for (i = 0; i < nodes_.size(); i++) {
+        Node &node = nodes_[i];
+        if (node.isOnRank(params_->my_rank_)) {
+            Logger::out << "node " << i << " is local, and the local index is " << node.local_index_ << std::endl;
             if (node.isOnBoundary()) {
                 Logger::out << "node " << i << " is on boundary with ranks : ";
                 for (j = 0; j < node.ranks_.size(); j++) {
                     int rank = node.ranks_[j];
                     if (rank != params_->my_rank_) {
                         Logger::out << " " << rank;
-                        commData_->addBoundaryNode(rank, &node);
+                        commData_->addBoundaryNode(rank, node.local_index_);
                     }
                 }
                 Logger::out << std::endl;
             }
         }
     }
+    // 境界の要素を先に計算できるように並べる
+    size_t num_boundary_elements = splitBoundaryElements();
+    // 担当する節点と要素の計算用の配列を確保する
+    node_block_.init(my_nodes_);
+    element_block_.init(my_elements_);
+    element_block_.setBoundaryElements(num_boundary_elements);
+    Logger::out << "Element kernels : " << ElementBlock::simdIsaName(element_block_.simd_isa_) << std::endl;
+    setThreads();
+    logColoring();
+}
+
+size_t CfdProcData::splitBoundaryElements() {
+    size_t num_elements = my_elements_.size();
+    size_t k;
+    if (params_->halo_overlap_ != "on") {
+        return 0;
+    }
+    std::vector<bool> on_boundary(num_elements, false);
+    for (k = 0; k < num_elements; k++) {
+        for (int i = 0; i < 4; i++) {
+            if (my_elements_[k]->nodes_[i]->isOnBoundary()) {
+                on_boundary[k] = true;
+            }
+        }
+    }
+    // 境界の要素、内部の要素の順に、それぞれ元の順序のまま並べる
+    std::vector<int32_t> new_index(num_elements);
+    std::vector<QuadElement *> elements;
+    elements.reserve(num_elements);
+    for (k = 0; k < num_elements; k++) {
+        if (on_boundary[k]) {
+            new_index[k] = elements.size();
+            elements.push_back(my_elements_[k]);
+        }
+    }
+    size_t num_boundary = elements.size();
+    for (k = 0; k < num_elements; k++) {
+        if (!on_boundary[k]) {
+            new_index[k] = elements.size();
+            elements.push_back(my_elements_[k]);
+        }
+    }
+    my_elements_.swap(elements);
+    for (k = 0; k < element_output_order_.size(); k++) {
+        element_output_order_[k] = new_index[element_output_order_[k]];
+    }
+    Logger::out << "halo overlap : " << num_boundary << " boundary elements, "
+            << num_elements - num_boundary << " interior elements" << std::endl;
+    return num_boundary;
+}
+
+void CfdProcData::setThreads() {
+    int threads = params_->threads_;
+#ifdef _OPENMP
+    Logger::out << "threads : " << threads << " per rank" << std::endl;
+#else
+    if (threads > 1) {
+        Logger::out << "threads : " << threads << " requested, but compiled without OpenMP."
+                << " Running with 1 thread per rank" << std::endl;
+    }
+#endif
+    node_block_.num_threads_ = threads;
+    element_block_.num_threads_ = threads;
+    if (threads > 1) {
+        // チャンクはAVX-512の組の幅 (8要素) の倍数にする
+        size_t chunk = (params_->thread_chunk_ + 7) / 8 * 8;
+        element_block_.colorElements(chunk);
+        element_block_.schedule_ = (params_->thread_schedule_ == "stealing")
+                ? ElementBlock::SCHEDULE_STEALING : ElementBlock::SCHEDULE_DYNAMIC;
+        Logger::out << "thread schedule : " << params_->thread_schedule_ << std::endl;
+    }
+}
+
+void CfdProcData::logThreadStats() {
+    if (element_block_.num_threads_ <= 1 || element_block_.schedule_ != ElementBlock::SCHEDULE_STEALING) {
+        return;
+    }
+    const WorkStealingScheduler &scheduler = element_block_.scheduler_;
+    for (int t = 0; t < scheduler.maxThreads(); t++) {
+        const WorkStealingScheduler::Counters &counters = scheduler.counters(t);
+        double total = counters.busy_ + counters.idle_;
+        Logger::out << "thread " << t << " : busy " << counters.busy_ << " s, idle " << counters.idle_
+                << " s (" << (total > 0 ? 100.0 * counters.idle_ / total : 0.0) << " %), tasks "
+                << counters.tasks_ << ", steals " << counters.steals_ << std::endl;
+    }
+}
+
+void CfdProcData::logColoring() {
+    size_t num_colors = element_block_.numColors();
+    size_t min_size = 0, max_size = 0;
+    Logger::out << "coloring : " << num_colors << " colors of " << element_block_.color_chunk_
+            << "-element chunks, elements per color :";
+    for (size_t c = 0; c < num_colors; c++) {
+        size_t size = element_block_.color_begin_[c + 1] - element_block_.color_begin_[c];
+        if (c == 0 || size < min_size) min_size = size;
+        if (c == 0 || size > max_size) max_size = size;
+        Logger::out << " " << size;
+    }
+    Logger::out << std::endl;
+    if (num_colors > 0) {
+        double mean = (double)element_block_.num_elements_ / num_colors;
+        Logger::out << "coloring : min " << min_size << ", max " << max_size
+                << ", max/mean " << max_size / mean << std::endl;
+    }
+}
+
+namespace {
+
+// 担当要素の四隅のローカルな節点番号
+std::vector<int32_t> localElementNodes(const std::vector<QuadElement *> &elements) {
+    std::vector<int32_t> elem_nodes(4*elements.size());
+    for (size_t e = 0; e < elements.size(); e++) {
+        for (int i = 0; i < 4; i++) {
+            elem_nodes[4*e + i] = elements[e]->nodes_[i]->local_index_;
+        }
+    }
+    return elem_nodes;
+}
+
+// 局所性の指標をログに出力する。キャッシュの容量はL1とL2程度の2通り。
+void logLocality(const char *label, size_t num_nodes, const std::vector<int32_t> &elem_nodes) {
+    Renumbering::Locality l1 = Renumbering::measure(num_nodes, elem_nodes, 32*1024);
+    Renumbering::Locality l2 = Renumbering::measure(num_nodes, elem_nodes, 1024*1024);
+    Logger::out << "locality (" << label << ") : bandwidth " << l1.bandwidth_
+            << ", mean span " << l1.mean_span_
+            << ", simulated cache misses " << l1.cache_misses_ << " (32KB) "
+            << l2.cache_misses_ << " (1MB)"
+            << " for " << elem_nodes.size() << " node reads" << std::endl;
+}
+
+} // namespace
+
+void CfdProcData::renumberOwnData() {
+    size_t num_nodes = my_nodes_.size();
+    size_t num_elements = my_elements_.size();
+    size_t k;
+    std::vector<int32_t> elem_nodes = localElementNodes(my_elements_);
+    std::vector<int32_t> node_order, element_order;
+
+    logLocality("as read", num_nodes, elem_nodes);
+    if (params_->renumber_ == "rcm") {
+        // 節点を Reverse Cuthill-McKee 順に並べ、要素はそれに合わせる
+        node_order = Renumbering::rcmNodeOrder(num_nodes, elem_nodes);
+        element_order = Renumbering::elementOrderByNodes(num_nodes, node_order, elem_nodes);
+    } else if (params_->renumber_ == "hilbert") {
+        // 要素を重心の Hilbert 曲線順に並べ、節点はそれに合わせる
+        std::vector<VectorXY> pos(num_nodes);
+        for (k = 0; k < num_nodes; k++) {
+            pos[k] = my_nodes_[k]->pos_;
+        }
+        element_order = Renumbering::hilbertElementOrder(elem_nodes, pos);
+        node_order = Renumbering::nodeOrderByElements(num_nodes, element_order, elem_nodes);
+    } else {
+        node_output_order_.resize(num_nodes);
+        for (k = 0; k < num_nodes; k++) {
+            node_output_order_[k] = k;
+        }
+        element_output_order_.resize(num_elements);
+        for (k = 0; k < num_elements; k++) {
+            element_output_order_[k] = k;
+        }
+        return;
+    }
+
+    std::vector<Node *> nodes(num_nodes);
+    for (k = 0; k < num_nodes; k++) {
+        nodes[k] = my_nodes_[node_order[k]];
+        nodes[k]->local_index_ = k;
+    }
+    my_nodes_.swap(nodes);
+    std::vector<QuadElement *> elements(num_elements);
+    for (k = 0; k < num_elements; k++) {
+        elements[k] = my_elements_[element_order[k]];
+    }
+    my_elements_.swap(elements);
+
+    // 並べ替える前の番号がメッシュファイルの順なので、その逆の対応が出力順になる
+    node_output_order_ = Renumbering::inverse(node_order);
+    element_output_order_ = Renumbering::inverse(element_order);
+
+    logLocality(params_->renumber_.c_str(), num_nodes, localElementNodes(my_elements_));
 }
 
 void CfdProcData::readTemporalData()  {
@@ -227,15 +421,9 @@ bool CfdProcData::checkRestartFileIsThere(){
 }
 
 void CfdProcData::clearFieldData(){
-    size_t i;
     // ファイルがなかったものとして変数を0で初期化する．
-    for (i = 0; i < my_nodes_.size(); i++) {
-      my_nodes_[i]->vel_.set(0.,0.);
-      my_nodes_[i]->d_vel_.set(0.,0.);
-    }
-    for (i = 0; i < my_elements_.size(); i++) {
-      my_elements_[i]->p_=0.;
-    }
+    node_block_.clearVelocity();
+    element_block_.clearPressure();
 }
 
 
@@ -251,16 +439,17 @@ void CfdProcData::initFieldDataByRestartFile(){
     restart_file.read((char*)&value, sizeof(value));
     state_->initT(value, params_->delta_t_);
 
-    // 速度を読み出す．
+    // 速度を読み出す．ファイル上はメッシュファイルの順に並んでいる
     for (i = 0; i < my_nodes_.size(); i++) {
+        int32_t n = node_output_order_[i];
         restart_file.read((char*)&value, sizeof(value));
-        my_nodes_[i]->vel_.x_=value;
+        node_block_.vel_[n].x_=value;
         restart_file.read((char*)&value, sizeof(value));
-        my_nodes_[i]->vel_.y_=value;
+        node_block_.vel_[n].y_=value;
     }
     for (i = 0; i < my_elements_.size(); i++) {
         restart_file.read((char*)&value, sizeof(value));
-        my_elements_[i]->p_=value;
+        element_block_.p_[element_output_order_[i]]=value;
     }
 
     // ファイルをクローズする
@@ -280,112 +469,256 @@ void CfdProcData::writeTemporalData(){
     // 時刻を書き出す
     value=state_->getT();
     restart_file.write((char*)&value, sizeof(value));
-    // 速度を書き出す
+    // 速度を書き出す (節点を並べ替えていてもメッシュファイルの順に書く)
     for (i = 0; i < my_nodes_.size(); i++) {
-        value=my_nodes_[i]->vel_.x_;
+        int32_t n = node_output_order_[i];
+        value=node_block_.vel_[n].x_;
         restart_file.write((char*)&value, sizeof(value));
-        value=my_nodes_[i]->vel_.y_;
+        value=node_block_.vel_[n].y_;
         restart_file.write((char*)&value, sizeof(value));
     }
     // 圧力を書き出す
     for (i = 0; i < my_elements_.size(); i++) {
-        value=my_elements_[i]->p_;
+        value=element_block_.p_[element_output_order_[i]];
         restart_file.write((char*)&value, sizeof(value));
     }
     restart_file.close();
 }
 
 void CfdProcData::calcInvariants1() {
-    size_t i;
     double re = params_->re_;
 
     Logger::out << "CfdProcData::calcInvariants1() start" << std::endl;
-    for (i = 0; i < my_nodes_.size(); i++) {
-        my_nodes_[i]->clearMass();
-    }
-    for (i = 0; i < my_elements_.size(); i++) {
-        my_elements_[i]->calcInvariants1(re);
-    }
-
-    commData_->gatherBoundaryNodeMass();
+    node_block_.clearMass();
+    element_block_.precompute_convection_ = (params_->convection_ == "precomputed");
+    element_block_.precision_ = (params_->precision_ == "mixed")
+            ? ElementBlock::PRECISION_MIXED : ElementBlock::PRECISION_DOUBLE;
+    element_block_.storage_ = (params_->storage_ == "lean")
+            ? ElementBlock::STORAGE_LEAN : ElementBlock::STORAGE_FULL;
+    element_block_.assembly_ = (params_->assembly_ == "gather")
+            ? ElementBlock::ASSEMBLY_GATHER : ElementBlock::ASSEMBLY_SCATTER;
+    element_block_.calcInvariants1(node_block_, re);
+    Logger::out << "convection : " << params_->convection_
+            << " (tensor " << element_block_.conv_.size() * sizeof(double) << " bytes)" << std::endl;
+    Logger::out << "precision : " << params_->precision_
+            << " (correction invariants "
+            << element_block_.corr_.bytes() + element_block_.corr_f_.bytes() << " bytes)" << std::endl;
+    Logger::out << "assembly : " << params_->assembly_ << " (slots "
+            << (element_block_.slot_x_.size() + element_block_.slot_y_.size()) * sizeof(double)
+            << " bytes)" << std::endl;
+
+    commData_->gatherBoundaryNodeMass(node_block_);
     Logger::out << "CfdProcData::calcInvariants1() end" << std::endl;
 }
 
 void CfdProcData::calcInvariants2() {
     Logger::out << "CfdProcData::calcInvariants2() start" << std::endl;
-    commData_->distributeBoundaryNodeMass();
-
-    size_t i;
+    commData_->distributeBoundaryNodeMass(node_block_);
 
     double delta_t = params_->delta_t_;
     double relaxation = params_->relaxation_;
-    for (i = 0; i < my_nodes_.size(); i++) {
-        my_nodes_[i]->calcInvMass();
-        // Logger::out << "Node " << i << " : inv_mass " << my_nodes_[i]->inv_m_ << std::endl;
-        my_nodes_[i]->calcDtByM(delta_t);
-        // Logger::out << "Node " << i << " : dt/m " << my_nodes_[i]->delta_t_by_m_ << std::endl;
+    node_block_.calcInvMass();
+    node_block_.calcDtByM(delta_t);
+    element_block_.calcInvariants2(node_block_, delta_t, relaxation);
+    if (params_->relaxation_adaptive_ == "on" && element_block_.storage_ == ElementBlock::STORAGE_LEAN) {
+        Logger::out << "relaxation adaptive : not available with storage lean."
+                << " Using relaxation " << relaxation << " for all elements" << std::endl;
+    }
+    pressure_solve_ = false;
+    if (params_->correction_solver_ == "pcg") {
+        assemblePressureSolver();
     }
-    for (i = 0; i < my_elements_.size(); i++){
-        my_elements_[i]->calcInvariants2(delta_t, relaxation);
+    acceleration_ = false;
+    if (params_->correction_acceleration_ == "anderson" && !pressure_solve_) {
+        if (element_block_.storage_ == ElementBlock::STORAGE_LEAN) {
+            // 収束の判定に判別式の配列を使う
+            Logger::out << "correction acceleration : not available with storage lean" << std::endl;
+        } else {
+            acceleration_ = true;
+            anderson_.init(element_block_.num_elements_, params_->anderson_depth_);
+            acceleration_dp_.assign(element_block_.num_elements_, 0.0);
+            Logger::out << "correction acceleration : anderson, depth " << anderson_.depth()
+                    << " (" << anderson_.memoryBytes() << " bytes)" << std::endl;
+        }
     }
+    logMemoryUsage();
     Logger::out << "CfdProcData::calcInvariants2() end" << std::endl;
 }
 
-void CfdProcData::calcVelocityPrediction() {
-    size_t i;
-    for(i = 0; i < my_elements_.size(); i++){
-        my_elements_[i]->calcVelocityPrediction();
+/*
+ * correction_solver pcg の行列を組み立てる。境界条件で速度を与える節点と、
+ * 隣接プロセスと共有する節点は、境界条件と送受信バッファの節点から求める。
+ */
+void CfdProcData::assemblePressureSolver() {
+    size_t i, j;
+    std::vector<uint8_t> fixed(node_block_.num_nodes_, 0);
+    for (i = 0; i < boundaries_.size(); i++) {
+        for (j = 0; j < boundaries_[i].nodes_.size(); j++) {
+            fixed[boundaries_[i].nodes_[j]] = 1;
+        }
     }
+    // 複数のプロセスと共有する節点は1度だけ数える
+    std::vector<uint8_t> shared(node_block_.num_nodes_, 0);
+    std::vector<int32_t> interface_nodes;
+    for (i = 0; i < commData_->peer_buffers_.size(); i++) {
+        const std::vector<int> &peer_nodes = commData_->peer_buffers_[i].nodes_;
+        for (j = 0; j < peer_nodes.size(); j++) {
+            if (!shared[peer_nodes[j]]) {
+                shared[peer_nodes[j]] = 1;
+                interface_nodes.push_back(peer_nodes[j]);
+            }
+        }
+    }
+    PressureSolver::Preconditioner preconditioner = (params_->pcg_preconditioner_ == "ilu")
+            ? PressureSolver::PRECONDITIONER_ILU : PressureSolver::PRECONDITIONER_JACOBI;
+    pressure_solver_.assemble(element_block_, node_block_, fixed, interface_nodes, preconditioner,
+            params_->threads_);
+    pressure_solve_ = true;
+    Logger::out << "correction solver : pcg, preconditioner " << params_->pcg_preconditioner_
+            << ", nonzeros " << pressure_solver_.numNonzeros()
+            << ", interface nodes " << pressure_solver_.numInterfaceNodes()
+            << ", fixed elements " << pressure_solver_.numFixedElements();
+    if (preconditioner == PressureSolver::PRECONDITIONER_ILU) {
+        Logger::out << ", pivot fixes " << pressure_solver_.numPivotFixes();
+    }
+    Logger::out << " (" << pressure_solver_.memoryBytes() << " bytes)" << std::endl;
+}
+
+/*
+ * 当プロセスの計算用配列のメモリ量をログに出力する。
+ * mesh はメッシュファイルから読んだ Node, QuadElement の配列 (Node::ranks_ の分は含まない)。
+ */
+void CfdProcData::logMemoryUsage() {
+    size_t num_elements = element_block_.num_elements_;
+    size_t num_nodes = node_block_.num_nodes_;
+    size_t element_bytes = element_block_.memoryBytes();
+    size_t node_bytes = node_block_.memoryBytes();
+    size_t mesh_bytes = nodes_.capacity() * sizeof(Node) + elements_.capacity() * sizeof(QuadElement)
+            + my_nodes_.capacity() * sizeof(Node *) + my_elements_.capacity() * sizeof(QuadElement *);
+    Logger::out << "storage : " << params_->storage_ << std::endl;
+    Logger::out << "memory : element block " << element_bytes << " bytes ("
+            << (num_elements > 0 ? element_bytes / num_elements : 0) << " bytes/element)"
+            << ", node block " << node_bytes << " bytes ("
+            << (num_nodes > 0 ? node_bytes / num_nodes : 0) << " bytes/node)"
+            << ", mesh " << mesh_bytes << " bytes"
+            << ", total " << element_bytes + node_bytes + mesh_bytes << " bytes" << std::endl;
+}
+
+void CfdProcData::calcVelocityPrediction(ElementBlock::Part part) {
+    element_block_.calcVelocityPrediction(node_block_, part);
 }
 
 void CfdProcData::gatherVelocityDelta(){
-    commData_->gatherBoundaryNodeVelocityDelta();
+    commData_->gatherBoundaryNodeVelocityDelta(node_block_);
 }
 
 void CfdProcData::distributeVelocityDelta(){
-    commData_->distributeBoundaryNodeVelocityDelta();
+    commData_->distributeBoundaryNodeVelocityDelta(node_block_);
 }
 
 void CfdProcData::applyVelocityDeltaAndClear() {
-    size_t i;
-    for(i = 0; i < my_nodes_.size(); i++) {
-        my_nodes_[i]->applyVelocityDelta();
-        my_nodes_[i]->clearVelocityDelta();
-    }
+    node_block_.applyVelocityDeltaAndClear();
 }
 
-bool CfdProcData::calcDivergenceAndCorrect() {
-    size_t i;
+bool CfdProcData::calcDivergenceAndCorrect(ElementBlock::Part part) {
     double epsilon=params_->epsilon_;
-    bool flag=0;
-    double D;
-    for(i = 0; i < my_elements_.size(); i++){
-        // 判別式D_の計算
-        my_elements_[i]->calcDiscriminant();
-        D = my_elements_[i]->D_ ;
-
-        // 閾値を超えた要素に対して補正を行う
-        if(D > epsilon || D < (-epsilon)){
-            my_elements_[i]->correctVelocity();
-            flag=1;
-        }
+    // 判別式D_を計算し、閾値を超えた要素に対して補正を行う
+    return element_block_.calcDivergenceAndCorrect(node_block_, epsilon, part);
+}
+
+bool CfdProcData::calcDivergenceAndCorrectColor(size_t color) {
+    return element_block_.calcDivergenceAndCorrectColor(node_block_, params_->epsilon_, color);
+}
+
+size_t CfdProcData::updateActiveElements(bool all) {
+    element_block_.updateActiveElements(node_block_, all);
+    return element_block_.numActiveElements();
+}
+
+void CfdProcData::adaptRelaxation() {
+    if (params_->relaxation_adaptive_ == "on") {
+        element_block_.adaptRelaxation(params_->epsilon_);
     }
-    return flag;
 }
 
-void CfdProcData::clearVelocityDelta() {
-    size_t i;
-    for(i = 0; i < my_nodes_.size(); i++) {
-        my_nodes_[i]->clearVelocityDelta();
+void CfdProcData::clearRelaxationHistory() {
+    element_block_.clearRelaxationHistory();
+}
+
+void CfdProcData::clearAccelerationHistory() {
+    anderson_.clear();
+}
+
+void CfdProcData::beginAcceleration() {
+    anderson_.begin(element_block_.p_.data());
+}
+
+bool CfdProcData::calcDivergenceAndCorrectAll() {
+    // 閾値0なら判別式が0でない要素は全て補正する
+    element_block_.calcDivergenceAndCorrect(node_block_, 0.0);
+    return element_block_.discriminantExceeds(params_->epsilon_);
+}
+
+void CfdProcData::calcAccelerationDots(double *dots) {
+    // 補正後の圧力と補正前の圧力の差が、補正量 (緩和係数を掛けた判別式) になる
+    anderson_.localDots(element_block_.p_.data(), dots);
+}
+
+bool CfdProcData::accelerate(const double *dots) {
+    if (!anderson_.extrapolate(dots, acceleration_dp_.data())) {
+        return false;
     }
+    element_block_.addPressureDelta(node_block_, acceleration_dp_.data());
+    return true;
+}
+
+void CfdProcData::cancelAcceleration() {
+    anderson_.restore(element_block_.p_.data());
+}
+
+void CfdProcData::beginPressureSolve(double *dots) {
+    pressure_solver_.begin(element_block_, node_block_, params_->epsilon_, dots);
+}
+
+void CfdProcData::nextPressureDirection(const double *dots) {
+    pressure_solver_.nextDirection(dots);
+}
+
+void CfdProcData::gatherPressureDirection() {
+    pressure_solver_.scatterInterface(node_block_);
+    commData_->gatherBoundaryNodeVelocityDelta(node_block_);
+}
+
+void CfdProcData::multiplyPressureLocal() {
+    pressure_solver_.multiplyLocal(node_block_);
+}
+
+void CfdProcData::multiplyPressureInterface(double *dots) {
+    pressure_solver_.multiplyInterface(node_block_, dots);
+}
+
+bool CfdProcData::updatePressureSolution(const double *dots, double *next) {
+    return pressure_solver_.update(dots, params_->epsilon_, next);
+}
+
+void CfdProcData::applyPressureSolution() {
+    element_block_.addPressureDelta(node_block_, pressure_solver_.solution());
+}
+
+void CfdProcData::clearVelocityDelta() {
+    node_block_.clearVelocityDelta();
 }
 
 void CfdProcData::applyBoundaryConditions() {
     size_t i;
     double t_ramp = params_->t_ramp_;
     double t = state_->getT();
+    // 境界の順に適用する (角の節点は後の境界の値になる)。1つの境界の節点はスレッドで分担する。
+#ifdef _OPENMP
+#pragma omp parallel num_threads(params_->threads_) if(params_->threads_ > 1) private(i)
+#endif
     for(i = 0; i < boundaries_.size(); i++){
-        boundaries_[i].apply(t,t_ramp);
+        boundaries_[i].apply(node_block_, t, t_ramp);
     }
 }
 
@@ -393,7 +726,7 @@ void CfdProcData::writeFieldData(){
     // vtk形式のファイル出力クラス
     VtkWriter vtk;
     // プロセッサーの節点、要素を渡して初期化する
-    vtk.init(my_nodes_, my_elements_);
+    vtk.init(&node_block_, &element_block_, &node_output_order_, &element_output_order_);
     // 出力ファイルを生成して開く
     vtk.open(params_->output_file_name_, params_->my_rank_, state_->getRound());
     // vtkファイルのヘッダーを作成する
@@ -0,0 +1,1278 @@
+/*
+ * ElementBlock.cpp
+ */
+
+#include <ElementBlock.h>
+#include <Vector4.h>
+#include <Matrix4.h>
+#include <cassert>
+#include <algorithm>
+#include <cmath>
+
+//形状関数の設定
+const double ElementBlock::ai_[4] = { 0.25,  0.25, 0.25,  0.25};
+const double ElementBlock::bi_[4] = {-0.25,  0.25, 0.25, -0.25};
+const double ElementBlock::ci_[4] = {-0.25, -0.25, 0.25,  0.25};
+const double ElementBlock::di_[4] = { 0.25, -0.25, 0.25, -0.25};
+
+// 要素ごとの緩和係数の調整
+const double ElementBlock::RELAX_UP = 1.1;
+const double ElementBlock::RELAX_SLOW = 0.5;
+const double ElementBlock::RELAX_MIN = 0.1;
+const double ElementBlock::RELAX_MAX = 1.5;
+const double ElementBlock::RELAX_GUARD = 2.0;
+const double ElementBlock::RELAX_GUARD_CUT = 0.9;
+
+ElementBlock::ElementBlock() {
+    num_elements_ = 0;
+    simd_isa_ = detectSimdIsa();
+    precompute_convection_ = false;
+    precision_ = PRECISION_DOUBLE;
+    storage_ = STORAGE_FULL;
+    assembly_ = ASSEMBLY_SCATTER;
+    num_threads_ = 1;
+    schedule_ = SCHEDULE_DYNAMIC;
+    color_begin_.assign(1, 0);
+    color_chunk_ = 1;
+    num_boundary_elements_ = 0;
+    split_ = 0;
+    relaxation_ = 1.0;
+    relax_cap_ = RELAX_MAX;
+    D_sum_min_ = HUGE_VAL;
+}
+
+ElementBlock::SimdIsa ElementBlock::detectSimdIsa() {
+#ifdef ELEMENTBLOCK_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SIMD_AVX2;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+const char *ElementBlock::simdIsaName(SimdIsa isa) {
+    switch (isa) {
+    case SIMD_AVX2:
+        return "avx2";
+    case SIMD_AVX512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+size_t ElementBlock::simdWidth(SimdIsa isa) {
+    switch (isa) {
+    case SIMD_AVX2:
+        return 4;
+    case SIMD_AVX512:
+        return 8;
+    default:
+        return 1;
+    }
+}
+
+void ElementBlock::init(const std::vector<QuadElement *> &elements) {
+    size_t e;
+    int i;
+    size_t n = elements.size();
+    num_elements_ = n;
+
+    nodes_.resize(4*n);
+    for (e = 0; e < n; e++) {
+        for (i = 0; i < 4; i++) {
+            nodes_[4*e + i] = elements[e]->nodes_[i]->local_index_;
+        }
+    }
+
+    a_Ny_.assign(4*n, 0.0);
+    a_Nx_.assign(4*n, 0.0);
+    b_Ny_.assign(4*n, 0.0);
+    b_Nx_.assign(4*n, 0.0);
+    r_Ny_.assign(4*n, 0.0);
+    r_Nx_.assign(4*n, 0.0);
+    d_.assign(16*n, 0.0);
+    size_.assign(n, 0.0);
+
+    p_.assign(n, 0.0);
+
+    makeNodeSlots();
+    num_boundary_elements_ = 0;
+    colorElements(1);
+}
+
+void ElementBlock::makeNodeSlots() {
+    size_t k;
+    int32_t num_nodes = 0;
+    for (k = 0; k < nodes_.size(); k++) {
+        num_nodes = std::max(num_nodes, nodes_[k] + 1);
+    }
+    node_slot_begin_.assign(num_nodes + 1, 0);
+    for (k = 0; k < nodes_.size(); k++) {
+        node_slot_begin_[nodes_[k] + 1]++;
+    }
+    for (k = 0; k < (size_t)num_nodes; k++) {
+        node_slot_begin_[k + 1] += node_slot_begin_[k];
+    }
+    node_slots_.resize(nodes_.size());
+    std::vector<size_t> fill(node_slot_begin_.begin(), node_slot_begin_.end() - 1);
+    for (k = 0; k < nodes_.size(); k++) {
+        node_slots_[fill[nodes_[k]]++] = k;
+    }
+}
+
+/*
+ * 節点を共有するチャンクが同じ色にならないように、チャンクの番号順に色を決める。
+ * 使える色 (節点を共有するチャンクにまだ使われていない色) のうち、その時点で要素数が
+ * 最も少ないものを選び、使える色がなければ新しい色を作る。
+ * 単純に最小の番号の色を選ぶより、色ごとの要素数の偏りが小さくなる。
+ */
+void ElementBlock::colorElements(size_t chunk) {
+    size_t e, k;
+    size_t n = num_elements_;
+    color_chunk_ = std::max(chunk, (size_t)1);
+
+    // 境界の要素の数を color_chunk_ と8の公倍数に切り上げて分かれ目とする
+    size_t step = color_chunk_;
+    while (step % 8 != 0) {
+        step += color_chunk_;
+    }
+    split_ = std::min((num_boundary_elements_ + step - 1) / step * step, n);
+
+    // 要素の色。-1は未定。
+    std::vector<int> color(n, -1);
+    std::vector<size_t> count;
+    // used[c] == begin+1 なら色cは要素 begin から始まるチャンクの隣のチャンクに使われている
+    std::vector<size_t> used;
+    size_t begin, end;
+    for (begin = 0; begin < n; begin = end) {
+        end = std::min(begin + color_chunk_, begin < split_ ? split_ : n);
+        for (k = 4*begin; k < 4*end; k++) {
+            int32_t node = nodes_[k];
+            for (size_t j = node_slot_begin_[node]; j < node_slot_begin_[node + 1]; j++) {
+                int c = color[node_slots_[j] / 4];
+                if (c >= 0) {
+                    used[c] = begin + 1;
+                }
+            }
+        }
+        int best = -1;
+        for (size_t c = 0; c < count.size(); c++) {
+            if (used[c] != begin + 1 && (best < 0 || count[c] < count[best])) {
+                best = c;
+            }
+        }
+        if (best < 0) {
+            best = count.size();
+            count.push_back(0);
+            used.push_back(0);
+        }
+        for (e = begin; e < end; e++) {
+            color[e] = best;
+        }
+        count[best] += end - begin;
+    }
+
+    // 色ごとに要素番号の昇順に並べる
+    color_begin_.assign(count.size() + 1, 0);
+    for (size_t c = 0; c < count.size(); c++) {
+        color_begin_[c + 1] = color_begin_[c] + count[c];
+    }
+    color_elements_.resize(n);
+    std::vector<size_t> fill(color_begin_.begin(), color_begin_.end() - 1);
+    for (e = 0; e < n; e++) {
+        color_elements_[fill[color[e]]++] = e;
+    }
+}
+
+void ElementBlock::setBoundaryElements(size_t num) {
+    num_boundary_elements_ = std::min(num, num_elements_);
+    colorElements(color_chunk_);
+}
+
+size_t ElementBlock::memoryBytes() const {
+    size_t bytes = (nodes_.capacity() + color_elements_.capacity() + node_slots_.capacity()) * sizeof(int32_t);
+    bytes += (color_begin_.capacity() + node_slot_begin_.capacity()) * sizeof(size_t);
+    bytes += (slot_x_.capacity() + slot_y_.capacity()) * sizeof(double);
+    bytes += active_.capacity() * sizeof(uint8_t);
+    bytes += (relax_factor_.capacity() + lambda_base_.capacity() + D_prev_.capacity()) * sizeof(double);
+    bytes += (a_Ny_.capacity() + a_Nx_.capacity() + b_Ny_.capacity() + b_Nx_.capacity()
+            + r_Ny_.capacity() + r_Nx_.capacity() + hx_.capacity() + hy_.capacity()
+            + d_.capacity() + size_.capacity() + conv_.capacity()
+            + D_.capacity() + p_.capacity() + div_.capacity()) * sizeof(double);
+    bytes += corr_.bytes() + corr_f_.bytes();
+    return bytes;
+}
+
+void ElementBlock::clearPressure() {
+    size_t e;
+    for (e = 0; e < num_elements_; e++) {
+        p_[e] = 0.;
+    }
+}
+
+/*
+ * ループ不変量を計算し、配列に格納する
+ *   a_Nx_,a_Ny_,b_Nx_,b_Ny_,r_Nx_,r_Ny_,d_,hx_, hy_,hx_by_a_,hy_by_a_,size_,節点のm_
+ *   precompute_convection_ の場合は conv_ も
+ * 速度補正ループのループ不変量 corr_ または corr_f_ と、STORAGE_FULL の場合の
+ * hx_, hy_, D_, div_ は、precision_, storage_ に応じてここで確保する。
+ * ASSEMBLY_GATHER の場合は slot_x_, slot_y_ も確保し、集中化質量は節点ごとに足し込む。
+ */
+void ElementBlock::calcInvariants1(NodeBlock &nodes, double Re) {
+    if (precompute_convection_) {
+        conv_.assign(128*num_elements_, 0.0);
+    } else {
+        AlignedDoubleArray().swap(conv_);
+    }
+    bool lean = (storage_ == STORAGE_LEAN);
+    if (precision_ == PRECISION_MIXED) {
+        corr_f_.assign(num_elements_, lean);
+        corr_.release();
+    } else {
+        corr_.assign(num_elements_, lean);
+        corr_f_.release();
+    }
+    if (lean) {
+        AlignedDoubleArray().swap(hx_);
+        AlignedDoubleArray().swap(hy_);
+        AlignedDoubleArray().swap(D_);
+        AlignedDoubleArray().swap(div_);
+    } else {
+        hx_.assign(4*num_elements_, 0.0);
+        hy_.assign(4*num_elements_, 0.0);
+        D_.assign(num_elements_, 0.0);
+        div_.assign(num_elements_, 0.0);
+    }
+    bool gather = (assembly_ == ASSEMBLY_GATHER);
+    if (gather) {
+        slot_x_.assign(4*num_elements_, 0.0);
+        slot_y_.assign(4*num_elements_, 0.0);
+    } else {
+        AlignedDoubleArray().swap(slot_x_);
+        AlignedDoubleArray().swap(slot_y_);
+    }
+    // ASSEMBLY_GATHER なら節点への書き込みがないので、要素をスレッドで分担できる
+    const long num = num_elements_;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(gather && num_threads_ > 1) schedule(static)
+#endif
+    for (long e = 0; e < num; e++) {
+        const int32_t *n = &nodes_[4*e];
+        // 節点データのVector4クラスでの保存
+        Vector4 x, y;
+        for(int i = 0; i < 4; i++){
+            x.set(i, nodes.pos_[n[i]].x_);
+            y.set(i, nodes.pos_[n[i]].y_);
+        }
+        double a_xy = (x.get(0)-x.get(2))*(y.get(1)-y.get(3)) + (x.get(1)-x.get(3))*(y.get(2)-y.get(0)); // alpha_xy = (x1-x3)(y2-y4)+(x2-x4)(y3-y1)
+        double b_xy = (x.get(2)-x.get(3))*(y.get(0)-y.get(1)) + (x.get(0)-x.get(1))*(y.get(3)-y.get(2)); // beta_xy  = (x3-x4)(y1-y2)+(x1-x2)(y4-y3)
+        double r_xy = (x.get(1)-x.get(2))*(y.get(0)-y.get(3)) + (x.get(0)-x.get(3))*(y.get(2)-y.get(1)); // gamma_xy = (x2-x3)(y1-y4)+(x1-x4)(y3-y2)
+
+        // alpha_Niy, alpha_Nix, beta_Niy, beta_Nix, gamma_Niy, gamma_Nix の計算
+        setAlphaBetaGamma_Nxy(e, x, y);
+
+        // 集中化質量 m をnodeに加算
+        addMass(nodes, e, a_xy, b_xy, r_xy);
+
+        // 拡散項行列 D
+        setDiffusionMatrix(e, a_xy, b_xy, r_xy, Re);
+
+        // 要素の大きさsize_の計算
+        setSize(e, x, y);
+
+        if (!lean) {
+            // 圧力ベクトル Hx, Hy
+            setPressureVector(e);
+
+            // 判別式の計算に必要なHx/A, Hy/Aを計算
+            if (precision_ == PRECISION_MIXED) {
+                setPressureVectorBySize(corr_f_, e);
+            } else {
+                setPressureVectorBySize(corr_, e);
+            }
+        }
+
+        // 移流項テンソル
+        if (precompute_convection_) {
+            setConvectionTensor(e);
+        }
+    }
+
+    if (gather) {
+        // 集中化質量を節点ごとに足し込む
+        const long num_nodes = node_slot_begin_.size() - 1;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1)
+#endif
+        for (long k = 0; k < num_nodes; k++) {
+            double m = nodes.m_[k];
+            for (size_t j = node_slot_begin_[k]; j < node_slot_begin_[k + 1]; j++) {
+                m += slot_x_[node_slots_[j]];
+                slot_x_[node_slots_[j]] = 0;
+            }
+            nodes.m_[k] = m;
+        }
+    }
+}
+
+void ElementBlock::gatherVelocityDelta(NodeBlock &nodes) {
+    const long num_nodes = node_slot_begin_.size() - 1;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1)
+#endif
+    for (long k = 0; k < num_nodes; k++) {
+        VectorXY d_vel = nodes.d_vel_[k];
+        for (size_t j = node_slot_begin_[k]; j < node_slot_begin_[k + 1]; j++) {
+            int32_t slot = node_slots_[j];
+            d_vel.x_ += slot_x_[slot];
+            d_vel.y_ += slot_y_[slot];
+            slot_x_[slot] = 0;
+            slot_y_[slot] = 0;
+        }
+        nodes.d_vel_[k] = d_vel;
+    }
+}
+
+/***** ここからはcalcInvariants1() の付属関数 *****/
+
+// a_Nx_, a_Ny_, b_Nx_, b_Ny_, r_Nx_, r_Ny_ の計算
+void ElementBlock::setAlphaBetaGamma_Nxy(size_t e, const Vector4 &x, const Vector4 &y){
+    Matrix4 E;
+    E.unit();
+
+    int j;
+    double ax,ay,bx,by,rx,ry;
+    for(j = 0; j < 4; j++){
+        ax = (E.get(0,j)-E.get(2,j))*(x.get(1)-x.get(3)) + (E.get(1,j)-E.get(3,j))*(x.get(2)-x.get(0));
+        ay = (E.get(0,j)-E.get(2,j))*(y.get(1)-y.get(3)) + (E.get(1,j)-E.get(3,j))*(y.get(2)-y.get(0));
+        bx = (E.get(2,j)-E.get(3,j))*(x.get(0)-x.get(1)) + (E.get(0,j)-E.get(1,j))*(x.get(3)-x.get(2));
+        by = (E.get(2,j)-E.get(3,j))*(y.get(0)-y.get(1)) + (E.get(0,j)-E.get(1,j))*(y.get(3)-y.get(2));
+        rx = (E.get(1,j)-E.get(2,j))*(x.get(0)-x.get(3)) + (E.get(0,j)-E.get(3,j))*(x.get(2)-x.get(1));
+        ry = (E.get(1,j)-E.get(2,j))*(y.get(0)-y.get(3)) + (E.get(0,j)-E.get(3,j))*(y.get(2)-y.get(1));
+        a_Nx_[4*e + j] = ax;
+        a_Ny_[4*e + j] = ay;
+        b_Nx_[4*e + j] = bx;
+        b_Ny_[4*e + j] = by;
+        r_Nx_[4*e + j] = rx;
+        r_Ny_[4*e + j] = ry;
+    }
+}
+
+// 集中化質量の加算
+void ElementBlock::addMass(NodeBlock &nodes, size_t e, double a_xy, double b_xy, double r_xy){
+    for(int i = 0; i < 4; i++){
+        double m = (3*a_xy*ai_[i] + b_xy*bi_[i] + r_xy*ci_[i])/6.0;
+        if (assembly_ == ASSEMBLY_GATHER) {
+            slot_x_[4*e + i] = m;
+        } else {
+            nodes.m_[nodes_[4*e + i]] += m;
+        }
+    }
+}
+
+// 拡散項行列 Dの計算
+void ElementBlock::setDiffusionMatrix(size_t e, double a_xy, double b_xy, double r_xy, double Re){
+    const double *a_Ny = &a_Ny_[4*e];
+    const double *a_Nx = &a_Nx_[4*e];
+    const double *b_Ny = &b_Ny_[4*e];
+    const double *b_Nx = &b_Nx_[4*e];
+    const double *r_Ny = &r_Ny_[4*e];
+    const double *r_Nx = &r_Nx_[4*e];
+    double *d = &d_[16*e];
+    for(int i = 0; i < 4; i++){
+        double val = 0;
+        for(int j = 0; j < 4; j++){
+            val = (/**//**/
+                    3*a_Ny[i]*a_Ny[j] + 3*a_Nx[i]*a_Nx[j]
+                    + b_Ny[i]*b_Ny[j] + b_Nx[i]*b_Nx[j]
+                    + r_Ny[i]*r_Ny[j] + r_Nx[i]*r_Nx[j]
+                    - b_xy/a_xy*(/**/
+                                    a_Ny[i]*b_Ny[j] + a_Ny[j]*b_Ny[i]
+                                    + a_Nx[i]*b_Nx[j] + a_Nx[j]*b_Nx[i]
+                                /**/)
+                    - r_xy/a_xy*(/**/
+                                    a_Ny[i]*r_Ny[j] + a_Ny[j]*r_Ny[i]
+                                    + a_Nx[i]*r_Nx[j] + a_Nx[j]*r_Nx[i]
+                                /**/)
+            /**//**/)/(Re*6*a_xy);
+            d[i*4 + j] = val;
+        }
+    }
+}
+
+void ElementBlock::setPressureVector(size_t e){
+    for(int i = 0; i < 4; i++){
+        hx_[4*e + i] = 0.5*a_Ny_[4*e + i];
+        hy_[4*e + i] = -0.5*a_Nx_[4*e + i];
+    }
+}
+
+void ElementBlock::setSize(size_t e, const Vector4 &x, const Vector4 &y){
+    double x1,y1,x2,y2;
+    double val = 0.0;
+    for(int i = 0; i < 4; i++){
+        // 二つの接点(x1,y1),(x2,y2)の値を得る．
+        x1 = x.get(i);
+        y1 = y.get(i);
+        if( i == 3){
+            x2 = x.get(0);
+            y2 = y.get(0);
+        }else{
+            x2 = x.get(i+1);
+            y2 = y.get(i+1);
+        }
+        val += (x1-x2)*(y1+y2)/2.0;
+    }
+    assert(val>0);
+    size_[e] = val;
+}
+
+// Hx, Hy を読む。STORAGE_LEAN では配列を持たないので a_Ny_, a_Nx_ から求める。
+// 1/2 倍は丸め誤差を生じないので、どちらの場合も同じ値になる。
+void ElementBlock::getPressureVector(size_t e, double hx[4], double hy[4]) const {
+    for(int i = 0; i < 4; i++){
+        if (storage_ == STORAGE_LEAN) {
+            hx[i] = 0.5*a_Ny_[4*e + i];
+            hy[i] = -0.5*a_Nx_[4*e + i];
+        } else {
+            hx[i] = hx_[4*e + i];
+            hy[i] = hy_[4*e + i];
+        }
+    }
+}
+
+template <class Real>
+void ElementBlock::setPressureVectorBySize(CorrectionInvariants<Real> &corr, size_t e){
+    for(int i = 0; i < 4; i ++){
+        corr.hx_by_a_[4*e + i] = hx_[4*e + i]/size_[e];
+        corr.hy_by_a_[4*e + i] = hy_[4*e + i]/size_[e];
+    }
+}
+// 移流項テンソルの計算
+// calcVelocityPrediction(nodes, e) の A_ij の式で Au = sum_k ai_[k]*u_k などを展開し、
+// u_k, v_k の係数をまとめたもの。
+void ElementBlock::setConvectionTensor(size_t e){
+    const double *a_Ny = &a_Ny_[4*e];
+    const double *a_Nx = &a_Nx_[4*e];
+    const double *b_Ny = &b_Ny_[4*e];
+    const double *b_Nx = &b_Nx_[4*e];
+    const double *r_Ny = &r_Ny_[4*e];
+    const double *r_Nx = &r_Nx_[4*e];
+    double *Tu = &conv_[128*e];
+    double *Tv = &conv_[128*e + 64];
+    for(int k = 0; k < 4; k++){
+        for(int i = 0; i < 4; i++){
+            // a_N[j], b_N[j], r_N[j] に掛かる係数
+            double ka = 9*ai_[i]*ai_[k] + 3*(bi_[i]*bi_[k] + ci_[i]*ci_[k]) + di_[i]*di_[k];
+            double kb = 3*(ai_[i]*bi_[k] + bi_[i]*ai_[k]) + di_[i]*ci_[k] + ci_[i]*di_[k];
+            double kr = 3*(ai_[i]*ci_[k] + ci_[i]*ai_[k]) + di_[i]*bi_[k] + bi_[i]*di_[k];
+            for(int j = 0; j < 4; j++){
+                // A_x
+                Tu[16*k + 4*j + i] = (1.0/18.0)*(ka*a_Ny[j] + kb*b_Ny[j] + kr*r_Ny[j]);
+                // A_y
+                Tv[16*k + 4*j + i] = -(1.0/18.0)*(ka*a_Nx[j] + kb*b_Nx[j] + kr*r_Nx[j]);
+            }
+        }
+    }
+}
+/***** ここまでが calcInvariants1() の付属関数 *****/
+
+void ElementBlock::calcInvariants2(const NodeBlock &nodes, double delta_t, double relaxation) {
+    /*
+     * inv_mを必要とするループ不変量の計算
+     * dt_hx_by_m_, dt_hy_by_m_, lambda_ (precision_ に応じて corr_ または corr_f_ に格納する)
+     * STORAGE_LEAN では lambda_ だけ
+     */
+    size_t e;
+    bool lean = (storage_ == STORAGE_LEAN);
+    for (e = 0; e < num_elements_; e++) {
+        if (precision_ == PRECISION_MIXED) {
+            if (!lean) {
+                setDtHxyByM(corr_f_, nodes, e, delta_t);
+            }
+            setLambda(corr_f_, nodes, e, delta_t, relaxation);
+            continue;
+        }
+        // dt_hx_by_m_, dt_hy_by_m_ の計算
+        if (!lean) {
+            setDtHxyByM(corr_, nodes, e, delta_t);
+        }
+
+        //lambda_ の計算
+        setLambda(corr_, nodes, e, delta_t, relaxation);
+    }
+    // 要素ごとの緩和係数は新しい lambda_ から調整し直す
+    relaxation_ = relaxation;
+    AlignedDoubleArray().swap(relax_factor_);
+    AlignedDoubleArray().swap(lambda_base_);
+    AlignedDoubleArray().swap(D_prev_);
+}
+
+void ElementBlock::adaptRelaxation(double epsilon) {
+    if (storage_ == STORAGE_LEAN) {
+        return;
+    }
+    if (precision_ == PRECISION_MIXED) {
+        adaptRelaxation(corr_f_, epsilon);
+    } else {
+        adaptRelaxation(corr_, epsilon);
+    }
+}
+
+template <class Real>
+void ElementBlock::adaptRelaxation(CorrectionInvariants<Real> &corr, double epsilon) {
+    long e;
+    const long n = num_elements_;
+    if (relax_factor_.size() != num_elements_) {
+        relax_factor_.assign(n, 1.0);
+        lambda_base_.resize(n);
+        for (e = 0; e < n; e++) {
+            lambda_base_[e] = corr.lambda_relaxation_[e];
+        }
+        D_prev_.assign(n, 0.0);
+        relax_cap_ = std::max(RELAX_MAX, relaxation_);
+        D_sum_min_ = HUGE_VAL;
+    }
+    const double factor_max = relax_cap_ / relaxation_;
+    double sum = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1) reduction(+:sum)
+#endif
+    for (e = 0; e < n; e++) {
+        double D = D_[e];
+        double prev = D_prev_[e];
+        D_prev_[e] = D;
+        sum += std::fabs(D);
+        if (prev <= epsilon && prev >= -epsilon) {
+            continue;
+        }
+        // 同じ符号のまま減り方が遅ければ上げる
+        double r = D / prev;
+        if (r > RELAX_SLOW && r <= 1 && relax_factor_[e] < factor_max) {
+            double factor = std::min(relax_factor_[e] * RELAX_UP, factor_max);
+            relax_factor_[e] = factor;
+            corr.lambda_relaxation_[e] = lambda_base_[e] * factor;
+        }
+    }
+
+    // 判別式の絶対値の和が、このループでの最小値の RELAX_GUARD 倍を超えたら発散しかけているので、
+    // 上限を RELAX_GUARD_CUT 倍にして、上限を超える要素を上限まで下げる
+    if (sum <= RELAX_GUARD * D_sum_min_) {
+        D_sum_min_ = std::min(D_sum_min_, sum);
+        return;
+    }
+    D_sum_min_ = sum;
+    relax_cap_ = std::max(relax_cap_ * RELAX_GUARD_CUT, RELAX_MIN);
+    const double factor_cap = relax_cap_ / relaxation_;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1)
+#endif
+    for (e = 0; e < n; e++) {
+        if (relax_factor_[e] > factor_cap) {
+            relax_factor_[e] = factor_cap;
+            corr.lambda_relaxation_[e] = lambda_base_[e] * factor_cap;
+        }
+    }
+}
+
+void ElementBlock::clearRelaxationHistory() {
+    std::fill(D_prev_.begin(), D_prev_.end(), 0.0);
+    D_sum_min_ = HUGE_VAL;
+}
+
+double ElementBlock::meanRelaxation() const {
+    if (relax_factor_.empty()) {
+        return relaxation_;
+    }
+    double sum = 0;
+    for (size_t e = 0; e < relax_factor_.size(); e++) {
+        sum += relax_factor_[e];
+    }
+    return relaxation_ * sum / relax_factor_.size();
+}
+
+template <class Real>
+void ElementBlock::setDtHxyByM(CorrectionInvariants<Real> &corr, const NodeBlock &nodes, size_t e, double delta_t){
+    //delta_t * Hx * M(-1)
+    for(int i = 0; i < 4; i++){
+        double inv_m = nodes.inv_m_[nodes_[4*e + i]];
+        corr.dt_hx_by_m_[4*e + i] = delta_t * inv_m * hx_[4*e + i];
+        corr.dt_hy_by_m_[4*e + i] = delta_t * inv_m * hy_[4*e + i];
+    }
+}
+
+template <class Real>
+void ElementBlock::setLambda(CorrectionInvariants<Real> &corr, const NodeBlock &nodes, size_t e,
+        double delta_t, double relaxation){
+    double hx_m_hx, hy_m_hy;
+    double hx_e[4], hy_e[4];
+    getPressureVector(e, hx_e, hy_e);
+    Vector4 hx(hx_e[0], hx_e[1], hx_e[2], hx_e[3]);
+    Vector4 hy(hy_e[0], hy_e[1], hy_e[2], hy_e[3]);
+    Matrix4 inv_m;
+    inv_m.unit();
+    for(int i = 0; i < 4; i++){
+        inv_m.set(i,i,nodes.inv_m_[nodes_[4*e + i]]);
+    }
+    hx_m_hx = hx.dot(inv_m*hx);
+    hy_m_hy = hy.dot(inv_m*hy);
+    corr.lambda_relaxation_[e] = size_[e]*relaxation / (delta_t * (hx_m_hx + hy_m_hy));
+}
+
+void ElementBlock::partRange(Part part, size_t &begin, size_t &end) const {
+    begin = (part == PART_INTERIOR) ? split_ : 0;
+    end = (part == PART_BOUNDARY) ? split_ : num_elements_;
+}
+
+void ElementBlock::colorRange(size_t c, size_t begin, size_t end, size_t &first, size_t &last) const {
+    // 色の要素のリストは昇順
+    std::vector<int32_t>::const_iterator list_begin = color_elements_.begin() + color_begin_[c];
+    std::vector<int32_t>::const_iterator list_end = color_elements_.begin() + color_begin_[c + 1];
+    first = std::lower_bound(list_begin, list_end, (int32_t)begin) - color_elements_.begin();
+    last = std::lower_bound(list_begin, list_end, (int32_t)end) - color_elements_.begin();
+}
+
+struct ElementBlock::PredictionTask {
+    ElementBlock &block_;
+    NodeBlock &nodes_;
+    const int32_t *list_;
+    size_t first_;
+
+    PredictionTask(ElementBlock &block, NodeBlock &nodes) : block_(block), nodes_(nodes), list_(NULL), first_(0) {}
+
+    void operator()(size_t k) {
+        size_t begin = block_.chunkBegin(list_, first_, k);
+        block_.calcVelocityPredictionRange(nodes_, begin, std::min(begin + block_.color_chunk_, block_.num_elements_));
+    }
+};
+
+template <class Real>
+struct ElementBlock::CorrectionTask {
+    ElementBlock &block_;
+    const CorrectionInvariants<Real> &corr_;
+    NodeBlock &nodes_;
+    double epsilon_;
+    const int32_t *list_;
+    size_t first_;
+    // このスレッドで補正した要素があればtrue
+    bool flag_;
+
+    CorrectionTask(ElementBlock &block, const CorrectionInvariants<Real> &corr, NodeBlock &nodes, double epsilon)
+        : block_(block), corr_(corr), nodes_(nodes), epsilon_(epsilon), list_(NULL), first_(0), flag_(false) {}
+
+    void operator()(size_t k) {
+        size_t begin = block_.chunkBegin(list_, first_, k);
+        if (block_.calcDivergenceAndCorrectRange(corr_, nodes_, begin,
+                std::min(begin + block_.color_chunk_, block_.num_elements_), epsilon_)) {
+            flag_ = true;
+        }
+    }
+};
+
+template <class Task>
+void ElementBlock::runChunks(Task &task, size_t begin, size_t end) {
+    if (assembly_ == ASSEMBLY_GATHER) {
+        task.list_ = NULL;
+        task.first_ = begin;
+        scheduler_.run((end - begin + color_chunk_ - 1) / color_chunk_, task);
+        return;
+    }
+    // 色が変わるところで全スレッドがそろう (WorkStealingScheduler::run())
+    for (size_t c = 0; c < numColors(); c++) {
+        size_t first, last;
+        colorRange(c, begin, end, first, last);
+        task.list_ = color_elements_.data() + first;
+        scheduler_.run((last - first + color_chunk_ - 1) / color_chunk_, task);
+    }
+}
+
+void ElementBlock::calcVelocityPrediction(NodeBlock &nodes, Part part){
+    size_t part_begin, part_end;
+    partRange(part, part_begin, part_end);
+    if (num_threads_ <= 1) {
+        calcVelocityPredictionRange(nodes, part_begin, part_end);
+    } else if (schedule_ == SCHEDULE_STEALING) {
+        assert(color_chunk_ % simdWidth(simd_isa_) == 0);
+        if (scheduler_.maxThreads() < num_threads_) {
+            scheduler_.init(num_threads_);
+        }
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads_)
+#endif
+        {
+            PredictionTask task(*this, nodes);
+            runChunks(task, part_begin, part_end);
+        }
+    } else if (assembly_ == ASSEMBLY_GATHER) {
+        // 節点に書き込まないので、連続する color_chunk_ 要素ずつスレッドで分担する
+        assert(color_chunk_ % simdWidth(simd_isa_) == 0);
+        const long first = part_begin;
+        const long last = part_end;
+        const long chunk = color_chunk_;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) schedule(dynamic)
+#endif
+        for (long begin = first; begin < last; begin += chunk) {
+            calcVelocityPredictionRange(nodes, begin, std::min(begin + chunk, last));
+        }
+    } else {
+        // 色ごとに、その色のチャンクをスレッドで分担する。omp for の終わりで全スレッドがそろう。
+        assert(color_chunk_ % simdWidth(simd_isa_) == 0);
+        const long chunk = color_chunk_;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads_)
+#endif
+        for (size_t c = 0; c < numColors(); c++) {
+            size_t first, last;
+            colorRange(c, part_begin, part_end, first, last);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (long k = first; k < (long)last; k += chunk) {
+                size_t begin = color_elements_[k];
+                calcVelocityPredictionRange(nodes, begin, std::min(begin + color_chunk_, num_elements_));
+            }
+        }
+    }
+    if (assembly_ == ASSEMBLY_GATHER) {
+        gatherVelocityDelta(nodes);
+    }
+}
+
+void ElementBlock::calcVelocityPredictionRange(NodeBlock &nodes, size_t begin, size_t end){
+    size_t e = begin;
+    // SIMDで計算できる組の数だけ要素をまとめて処理する
+    size_t num_simd = end - (end - begin) % simdWidth(simd_isa_);
+#ifdef ELEMENTBLOCK_X86_SIMD
+    if (precompute_convection_ && simd_isa_ != SIMD_SCALAR) {
+        // 移流項テンソルを使う場合は1要素ずつ、節点方向の4成分をSIMDで計算する
+        for (; e < end; e++) {
+            calcVelocityPredictionTensorAvx2(nodes, e);
+        }
+    } else if (simd_isa_ == SIMD_AVX512) {
+        for (; e < num_simd; e += 8) {
+            calcVelocityPredictionAvx512(nodes, e);
+        }
+    } else if (simd_isa_ == SIMD_AVX2) {
+        for (; e < num_simd; e += 4) {
+            calcVelocityPredictionAvx2(nodes, e);
+        }
+    }
+#endif
+    // 端数の要素は1要素ずつ計算する
+    for (; e < end; e++) {
+        if (precompute_convection_) {
+            calcVelocityPredictionByTensor(nodes, e);
+        } else {
+            calcVelocityPrediction(nodes, e);
+        }
+    }
+}
+
+/*
+ * 速度の予測値 (1要素分)
+ * 移流項行列Aは作らず、A*u, A*v を節点速度と a_N, b_N, r_N の内積から直接求める。
+ *   A_ij = 1/18 * ( ka_i(u)*a_Ny_j + kb_i(u)*b_Ny_j + kr_i(u)*r_Ny_j
+ *                 - ka_i(v)*a_Nx_j - kb_i(v)*b_Nx_j - kr_i(v)*r_Nx_j )
+ *   ka_i(u) = 9*ai*Au + 3*(bi*Bu + ci*Cu) + di*Du
+ *   kb_i(u) = 3*(ai*Bu + bi*Au) + di*Cu + ci*Du
+ *   kr_i(u) = 3*(ai*Cu + ci*Au) + di*Bu + bi*Du
+ * なので (A*u)_i = 1/18 * ( ka_i(u)*(a_Ny.u) + ... - kr_i(v)*(r_Nx.u) ) となる。
+ */
+void ElementBlock::calcVelocityPrediction(NodeBlock &nodes, size_t e){
+    int i, j;
+    const int32_t *n = &nodes_[4*e];
+    const double *a_Ny = &a_Ny_[4*e];
+    const double *a_Nx = &a_Nx_[4*e];
+    const double *b_Ny = &b_Ny_[4*e];
+    const double *b_Nx = &b_Nx_[4*e];
+    const double *r_Ny = &r_Ny_[4*e];
+    const double *r_Nx = &r_Nx_[4*e];
+    const double *d = &d_[16*e];
+    double hx[4], hy[4];
+    getPressureVector(e, hx, hy);
+    double p = p_[e];
+
+    // 節点速度
+    double u[4], v[4];
+    for(i = 0; i < 4; i++){
+        u[i] = nodes.vel_[n[i]].x_;
+        v[i] = nodes.vel_[n[i]].y_;
+    }
+
+    // 速度のモーメントと、a_N, b_N, r_N との内積
+    double Au = 0, Av = 0, Bu = 0, Bv = 0, Cu = 0, Cv = 0, Du = 0, Dv = 0;
+    double aNy_u = 0, bNy_u = 0, rNy_u = 0, aNx_u = 0, bNx_u = 0, rNx_u = 0;
+    double aNy_v = 0, bNy_v = 0, rNy_v = 0, aNx_v = 0, bNx_v = 0, rNx_v = 0;
+    for(j = 0; j < 4; j++){
+        Au += ai_[j] * u[j];
+        Av += ai_[j] * v[j];
+        Bu += bi_[j] * u[j];
+        Bv += bi_[j] * v[j];
+        Cu += ci_[j] * u[j];
+        Cv += ci_[j] * v[j];
+        Du += di_[j] * u[j];
+        Dv += di_[j] * v[j];
+        aNy_u += a_Ny[j] * u[j];
+        bNy_u += b_Ny[j] * u[j];
+        rNy_u += r_Ny[j] * u[j];
+        aNx_u += a_Nx[j] * u[j];
+        bNx_u += b_Nx[j] * u[j];
+        rNx_u += r_Nx[j] * u[j];
+        aNy_v += a_Ny[j] * v[j];
+        bNy_v += b_Ny[j] * v[j];
+        rNy_v += r_Ny[j] * v[j];
+        aNx_v += a_Nx[j] * v[j];
+        bNx_v += b_Nx[j] * v[j];
+        rNx_v += r_Nx[j] * v[j];
+    }
+
+    for(i = 0; i < 4; i++){
+        double ka_u = 9*ai_[i]*Au + 3*(bi_[i]*Bu + ci_[i]*Cu) + di_[i]*Du;
+        double kb_u = 3*(ai_[i]*Bu + bi_[i]*Au) + di_[i]*Cu + ci_[i]*Du;
+        double kr_u = 3*(ai_[i]*Cu + ci_[i]*Au) + di_[i]*Bu + bi_[i]*Du;
+        double ka_v = 9*ai_[i]*Av + 3*(bi_[i]*Bv + ci_[i]*Cv) + di_[i]*Dv;
+        double kb_v = 3*(ai_[i]*Bv + bi_[i]*Av) + di_[i]*Cv + ci_[i]*Dv;
+        double kr_v = 3*(ai_[i]*Cv + ci_[i]*Av) + di_[i]*Bv + bi_[i]*Dv;
+
+        // 移流項 (A*u)_i, (A*v)_i と、外力 - Fx, - Fy
+        double d_u = (1.0/18.0)*(ka_u*aNy_u + kb_u*bNy_u + kr_u*rNy_u
+                - ka_v*aNx_u - kb_v*bNx_u - kr_v*rNx_u) - hx[i]*p;
+        double d_v = (1.0/18.0)*(ka_u*aNy_v + kb_u*bNy_v + kr_u*rNy_v
+                - ka_v*aNx_v - kb_v*bNx_v - kr_v*rNx_v) - hy[i]*p;
+        // 拡散項
+        for(j = 0; j < 4; j++){
+            d_u += d[i*4 + j] * u[j];
+            d_v += d[i*4 + j] * v[j];
+        }
+        double delta_t_by_m = nodes.delta_t_by_m_[n[i]];
+        addVelocityDelta(nodes, e, i, -delta_t_by_m * d_u, -delta_t_by_m * d_v);
+    }
+}
+
+/*
+ * 移流項テンソルを使う速度予測 (1要素分)
+ * 移流項行列の列 A_:j = sum_k (Tu_kj: * u_k + Tv_kj: * v_k) を1列ずつ作ってすぐに使う。
+ */
+void ElementBlock::calcVelocityPredictionByTensor(NodeBlock &nodes, size_t e){
+    int i, j, k;
+    const int32_t *n = &nodes_[4*e];
+    const double *Tu = &conv_[128*e];
+    const double *Tv = &conv_[128*e + 64];
+    const double *d = &d_[16*e];
+    double hx[4], hy[4];
+    getPressureVector(e, hx, hy);
+    double p = p_[e];
+
+    double u[4], v[4];
+    for(i = 0; i < 4; i++){
+        u[i] = nodes.vel_[n[i]].x_;
+        v[i] = nodes.vel_[n[i]].y_;
+    }
+
+    double d_u[4], d_v[4];
+    for(i = 0; i < 4; i++){
+        d_u[i] = - hx[i]*p; // - Fx 外力
+        d_v[i] = - hy[i]*p; // - Fy
+    }
+    for(j = 0; j < 4; j++){
+        // 列j : A_ij + d_ij (拡散項行列は対称なので d_ji で読む)
+        double col[4];
+        for(i = 0; i < 4; i++){
+            col[i] = d[j*4 + i];
+        }
+        for(k = 0; k < 4; k++){
+            for(i = 0; i < 4; i++){
+                col[i] += Tu[16*k + 4*j + i]*u[k] + Tv[16*k + 4*j + i]*v[k];
+            }
+        }
+        for(i = 0; i < 4; i++){
+            d_u[i] += col[i] * u[j];
+            d_v[i] += col[i] * v[j];
+        }
+    }
+    for(i = 0; i < 4; i++){
+        double delta_t_by_m = nodes.delta_t_by_m_[n[i]];
+        addVelocityDelta(nodes, e, i, -delta_t_by_m * d_u[i], -delta_t_by_m * d_v[i]);
+    }
+}
+
+bool ElementBlock::calcDivergenceAndCorrect(NodeBlock &nodes, double epsilon, Part part) {
+    if (precision_ == PRECISION_MIXED) {
+        return calcDivergenceAndCorrect(corr_f_, nodes, epsilon, part);
+    }
+    return calcDivergenceAndCorrect(corr_, nodes, epsilon, part);
+}
+
+template <class Real>
+bool ElementBlock::calcDivergenceAndCorrect(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, double epsilon,
+        Part part) {
+    bool flag = 0;
+    size_t part_begin, part_end;
+    partRange(part, part_begin, part_end);
+    if (num_threads_ <= 1) {
+        flag = calcDivergenceAndCorrectRange(corr, nodes, part_begin, part_end, epsilon);
+    } else if (schedule_ == SCHEDULE_STEALING) {
+        assert(color_chunk_ % simdWidth(simd_isa_) == 0);
+        if (scheduler_.maxThreads() < num_threads_) {
+            scheduler_.init(num_threads_);
+        }
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads_) reduction(||:flag)
+#endif
+        {
+            CorrectionTask<Real> task(*this, corr, nodes, epsilon);
+            runChunks(task, part_begin, part_end);
+            if (task.flag_) {
+                flag = 1;
+            }
+        }
+    } else if (assembly_ == ASSEMBLY_GATHER) {
+        assert(color_chunk_ % simdWidth(simd_isa_) == 0);
+        const long first = part_begin;
+        const long last = part_end;
+        const long chunk = color_chunk_;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) schedule(dynamic) reduction(||:flag)
+#endif
+        for (long begin = first; begin < last; begin += chunk) {
+            if (calcDivergenceAndCorrectRange(corr, nodes, begin, std::min(begin + chunk, last), epsilon)) {
+                flag = 1;
+            }
+        }
+    } else {
+        // 判別式は補正前の速度 vel_ から求め、補正は速度変化量 d_vel_ に加算するので、
+        // 色の順に計算しても補正する要素は1スレッドの場合と変わらない。
+        assert(color_chunk_ % simdWidth(simd_isa_) == 0);
+        const long chunk = color_chunk_;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads_) reduction(||:flag)
+#endif
+        for (size_t c = 0; c < numColors(); c++) {
+            size_t first, last;
+            colorRange(c, part_begin, part_end, first, last);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (long k = first; k < (long)last; k += chunk) {
+                size_t begin = color_elements_[k];
+                if (calcDivergenceAndCorrectRange(corr, nodes, begin, std::min(begin + color_chunk_, num_elements_), epsilon)) {
+                    flag = 1;
+                }
+            }
+        }
+    }
+    // 補正した要素がなければ slot_x_, slot_y_ はゼロのまま
+    if (assembly_ == ASSEMBLY_GATHER && flag) {
+        gatherVelocityDelta(nodes);
+    }
+    return flag;
+}
+
+bool ElementBlock::calcDivergenceAndCorrectColor(NodeBlock &nodes, double epsilon, size_t color) {
+    if (precision_ == PRECISION_MIXED) {
+        return calcDivergenceAndCorrectColor(corr_f_, nodes, epsilon, color);
+    }
+    return calcDivergenceAndCorrectColor(corr_, nodes, epsilon, color);
+}
+
+template <class Real>
+bool ElementBlock::calcDivergenceAndCorrectColor(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+        double epsilon, size_t color) {
+    bool flag = 0;
+    if (color >= numColors()) {
+        return flag;
+    }
+    // 同じ色のチャンクは節点を共有しないので、ASSEMBLY_GATHER でなくてもスレッドで分担できる
+    const long first = color_begin_[color];
+    const long last = color_begin_[color + 1];
+    const long chunk = color_chunk_;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) schedule(dynamic) reduction(||:flag) if(num_threads_ > 1)
+#endif
+    for (long k = first; k < last; k += chunk) {
+        size_t begin = color_elements_[k];
+        if (calcDivergenceAndCorrectRange(corr, nodes, begin, std::min(begin + color_chunk_, num_elements_), epsilon)) {
+            flag = 1;
+        }
+    }
+    if (assembly_ == ASSEMBLY_GATHER && flag) {
+        gatherVelocityDelta(nodes);
+    }
+    return flag;
+}
+
+void ElementBlock::updateActiveElements(NodeBlock &nodes, bool all) {
+    size_t k, j;
+    if (nodes.moved_.size() != nodes.num_nodes_) {
+        nodes.moved_.assign(nodes.num_nodes_, 0);
+        all = true;
+    }
+    if (active_.size() != num_elements_) {
+        active_.assign(num_elements_, 0);
+        all = true;
+    }
+    if (all) {
+        std::fill(active_.begin(), active_.end(), 1);
+        std::fill(nodes.moved_.begin(), nodes.moved_.end(), 0);
+        return;
+    }
+    // どの要素も持たない末尾の節点は node_slot_begin_ にないので、gatherVelocityDelta() と同じ範囲を見る
+    const size_t num_nodes = node_slot_begin_.size() - 1;
+    for (k = 0; k < num_nodes; k++) {
+        if (nodes.moved_[k]) {
+            for (j = node_slot_begin_[k]; j < node_slot_begin_[k + 1]; j++) {
+                active_[node_slots_[j] / 4] = 1;
+            }
+            nodes.moved_[k] = 0;
+        }
+    }
+}
+
+size_t ElementBlock::numActiveElements() const {
+    if (active_.empty()) {
+        return num_elements_;
+    }
+    return num_elements_ - std::count(active_.begin(), active_.end(), 0);
+}
+
+void ElementBlock::addPressureDelta(NodeBlock &nodes, const double *dp) {
+    if (precision_ == PRECISION_MIXED) {
+        addPressureDelta(corr_f_, nodes, dp);
+    } else {
+        addPressureDelta(corr_, nodes, dp);
+    }
+}
+
+template <class Real>
+void ElementBlock::addPressureDelta(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, const double *dp) {
+    if (num_threads_ <= 1) {
+        addPressureDeltaRange(corr, nodes, dp, 0, num_elements_);
+    } else {
+        // 同じ色のチャンクは節点を共有しない
+        const long chunk = color_chunk_;
+        for (size_t c = 0; c < numColors(); c++) {
+            const long first = color_begin_[c];
+            const long last = color_begin_[c + 1];
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) schedule(dynamic)
+#endif
+            for (long k = first; k < last; k += chunk) {
+                size_t begin = color_elements_[k];
+                addPressureDeltaRange(corr, nodes, dp, begin, std::min(begin + color_chunk_, num_elements_));
+            }
+        }
+    }
+    if (assembly_ == ASSEMBLY_GATHER) {
+        gatherVelocityDelta(nodes);
+    }
+}
+
+template <class Real>
+void ElementBlock::addPressureDeltaRange(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, const double *dp,
+        size_t begin, size_t end) {
+    for (size_t e = begin; e < end; e++) {
+        double div = dp[e];
+        if (div == 0) {
+            continue;
+        }
+        p_[e] += div;
+        const int32_t *n = &nodes_[4*e];
+        for (int i = 0; i < 4; i++) {
+            if (storage_ == STORAGE_LEAN) {
+                double dt_by_m = nodes.delta_t_by_m_[n[i]];
+                addVelocityDelta(nodes, e, i, dt_by_m*(0.5*a_Ny_[4*e + i])*div, dt_by_m*(-0.5*a_Nx_[4*e + i])*div);
+            } else {
+                addVelocityDelta(nodes, e, i, (double)corr.dt_hx_by_m_[4*e + i]*div,
+                        (double)corr.dt_hy_by_m_[4*e + i]*div);
+            }
+        }
+    }
+}
+
+bool ElementBlock::discriminantExceeds(double epsilon) const {
+    const long n = D_.size();
+    bool flag = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1) reduction(||:flag)
+#endif
+    for (long e = 0; e < n; e++) {
+        if (D_[e] > epsilon || D_[e] < (-epsilon)) {
+            flag = 1;
+        }
+    }
+    return flag;
+}
+
+template <class Real>
+bool ElementBlock::calcDivergenceAndCorrectRange(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+        size_t begin, size_t end, double epsilon) {
+    if (active_.empty()) {
+        return calcDivergenceAndCorrectDense(corr, nodes, begin, end, epsilon);
+    }
+    // 8要素の組の区切りで分け、active_ の要素を含む組だけを計算する。
+    // 組の先頭はSIMDの組の先頭と揃うので、全要素を計算する場合と同じ計算になる
+    bool flag = 0;
+    size_t first, last, e;
+    for (first = begin; first < end; first = last) {
+        last = std::min((first / 8 + 1) * 8, end);
+        bool active = false;
+        for (e = first; e < last; e++) {
+            if (active_[e]) {
+                active = true;
+            }
+        }
+        if (!active) {
+            continue;
+        }
+        bool corrected = calcDivergenceAndCorrectDense(corr, nodes, first, last, epsilon);
+        for (e = first; e < last; e++) {
+            active_[e] = corrected ? 1 : 0;
+        }
+        if (corrected) {
+            flag = 1;
+        }
+    }
+    return flag;
+}
+
+template <class Real>
+bool ElementBlock::calcDivergenceAndCorrectDense(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+        size_t begin, size_t end, double epsilon) {
+    if (storage_ == STORAGE_LEAN) {
+        return calcDivergenceAndCorrectLean(corr, nodes, begin, end, epsilon);
+    }
+    size_t e = begin;
+    bool flag = 0;
+    size_t num_simd = end - (end - begin) % simdWidth(simd_isa_);
+#ifdef ELEMENTBLOCK_X86_SIMD
+    if (simd_isa_ == SIMD_AVX512) {
+        for (; e < num_simd; e += 8) {
+            if (calcDivergenceAndCorrectAvx512(corr, nodes, e, epsilon)) {
+                flag = 1;
+            }
+        }
+    } else if (simd_isa_ == SIMD_AVX2) {
+        for (; e < num_simd; e += 4) {
+            if (calcDivergenceAndCorrectAvx2(corr, nodes, e, epsilon)) {
+                flag = 1;
+            }
+        }
+    }
+#endif
+    for (; e < end; e++) {
+        // 判別式D_の計算
+        calcDiscriminant(corr, nodes, e);
+
+        // 閾値を超えた要素に対して補正を行う
+        if (D_[e] > epsilon || D_[e] < (-epsilon)) {
+            correctVelocity(corr, nodes, e);
+            flag = 1;
+        }
+    }
+    return flag;
+}
+
+// 収束判別式の計算
+template <class Real>
+void ElementBlock::calcDiscriminant(const CorrectionInvariants<Real> &corr, const NodeBlock &nodes, size_t e){
+    const int32_t *n = &nodes_[4*e];
+    const Real *hx_by_a = &corr.hx_by_a_[4*e];
+    const Real *hy_by_a = &corr.hy_by_a_[4*e];
+    double D = 0;
+    for(int i = 0; i < 4; i++){
+        const VectorXY &vel = nodes.vel_[n[i]];
+        D += (double)hx_by_a[i]*vel.x_ + (double)hy_by_a[i]*vel.y_;
+    }
+    D_[e] = D;
+}
+
+// 速度変化量の計算(速度補正値)
+template <class Real>
+void ElementBlock::correctVelocity(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, size_t e){
+    const Real *dt_hx_by_m = &corr.dt_hx_by_m_[4*e];
+    const Real *dt_hy_by_m = &corr.dt_hy_by_m_[4*e];
+    // 圧力変化量の計算
+    double div = -(double)corr.lambda_relaxation_[e]*D_[e];
+    div_[e] = div;
+    // 圧力の補正
+    p_[e] += div;
+    // 速度変化量へ加算
+    for(int i = 0; i < 4; i++){
+        addVelocityDelta(nodes, e, i, (double)dt_hx_by_m[i]*div, (double)dt_hy_by_m[i]*div);
+    }
+}
+
+/*
+ * STORAGE_LEAN の場合の判別式と速度補正
+ * Hx/A = a_Ny/(2*size), Hy/A = -a_Nx/(2*size), delta_t*M^-1*Hx = delta_t_by_m * a_Ny/2 などを
+ * 配列に持たずに、その場で求める。判別式は一時変数に置き、D_, div_ には書かない。
+ */
+template <class Real>
+bool ElementBlock::calcDivergenceAndCorrectLean(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+        size_t begin, size_t end, double epsilon) {
+    size_t e = begin;
+    bool flag = 0;
+    size_t num_simd = end - (end - begin) % simdWidth(simd_isa_);
+#ifdef ELEMENTBLOCK_X86_SIMD
+    if (simd_isa_ == SIMD_AVX512) {
+        for (; e < num_simd; e += 8) {
+            if (calcDivergenceAndCorrectLeanAvx512(corr, nodes, e, epsilon)) {
+                flag = 1;
+            }
+        }
+    } else if (simd_isa_ == SIMD_AVX2) {
+        for (; e < num_simd; e += 4) {
+            if (calcDivergenceAndCorrectLeanAvx2(corr, nodes, e, epsilon)) {
+                flag = 1;
+            }
+        }
+    }
+#endif
+    for (; e < end; e++) {
+        double D = calcDiscriminantLean(nodes, e);
+        if (D > epsilon || D < (-epsilon)) {
+            correctVelocityLean(corr, nodes, e, D);
+            flag = 1;
+        }
+    }
+    return flag;
+}
+
+// 収束判別式 D = sum_i (a_Ny_i*u_i - a_Nx_i*v_i) / (2*size)
+double ElementBlock::calcDiscriminantLean(const NodeBlock &nodes, size_t e) const {
+    const int32_t *n = &nodes_[4*e];
+    const double *a_Ny = &a_Ny_[4*e];
+    const double *a_Nx = &a_Nx_[4*e];
+    double s = 0;
+    for(int i = 0; i < 4; i++){
+        const VectorXY &vel = nodes.vel_[n[i]];
+        s += a_Ny[i]*vel.x_ - a_Nx[i]*vel.y_;
+    }
+    return s/(2*size_[e]);
+}
+
+// 速度変化量の計算(速度補正値)。delta_t*M^-1*Hx = delta_t_by_m * a_Ny/2
+template <class Real>
+void ElementBlock::correctVelocityLean(const CorrectionInvariants<Real> &corr, NodeBlock &nodes, size_t e, double D){
+    const int32_t *n = &nodes_[4*e];
+    const double *a_Ny = &a_Ny_[4*e];
+    const double *a_Nx = &a_Nx_[4*e];
+    double div = -(double)corr.lambda_relaxation_[e]*D;
+    p_[e] += div;
+    for(int i = 0; i < 4; i++){
+        double dt_by_m = nodes.delta_t_by_m_[n[i]];
+        addVelocityDelta(nodes, e, i, dt_by_m*(0.5*a_Ny[i])*div, dt_by_m*(-0.5*a_Nx[i])*div);
+    }
+}
+
+// SIMD版 (ElementBlockSimd.cpp) から呼ぶので、両方の精度について実体化しておく
+template void ElementBlock::correctVelocity(const CorrectionInvariants<double> &, NodeBlock &, size_t);
+template void ElementBlock::correctVelocity(const CorrectionInvariants<float> &, NodeBlock &, size_t);
+template void ElementBlock::correctVelocityLean(const CorrectionInvariants<double> &, NodeBlock &, size_t, double);
+template void ElementBlock::correctVelocityLean(const CorrectionInvariants<float> &, NodeBlock &, size_t, double);
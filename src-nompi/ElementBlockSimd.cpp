@@ -0,0 +1,629 @@
+/*
+ * ElementBlockSimd.cpp
+ *
+ * ElementBlockの速度予測・判別式計算のAVX2/AVX-512版。
+ *
+ * 連続する4要素(AVX2)または8要素(AVX-512)を1組とし、レジスタのレーンkに
+ * 要素 e+k の値を載せて、スカラー版と同じ式をレーンごとに同時に計算する。
+ * 要素ごとの4成分ベクトル(a_Ny_[4*e + i] など)は、組の分を読み込んでから転置し、
+ * 「節点iの値を組の全要素分並べたベクトル」にしてから使う。
+ * floatで格納したループ不変量は、読み込んだときにdoubleに変換する。
+ *
+ * 各関数は target 属性でAVX2/AVX-512の命令を使ってコンパイルされるので、
+ * このファイル全体を -mavx2 などでコンパイルする必要はない。
+ * どの関数を呼ぶかは ElementBlock::simd_isa_ によって実行時に決まる。
+ */
+
+#include <ElementBlock.h>
+
+#ifdef ELEMENTBLOCK_X86_SIMD
+
+#include <immintrin.h>
+
+// GCC 12 の immintrin.h は内部で _mm512_undefined_pd() などを使っており、
+// -Wall では誤った未初期化の警告が大量に出るので、このファイルでは抑止する。
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+
+// 節点の速度を (x, y) の並んだdoubleの配列として読むため
+static_assert(sizeof(VectorXY) == 2 * sizeof(double), "VectorXY must be two packed doubles");
+
+namespace {
+
+/***** AVX2 : 4要素を1組とする *****/
+
+// レーンkに base[idx[k]] を集める
+TARGET_AVX2
+inline __m256d gather4(const double *base, __m128i idx) {
+    return _mm256_i32gather_pd(base, idx, 8);
+}
+
+// 要素1個分の4成分を読む。floatで格納している場合はdoubleに変換する。
+TARGET_AVX2
+inline __m256d load4(const double *p) {
+    return _mm256_load_pd(p);
+}
+
+TARGET_AVX2
+inline __m256d load4(const float *p) {
+    return _mm256_cvtps_pd(_mm_load_ps(p));
+}
+
+// 要素kの成分iが p[k*stride + i] にある4要素分を読み、
+// c[i] のレーンkが要素kの成分iとなるように転置する。
+template <class Real>
+TARGET_AVX2
+inline void load4x4T(const Real *p, size_t stride, __m256d c[4]) {
+    __m256d r0 = load4(p);
+    __m256d r1 = load4(p + stride);
+    __m256d r2 = load4(p + 2*stride);
+    __m256d r3 = load4(p + 3*stride);
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+    __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+    __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+    __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+    c[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+    c[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+    c[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+    c[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+
+// 4要素分の節点番号 n[4*k + i] を転置し、idx[i] のレーンkを要素kの節点iとする。
+TARGET_AVX2
+inline void loadIndex4x4T(const int32_t *n, __m128i idx[4]) {
+    __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(n));
+    __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(n + 4));
+    __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(n + 8));
+    __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(n + 12));
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    idx[0] = _mm_unpacklo_epi64(t0, t1);
+    idx[1] = _mm_unpackhi_epi64(t0, t1);
+    idx[2] = _mm_unpacklo_epi64(t2, t3);
+    idx[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+// 4要素の四隅の節点の速度を集める。u[i], v[i] のレーンkが要素kの節点iの速度。
+TARGET_AVX2
+inline void gatherVelocity4(const AlignedXYArray &vel, const __m128i idx[4], __m256d u[4], __m256d v[4]) {
+    const double *base = reinterpret_cast<const double *>(&vel[0]);
+    for (int i = 0; i < 4; i++) {
+        __m128i offset = _mm_slli_epi32(idx[i], 1);
+        u[i] = gather4(base, offset);
+        v[i] = gather4(base + 1, offset);
+    }
+}
+
+// 4要素分の4成分ベクトル(p から転置して読む)と、節点速度 u, v の内積
+TARGET_AVX2
+inline void dot4(const double *p, const __m256d u[4], const __m256d v[4], __m256d &cu, __m256d &cv) {
+    __m256d c[4];
+    load4x4T(p, 4, c);
+    cu = _mm256_mul_pd(c[0], u[0]);
+    cv = _mm256_mul_pd(c[0], v[0]);
+    for (int i = 1; i < 4; i++) {
+        cu = _mm256_fmadd_pd(c[i], u[i], cu);
+        cv = _mm256_fmadd_pd(c[i], v[i], cv);
+    }
+}
+
+/***** AVX-512 : 8要素を1組とする *****/
+
+TARGET_AVX512
+inline __m512d gather8(const double *base, __m256i idx) {
+    return _mm512_i32gather_pd(idx, base, 8);
+}
+
+// 要素k, k+1の4成分 (p, q から4個ずつ) を1本のレジスタに並べる
+TARGET_AVX512
+inline __m512d load2x4(const double *p, const double *q) {
+    return _mm512_shuffle_f64x2(_mm512_maskz_loadu_pd(0x0f, p), _mm512_maskz_loadu_pd(0x0f, q), 0x44);
+}
+
+TARGET_AVX512
+inline __m512d load2x4(const float *p, const float *q) {
+    return _mm512_cvtps_pd(_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(p)), _mm_load_ps(q), 1));
+}
+
+// load4x4T の8要素版。c[i] のレーンkが要素kの成分i。
+template <class Real>
+TARGET_AVX512
+inline void load8x4T(const Real *p, size_t stride, __m512d c[4]) {
+    // z0 = [要素0の4成分, 要素1の4成分], z1 = [要素2, 要素3], ...
+    __m512d z0 = load2x4(p, p + stride);
+    __m512d z1 = load2x4(p + 2*stride, p + 3*stride);
+    __m512d z2 = load2x4(p + 4*stride, p + 5*stride);
+    __m512d z3 = load2x4(p + 6*stride, p + 7*stride);
+    // t0 = [要素0～3の成分0, 要素0～3の成分1], t1 = [要素0～3の成分2, 要素0～3の成分3]
+    const __m512i even = _mm512_setr_epi64(0, 4, 8, 12, 1, 5, 9, 13);
+    const __m512i odd = _mm512_setr_epi64(2, 6, 10, 14, 3, 7, 11, 15);
+    __m512d t0 = _mm512_permutex2var_pd(z0, even, z1);
+    __m512d t1 = _mm512_permutex2var_pd(z0, odd, z1);
+    __m512d t2 = _mm512_permutex2var_pd(z2, even, z3);
+    __m512d t3 = _mm512_permutex2var_pd(z2, odd, z3);
+    const __m512i lo = _mm512_setr_epi64(0, 1, 2, 3, 8, 9, 10, 11);
+    const __m512i hi = _mm512_setr_epi64(4, 5, 6, 7, 12, 13, 14, 15);
+    c[0] = _mm512_permutex2var_pd(t0, lo, t2);
+    c[1] = _mm512_permutex2var_pd(t0, hi, t2);
+    c[2] = _mm512_permutex2var_pd(t1, lo, t3);
+    c[3] = _mm512_permutex2var_pd(t1, hi, t3);
+}
+
+// loadIndex4x4T の8要素版
+TARGET_AVX512
+inline void loadIndex8x4T(const int32_t *n, __m256i idx[4]) {
+    __m512i z0 = _mm512_loadu_si512(n);
+    __m512i z1 = _mm512_loadu_si512(n + 16);
+    for (int i = 0; i < 4; i++) {
+        // 16以上の番号は z1 の成分を指す
+        __m512i sel = _mm512_setr_epi32(i, 4+i, 8+i, 12+i, 16+i, 20+i, 24+i, 28+i,
+                0, 0, 0, 0, 0, 0, 0, 0);
+        idx[i] = _mm512_castsi512_si256(_mm512_permutex2var_epi32(z0, sel, z1));
+    }
+}
+
+TARGET_AVX512
+inline void gatherVelocity8(const AlignedXYArray &vel, const __m256i idx[4], __m512d u[4], __m512d v[4]) {
+    const double *base = reinterpret_cast<const double *>(&vel[0]);
+    for (int i = 0; i < 4; i++) {
+        __m256i offset = _mm256_slli_epi32(idx[i], 1);
+        u[i] = gather8(base, offset);
+        v[i] = gather8(base + 1, offset);
+    }
+}
+
+// dot4 の8要素版
+TARGET_AVX512
+inline void dot8(const double *p, const __m512d u[4], const __m512d v[4], __m512d &cu, __m512d &cv) {
+    __m512d c[4];
+    load8x4T(p, 4, c);
+    cu = _mm512_mul_pd(c[0], u[0]);
+    cv = _mm512_mul_pd(c[0], v[0]);
+    for (int i = 1; i < 4; i++) {
+        cu = _mm512_fmadd_pd(c[i], u[i], cu);
+        cv = _mm512_fmadd_pd(c[i], v[i], cv);
+    }
+}
+
+} // namespace
+
+/*
+ * 速度の予測値 (AVX2, 要素 e～e+3)
+ * ElementBlock::calcVelocityPrediction(nodes, e) と同じ計算をレーンごとに行う。
+ */
+TARGET_AVX2
+void ElementBlock::calcVelocityPredictionAvx2(NodeBlock &nodes, size_t e) {
+    int i, j, k;
+    __m128i idx[4];
+    __m256d u[4], v[4];
+    loadIndex4x4T(&nodes_[4*e], idx);
+    gatherVelocity4(nodes.vel_, idx, u, v);
+
+    // Au = sum(ai_[i]*u[i]) など
+    __m256d Au = _mm256_setzero_pd(), Av = _mm256_setzero_pd();
+    __m256d Bu = _mm256_setzero_pd(), Bv = _mm256_setzero_pd();
+    __m256d Cu = _mm256_setzero_pd(), Cv = _mm256_setzero_pd();
+    __m256d Du = _mm256_setzero_pd(), Dv = _mm256_setzero_pd();
+    for (i = 0; i < 4; i++) {
+        Au = _mm256_fmadd_pd(_mm256_set1_pd(ai_[i]), u[i], Au);
+        Av = _mm256_fmadd_pd(_mm256_set1_pd(ai_[i]), v[i], Av);
+        Bu = _mm256_fmadd_pd(_mm256_set1_pd(bi_[i]), u[i], Bu);
+        Bv = _mm256_fmadd_pd(_mm256_set1_pd(bi_[i]), v[i], Bv);
+        Cu = _mm256_fmadd_pd(_mm256_set1_pd(ci_[i]), u[i], Cu);
+        Cv = _mm256_fmadd_pd(_mm256_set1_pd(ci_[i]), v[i], Cv);
+        Du = _mm256_fmadd_pd(_mm256_set1_pd(di_[i]), u[i], Du);
+        Dv = _mm256_fmadd_pd(_mm256_set1_pd(di_[i]), v[i], Dv);
+    }
+
+    // a_N, b_N, r_N と節点速度の内積
+    __m256d aNy_u, aNy_v, bNy_u, bNy_v, rNy_u, rNy_v;
+    __m256d aNx_u, aNx_v, bNx_u, bNx_v, rNx_u, rNx_v;
+    dot4(&a_Ny_[4*e], u, v, aNy_u, aNy_v);
+    dot4(&b_Ny_[4*e], u, v, bNy_u, bNy_v);
+    dot4(&r_Ny_[4*e], u, v, rNy_u, rNy_v);
+    dot4(&a_Nx_[4*e], u, v, aNx_u, aNx_v);
+    dot4(&b_Nx_[4*e], u, v, bNx_u, bNx_v);
+    dot4(&r_Nx_[4*e], u, v, rNx_u, rNx_v);
+
+    __m256d hx[4], hy[4];
+    if (storage_ == STORAGE_LEAN) {
+        // Hx = a_Ny/2, Hy = -a_Nx/2
+        load4x4T(&a_Ny_[4*e], 4, hx);
+        load4x4T(&a_Nx_[4*e], 4, hy);
+        for (i = 0; i < 4; i++) {
+            hx[i] = _mm256_mul_pd(_mm256_set1_pd(0.5), hx[i]);
+            hy[i] = _mm256_mul_pd(_mm256_set1_pd(-0.5), hy[i]);
+        }
+    } else {
+        load4x4T(&hx_[4*e], 4, hx);
+        load4x4T(&hy_[4*e], 4, hy);
+    }
+    __m256d p = _mm256_load_pd(&p_[e]);
+    const __m256d one_18th = _mm256_set1_pd(1.0/18.0);
+    const __m256d three = _mm256_set1_pd(3.0);
+    const __m256d nine = _mm256_set1_pd(9.0);
+
+    alignas(32) double d_u[4][4], d_v[4][4];
+    for (i = 0; i < 4; i++) {
+        __m256d a = _mm256_set1_pd(ai_[i]);
+        __m256d b = _mm256_set1_pd(bi_[i]);
+        __m256d c = _mm256_set1_pd(ci_[i]);
+        __m256d d = _mm256_set1_pd(di_[i]);
+        // ka_i(u), kb_i(u), kr_i(u), ka_i(v), kb_i(v), kr_i(v)
+        __m256d ka_u = _mm256_fmadd_pd(_mm256_mul_pd(nine, a), Au,
+                _mm256_fmadd_pd(three, _mm256_fmadd_pd(b, Bu, _mm256_mul_pd(c, Cu)), _mm256_mul_pd(d, Du)));
+        __m256d kb_u = _mm256_fmadd_pd(three, _mm256_fmadd_pd(a, Bu, _mm256_mul_pd(b, Au)),
+                _mm256_fmadd_pd(d, Cu, _mm256_mul_pd(c, Du)));
+        __m256d kr_u = _mm256_fmadd_pd(three, _mm256_fmadd_pd(a, Cu, _mm256_mul_pd(c, Au)),
+                _mm256_fmadd_pd(d, Bu, _mm256_mul_pd(b, Du)));
+        __m256d ka_v = _mm256_fmadd_pd(_mm256_mul_pd(nine, a), Av,
+                _mm256_fmadd_pd(three, _mm256_fmadd_pd(b, Bv, _mm256_mul_pd(c, Cv)), _mm256_mul_pd(d, Dv)));
+        __m256d kb_v = _mm256_fmadd_pd(three, _mm256_fmadd_pd(a, Bv, _mm256_mul_pd(b, Av)),
+                _mm256_fmadd_pd(d, Cv, _mm256_mul_pd(c, Dv)));
+        __m256d kr_v = _mm256_fmadd_pd(three, _mm256_fmadd_pd(a, Cv, _mm256_mul_pd(c, Av)),
+                _mm256_fmadd_pd(d, Bv, _mm256_mul_pd(b, Dv)));
+
+        // 移流項 (A*u)_i, (A*v)_i
+        __m256d Au_i = _mm256_mul_pd(one_18th, _mm256_sub_pd(
+                _mm256_fmadd_pd(ka_u, aNy_u, _mm256_fmadd_pd(kb_u, bNy_u, _mm256_mul_pd(kr_u, rNy_u))),
+                _mm256_fmadd_pd(ka_v, aNx_u, _mm256_fmadd_pd(kb_v, bNx_u, _mm256_mul_pd(kr_v, rNx_u)))));
+        __m256d Av_i = _mm256_mul_pd(one_18th, _mm256_sub_pd(
+                _mm256_fmadd_pd(ka_u, aNy_v, _mm256_fmadd_pd(kb_u, bNy_v, _mm256_mul_pd(kr_u, rNy_v))),
+                _mm256_fmadd_pd(ka_v, aNx_v, _mm256_fmadd_pd(kb_v, bNx_v, _mm256_mul_pd(kr_v, rNx_v)))));
+
+        // - Fx, - Fy 外力
+        __m256d su = _mm256_fnmadd_pd(hx[i], p, Au_i);
+        __m256d sv = _mm256_fnmadd_pd(hy[i], p, Av_i);
+
+        // 拡散項 (行列の行i)
+        __m256d diff[4];
+        load4x4T(&d_[16*e + 4*i], 16, diff);
+        for (j = 0; j < 4; j++) {
+            su = _mm256_fmadd_pd(diff[j], u[j], su);
+            sv = _mm256_fmadd_pd(diff[j], v[j], sv);
+        }
+        __m256d delta_t_by_m = gather4(&nodes.delta_t_by_m_[0], idx[i]);
+        _mm256_store_pd(d_u[i], _mm256_mul_pd(delta_t_by_m, su));
+        _mm256_store_pd(d_v[i], _mm256_mul_pd(delta_t_by_m, sv));
+    }
+
+    // 節点への加算は要素番号順に1要素ずつ行う
+    for (k = 0; k < 4; k++) {
+        for (i = 0; i < 4; i++) {
+            addVelocityDelta(nodes, e + k, i, -d_u[i][k], -d_v[i][k]);
+        }
+    }
+}
+
+/*
+ * 判別式と速度補正 (AVX2, 要素 e～e+3)
+ * 判別式はレーンごとに計算し、閾値を超えた要素だけを correctVelocity() で補正する。
+ */
+template <class Real>
+TARGET_AVX2
+bool ElementBlock::calcDivergenceAndCorrectAvx2(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+        size_t e, double epsilon) {
+    int i, k;
+    __m128i idx[4];
+    __m256d u[4], v[4];
+    __m256d hx_by_a[4], hy_by_a[4];
+    loadIndex4x4T(&nodes_[4*e], idx);
+    gatherVelocity4(nodes.vel_, idx, u, v);
+    load4x4T(&corr.hx_by_a_[4*e], 4, hx_by_a);
+    load4x4T(&corr.hy_by_a_[4*e], 4, hy_by_a);
+
+    __m256d D = _mm256_setzero_pd();
+    for (i = 0; i < 4; i++) {
+        D = _mm256_fmadd_pd(hx_by_a[i], u[i], D);
+        D = _mm256_fmadd_pd(hy_by_a[i], v[i], D);
+    }
+    _mm256_store_pd(&D_[e], D);
+
+    // |D| > epsilon
+    __m256d abs_D = _mm256_andnot_pd(_mm256_set1_pd(-0.0), D);
+    int mask = _mm256_movemask_pd(_mm256_cmp_pd(abs_D, _mm256_set1_pd(epsilon), _CMP_GT_OQ));
+    if (mask == 0) {
+        return false;
+    }
+    for (k = 0; k < 4; k++) {
+        if (mask & (1 << k)) {
+            correctVelocity(corr, nodes, e + k);
+        }
+    }
+    return true;
+}
+
+/*
+ * 速度の予測値 (AVX-512, 要素 e～e+7)
+ * ElementBlock::calcVelocityPrediction(nodes, e) と同じ計算をレーンごとに行う。
+ */
+TARGET_AVX512
+void ElementBlock::calcVelocityPredictionAvx512(NodeBlock &nodes, size_t e) {
+    int i, j, k;
+    __m256i idx[4];
+    __m512d u[4], v[4];
+    loadIndex8x4T(&nodes_[4*e], idx);
+    gatherVelocity8(nodes.vel_, idx, u, v);
+
+    // Au = sum(ai_[i]*u[i]) など
+    __m512d Au = _mm512_setzero_pd(), Av = _mm512_setzero_pd();
+    __m512d Bu = _mm512_setzero_pd(), Bv = _mm512_setzero_pd();
+    __m512d Cu = _mm512_setzero_pd(), Cv = _mm512_setzero_pd();
+    __m512d Du = _mm512_setzero_pd(), Dv = _mm512_setzero_pd();
+    for (i = 0; i < 4; i++) {
+        Au = _mm512_fmadd_pd(_mm512_set1_pd(ai_[i]), u[i], Au);
+        Av = _mm512_fmadd_pd(_mm512_set1_pd(ai_[i]), v[i], Av);
+        Bu = _mm512_fmadd_pd(_mm512_set1_pd(bi_[i]), u[i], Bu);
+        Bv = _mm512_fmadd_pd(_mm512_set1_pd(bi_[i]), v[i], Bv);
+        Cu = _mm512_fmadd_pd(_mm512_set1_pd(ci_[i]), u[i], Cu);
+        Cv = _mm512_fmadd_pd(_mm512_set1_pd(ci_[i]), v[i], Cv);
+        Du = _mm512_fmadd_pd(_mm512_set1_pd(di_[i]), u[i], Du);
+        Dv = _mm512_fmadd_pd(_mm512_set1_pd(di_[i]), v[i], Dv);
+    }
+
+    // a_N, b_N, r_N と節点速度の内積
+    __m512d aNy_u, aNy_v, bNy_u, bNy_v, rNy_u, rNy_v;
+    __m512d aNx_u, aNx_v, bNx_u, bNx_v, rNx_u, rNx_v;
+    dot8(&a_Ny_[4*e], u, v, aNy_u, aNy_v);
+    dot8(&b_Ny_[4*e], u, v, bNy_u, bNy_v);
+    dot8(&r_Ny_[4*e], u, v, rNy_u, rNy_v);
+    dot8(&a_Nx_[4*e], u, v, aNx_u, aNx_v);
+    dot8(&b_Nx_[4*e], u, v, bNx_u, bNx_v);
+    dot8(&r_Nx_[4*e], u, v, rNx_u, rNx_v);
+
+    __m512d hx[4], hy[4];
+    if (storage_ == STORAGE_LEAN) {
+        // Hx = a_Ny/2, Hy = -a_Nx/2
+        load8x4T(&a_Ny_[4*e], 4, hx);
+        load8x4T(&a_Nx_[4*e], 4, hy);
+        for (i = 0; i < 4; i++) {
+            hx[i] = _mm512_mul_pd(_mm512_set1_pd(0.5), hx[i]);
+            hy[i] = _mm512_mul_pd(_mm512_set1_pd(-0.5), hy[i]);
+        }
+    } else {
+        load8x4T(&hx_[4*e], 4, hx);
+        load8x4T(&hy_[4*e], 4, hy);
+    }
+    __m512d p = _mm512_load_pd(&p_[e]);
+    const __m512d one_18th = _mm512_set1_pd(1.0/18.0);
+    const __m512d three = _mm512_set1_pd(3.0);
+    const __m512d nine = _mm512_set1_pd(9.0);
+
+    alignas(64) double d_u[4][8], d_v[4][8];
+    for (i = 0; i < 4; i++) {
+        __m512d a = _mm512_set1_pd(ai_[i]);
+        __m512d b = _mm512_set1_pd(bi_[i]);
+        __m512d c = _mm512_set1_pd(ci_[i]);
+        __m512d d = _mm512_set1_pd(di_[i]);
+        // ka_i(u), kb_i(u), kr_i(u), ka_i(v), kb_i(v), kr_i(v)
+        __m512d ka_u = _mm512_fmadd_pd(_mm512_mul_pd(nine, a), Au,
+                _mm512_fmadd_pd(three, _mm512_fmadd_pd(b, Bu, _mm512_mul_pd(c, Cu)), _mm512_mul_pd(d, Du)));
+        __m512d kb_u = _mm512_fmadd_pd(three, _mm512_fmadd_pd(a, Bu, _mm512_mul_pd(b, Au)),
+                _mm512_fmadd_pd(d, Cu, _mm512_mul_pd(c, Du)));
+        __m512d kr_u = _mm512_fmadd_pd(three, _mm512_fmadd_pd(a, Cu, _mm512_mul_pd(c, Au)),
+                _mm512_fmadd_pd(d, Bu, _mm512_mul_pd(b, Du)));
+        __m512d ka_v = _mm512_fmadd_pd(_mm512_mul_pd(nine, a), Av,
+                _mm512_fmadd_pd(three, _mm512_fmadd_pd(b, Bv, _mm512_mul_pd(c, Cv)), _mm512_mul_pd(d, Dv)));
+        __m512d kb_v = _mm512_fmadd_pd(three, _mm512_fmadd_pd(a, Bv, _mm512_mul_pd(b, Av)),
+                _mm512_fmadd_pd(d, Cv, _mm512_mul_pd(c, Dv)));
+        __m512d kr_v = _mm512_fmadd_pd(three, _mm512_fmadd_pd(a, Cv, _mm512_mul_pd(c, Av)),
+                _mm512_fmadd_pd(d, Bv, _mm512_mul_pd(b, Dv)));
+
+        // 移流項 (A*u)_i, (A*v)_i
+        __m512d Au_i = _mm512_mul_pd(one_18th, _mm512_sub_pd(
+                _mm512_fmadd_pd(ka_u, aNy_u, _mm512_fmadd_pd(kb_u, bNy_u, _mm512_mul_pd(kr_u, rNy_u))),
+                _mm512_fmadd_pd(ka_v, aNx_u, _mm512_fmadd_pd(kb_v, bNx_u, _mm512_mul_pd(kr_v, rNx_u)))));
+        __m512d Av_i = _mm512_mul_pd(one_18th, _mm512_sub_pd(
+                _mm512_fmadd_pd(ka_u, aNy_v, _mm512_fmadd_pd(kb_u, bNy_v, _mm512_mul_pd(kr_u, rNy_v))),
+                _mm512_fmadd_pd(ka_v, aNx_v, _mm512_fmadd_pd(kb_v, bNx_v, _mm512_mul_pd(kr_v, rNx_v)))));
+
+        // - Fx, - Fy 外力
+        __m512d su = _mm512_fnmadd_pd(hx[i], p, Au_i);
+        __m512d sv = _mm512_fnmadd_pd(hy[i], p, Av_i);
+
+        // 拡散項 (行列の行i)
+        __m512d diff[4];
+        load8x4T(&d_[16*e + 4*i], 16, diff);
+        for (j = 0; j < 4; j++) {
+            su = _mm512_fmadd_pd(diff[j], u[j], su);
+            sv = _mm512_fmadd_pd(diff[j], v[j], sv);
+        }
+        __m512d delta_t_by_m = gather8(&nodes.delta_t_by_m_[0], idx[i]);
+        _mm512_store_pd(d_u[i], _mm512_mul_pd(delta_t_by_m, su));
+        _mm512_store_pd(d_v[i], _mm512_mul_pd(delta_t_by_m, sv));
+    }
+
+    // 節点への加算は要素番号順に1要素ずつ行う
+    for (k = 0; k < 8; k++) {
+        for (i = 0; i < 4; i++) {
+            addVelocityDelta(nodes, e + k, i, -d_u[i][k], -d_v[i][k]);
+        }
+    }
+}
+
+/*
+ * 判別式と速度補正 (AVX-512, 要素 e～e+7)
+ */
+template <class Real>
+TARGET_AVX512
+bool ElementBlock::calcDivergenceAndCorrectAvx512(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+        size_t e, double epsilon) {
+    int i, k;
+    __m256i idx[4];
+    __m512d u[4], v[4];
+    __m512d hx_by_a[4], hy_by_a[4];
+    loadIndex8x4T(&nodes_[4*e], idx);
+    gatherVelocity8(nodes.vel_, idx, u, v);
+    load8x4T(&corr.hx_by_a_[4*e], 4, hx_by_a);
+    load8x4T(&corr.hy_by_a_[4*e], 4, hy_by_a);
+
+    __m512d D = _mm512_setzero_pd();
+    for (i = 0; i < 4; i++) {
+        D = _mm512_fmadd_pd(hx_by_a[i], u[i], D);
+        D = _mm512_fmadd_pd(hy_by_a[i], v[i], D);
+    }
+    _mm512_store_pd(&D_[e], D);
+
+    __mmask8 mask = _mm512_cmp_pd_mask(_mm512_abs_pd(D), _mm512_set1_pd(epsilon), _CMP_GT_OQ);
+    if (mask == 0) {
+        return false;
+    }
+    for (k = 0; k < 8; k++) {
+        if (mask & (1 << k)) {
+            correctVelocity(corr, nodes, e + k);
+        }
+    }
+    return true;
+}
+
+/*
+ * 移流項テンソルを使う速度予測 (AVX2, 要素eの1要素分)
+ * 移流項行列の列jを i 方向の4成分ベクトルとして作り、
+ * d_u = - hx*p + sum_j (A_:j + d_:j) * u_j を計算する。拡散項行列は対称なので行jを列jとして使う。
+ */
+TARGET_AVX2
+void ElementBlock::calcVelocityPredictionTensorAvx2(NodeBlock &nodes, size_t e) {
+    int i, j, k;
+    const int32_t *n = &nodes_[4*e];
+    const double *Tu = &conv_[128*e];
+    const double *Tv = &conv_[128*e + 64];
+    const double *d = &d_[16*e];
+    double u[4], v[4];
+    for (i = 0; i < 4; i++) {
+        u[i] = nodes.vel_[n[i]].x_;
+        v[i] = nodes.vel_[n[i]].y_;
+    }
+
+    __m256d p = _mm256_set1_pd(p_[e]);
+    __m256d hx, hy;
+    if (storage_ == STORAGE_LEAN) {
+        hx = _mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_load_pd(&a_Ny_[4*e]));
+        hy = _mm256_mul_pd(_mm256_set1_pd(-0.5), _mm256_load_pd(&a_Nx_[4*e]));
+    } else {
+        hx = _mm256_load_pd(&hx_[4*e]);
+        hy = _mm256_load_pd(&hy_[4*e]);
+    }
+    __m256d su = _mm256_sub_pd(_mm256_setzero_pd(), _mm256_mul_pd(hx, p));
+    __m256d sv = _mm256_sub_pd(_mm256_setzero_pd(), _mm256_mul_pd(hy, p));
+    for (j = 0; j < 4; j++) {
+        __m256d col = _mm256_load_pd(d + 4*j);
+        for (k = 0; k < 4; k++) {
+            col = _mm256_fmadd_pd(_mm256_load_pd(Tu + 16*k + 4*j), _mm256_set1_pd(u[k]), col);
+            col = _mm256_fmadd_pd(_mm256_load_pd(Tv + 16*k + 4*j), _mm256_set1_pd(v[k]), col);
+        }
+        su = _mm256_fmadd_pd(col, _mm256_set1_pd(u[j]), su);
+        sv = _mm256_fmadd_pd(col, _mm256_set1_pd(v[j]), sv);
+    }
+    const double *delta_t_by_m = &nodes.delta_t_by_m_[0];
+    __m256d dtm = _mm256_setr_pd(delta_t_by_m[n[0]], delta_t_by_m[n[1]], delta_t_by_m[n[2]], delta_t_by_m[n[3]]);
+    alignas(32) double d_u[4], d_v[4];
+    _mm256_store_pd(d_u, _mm256_mul_pd(dtm, su));
+    _mm256_store_pd(d_v, _mm256_mul_pd(dtm, sv));
+    for (i = 0; i < 4; i++) {
+        addVelocityDelta(nodes, e, i, -d_u[i], -d_v[i]);
+    }
+}
+
+/*
+ * 判別式と速度補正 (STORAGE_LEAN, AVX2, 要素 e～e+3)
+ * D = sum_i (a_Ny_i*u_i - a_Nx_i*v_i) / (2*size) をレーンごとに計算し、
+ * 閾値を超えた要素だけを correctVelocityLean() で補正する。
+ */
+template <class Real>
+TARGET_AVX2
+bool ElementBlock::calcDivergenceAndCorrectLeanAvx2(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+        size_t e, double epsilon) {
+    int i, k;
+    __m128i idx[4];
+    __m256d u[4], v[4];
+    __m256d a_Ny[4], a_Nx[4];
+    loadIndex4x4T(&nodes_[4*e], idx);
+    gatherVelocity4(nodes.vel_, idx, u, v);
+    load4x4T(&a_Ny_[4*e], 4, a_Ny);
+    load4x4T(&a_Nx_[4*e], 4, a_Nx);
+
+    __m256d s = _mm256_setzero_pd();
+    for (i = 0; i < 4; i++) {
+        s = _mm256_fmadd_pd(a_Ny[i], u[i], s);
+        s = _mm256_fnmadd_pd(a_Nx[i], v[i], s);
+    }
+    __m256d two_size = _mm256_mul_pd(_mm256_set1_pd(2.0), _mm256_load_pd(&size_[e]));
+    __m256d D = _mm256_div_pd(s, two_size);
+
+    __m256d abs_D = _mm256_andnot_pd(_mm256_set1_pd(-0.0), D);
+    int mask = _mm256_movemask_pd(_mm256_cmp_pd(abs_D, _mm256_set1_pd(epsilon), _CMP_GT_OQ));
+    if (mask == 0) {
+        return false;
+    }
+    alignas(32) double D_k[4];
+    _mm256_store_pd(D_k, D);
+    for (k = 0; k < 4; k++) {
+        if (mask & (1 << k)) {
+            correctVelocityLean(corr, nodes, e + k, D_k[k]);
+        }
+    }
+    return true;
+}
+
+/*
+ * 判別式と速度補正 (STORAGE_LEAN, AVX-512, 要素 e～e+7)
+ */
+template <class Real>
+TARGET_AVX512
+bool ElementBlock::calcDivergenceAndCorrectLeanAvx512(const CorrectionInvariants<Real> &corr, NodeBlock &nodes,
+        size_t e, double epsilon) {
+    int i, k;
+    __m256i idx[4];
+    __m512d u[4], v[4];
+    __m512d a_Ny[4], a_Nx[4];
+    loadIndex8x4T(&nodes_[4*e], idx);
+    gatherVelocity8(nodes.vel_, idx, u, v);
+    load8x4T(&a_Ny_[4*e], 4, a_Ny);
+    load8x4T(&a_Nx_[4*e], 4, a_Nx);
+
+    __m512d s = _mm512_setzero_pd();
+    for (i = 0; i < 4; i++) {
+        s = _mm512_fmadd_pd(a_Ny[i], u[i], s);
+        s = _mm512_fnmadd_pd(a_Nx[i], v[i], s);
+    }
+    __m512d two_size = _mm512_mul_pd(_mm512_set1_pd(2.0), _mm512_load_pd(&size_[e]));
+    __m512d D = _mm512_div_pd(s, two_size);
+
+    __mmask8 mask = _mm512_cmp_pd_mask(_mm512_abs_pd(D), _mm512_set1_pd(epsilon), _CMP_GT_OQ);
+    if (mask == 0) {
+        return false;
+    }
+    alignas(64) double D_k[8];
+    _mm512_store_pd(D_k, D);
+    for (k = 0; k < 8; k++) {
+        if (mask & (1 << k)) {
+            correctVelocityLean(corr, nodes, e + k, D_k[k]);
+        }
+    }
+    return true;
+}
+
+// ElementBlock.cpp から両方の精度で呼ぶので実体化しておく
+template bool ElementBlock::calcDivergenceAndCorrectAvx2(const CorrectionInvariants<double> &,
+        NodeBlock &, size_t, double);
+template bool ElementBlock::calcDivergenceAndCorrectAvx2(const CorrectionInvariants<float> &,
+        NodeBlock &, size_t, double);
+template bool ElementBlock::calcDivergenceAndCorrectAvx512(const CorrectionInvariants<double> &,
+        NodeBlock &, size_t, double);
+template bool ElementBlock::calcDivergenceAndCorrectAvx512(const CorrectionInvariants<float> &,
+        NodeBlock &, size_t, double);
+template bool ElementBlock::calcDivergenceAndCorrectLeanAvx2(const CorrectionInvariants<double> &,
+        NodeBlock &, size_t, double);
+template bool ElementBlock::calcDivergenceAndCorrectLeanAvx2(const CorrectionInvariants<float> &,
+        NodeBlock &, size_t, double);
+template bool ElementBlock::calcDivergenceAndCorrectLeanAvx512(const CorrectionInvariants<double> &,
+        NodeBlock &, size_t, double);
+template bool ElementBlock::calcDivergenceAndCorrectLeanAvx512(const CorrectionInvariants<float> &,
+        NodeBlock &, size_t, double);
+
+#endif /* ELEMENTBLOCK_X86_SIMD */
@@ -58,6 +58,22 @@ void FileReader::readLine() {
     cur_line_.clear();
 }
 
+bool FileReader::readNextLine() {
+    std::string line_buf;
+    while (std::getline(in_, line_buf)) {
+        line_no_++;
+        // 空白だけの行は読み飛ばす
+        if (line_buf.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        cur_line_.str(line_buf);
+        cur_line_.clear();
+        return true;
+    }
+    // ファイルの終わり
+    return false;
+}
+
 void FileReader::readLabeledDoubleLine(const char *label, double &val) {
     // ファイルを一行読む
     readLine();
@@ -154,6 +170,13 @@ void FileReader::readExpectedInt(int expected_val, const char *label) {
     }
 }
 
+void FileReader::throwUnexpectedWord(const std::string &word, const char *label) {
+    std::stringstream msg;
+    msg << "Unexpected " << label << " '" << word << "' was found at ";
+    addFileNameAndLineNoTo(msg);
+    throw DataException(__FILE__, __LINE__, msg.str());
+}
+
 void FileReader::addFileNameAndLineNoTo(std::stringstream &ss) {
     // 読み込み中のファイル名と行番号をエラーメッセージを組み立てているストリームに追加する。
     ss << "'" << file_name_ << "', line " << line_no_;
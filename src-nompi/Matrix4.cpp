@@ -3,15 +3,7 @@
  */
 #include <Matrix4.h>
 #include <Vector4.h>
-#include <vector>
 
-Matrix4::~Matrix4(){}
-Matrix4::Matrix4(){
-    val_.resize(16, 0.0);
-}
-Matrix4::Matrix4(const Matrix4 &o){
-    val_ = o.val_;
-}
 void Matrix4::unit(){
     for(size_t i = 0; i < 4; i++){
         for(size_t j = 0; j < 4; j++){
@@ -20,40 +12,6 @@ void Matrix4::unit(){
         }
     }
 }
-void Matrix4::set(int row, int col, double val){
-    val_[row*4 + col] = val;
-}
-void Matrix4::set(int rowcol, double val){
-    val_[rowcol] = val;
-}
-
-double Matrix4::get(int row, int col) const{
-    return val_[row*4 + col];
-}
-double Matrix4::get(int rowcol) const{
-    return val_[rowcol];
-}
-
-Matrix4 &Matrix4::operator=(const Matrix4 &o){
-    val_ = o.val_;
-    return *this;
-}
-
-Matrix4 Matrix4::operator+(const Matrix4 &o) const{
-    Matrix4 result;
-    for(size_t i = 0; i < 16; i++){
-        result.val_[i] = val_[i] + o.val_[i];
-    }
-    return result;
-}
-
-Matrix4 Matrix4::operator-(const Matrix4 &o) const{
-    Matrix4 result;
-    for(size_t i = 0; i < 16; i++){
-        result.val_[i] = val_[i] - o.val_[i];
-    }
-    return result;
-}
 
 Matrix4 Matrix4::operator*(const Matrix4 &o) const{
     Matrix4 result;
@@ -67,26 +25,6 @@ Matrix4 Matrix4::operator*(const Matrix4 &o) const{
     return result;
 }
 
-Vector4 Matrix4::operator*(const Vector4 &o) const{
-    Vector4 result;
-    for(size_t i = 0; i < 4; i++){
-        double val = 0;
-        for(size_t j = 0; j < 4; j++){
-            val += val_[i*4 + j] * o.get(j);
-        }
-        result.set(i,val);
-    }
-    return result;
-}
-
-Matrix4 Matrix4::operator*(double x) const{
-    Matrix4 result;
-    for(size_t i = 0; i < 16; i++){
-        result.val_[i] = val_[i]*x;
-    }
-    return result;
-}
-
 Matrix4 Matrix4::T() const{
     Matrix4 transpose;
     for(size_t i = 0; i < 4; i++){
@@ -109,7 +47,3 @@ Vector4 operator*(const Vector4 &v, const Matrix4 &m){
     }
     return result;
 }
-
-Matrix4 operator*(double x, const Matrix4 &m){
-    return m * x;
-}
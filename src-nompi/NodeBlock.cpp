@@ -0,0 +1,99 @@
+/*
+ * NodeBlock.cpp
+ */
+
+#include <NodeBlock.h>
+#include <cassert>
+
+NodeBlock::NodeBlock() {
+    num_nodes_ = 0;
+    num_threads_ = 1;
+}
+
+void NodeBlock::init(const std::vector<Node *> &nodes) {
+    size_t i;
+    size_t n = nodes.size();
+    num_nodes_ = n;
+
+    pos_.resize(n);
+    for (i = 0; i < n; i++) {
+        pos_[i] = nodes[i]->pos_;
+    }
+    // 質量と速度補正は += で加算されていくので、0に初期化する必要がある。
+    m_.assign(n, 0.0);
+    inv_m_.assign(n, 0.0);
+    delta_t_by_m_.assign(n, 0.0);
+    vel_.assign(n, VectorXY(0., 0.));
+    d_vel_.assign(n, VectorXY(0., 0.));
+}
+
+void NodeBlock::clearMass() {
+    size_t i;
+    for (i = 0; i < num_nodes_; i++) {
+        m_[i] = 0;
+    }
+}
+
+void NodeBlock::calcInvMass() {
+    size_t i;
+    for (i = 0; i < num_nodes_; i++) {
+        assert(m_[i] > 0.0);
+        inv_m_[i] = 1.0 / m_[i];
+    }
+}
+
+void NodeBlock::calcDtByM(double delta_t) {
+    size_t i;
+    for (i = 0; i < num_nodes_; i++) {
+        delta_t_by_m_[i] = delta_t * inv_m_[i];
+    }
+}
+
+void NodeBlock::clearVelocity() {
+    size_t i;
+    for (i = 0; i < num_nodes_; i++) {
+        vel_[i].set(0., 0.);
+        d_vel_[i].set(0., 0.);
+    }
+}
+
+void NodeBlock::clearVelocityDelta() {
+    long i;
+    const long n = num_nodes_;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1)
+#endif
+    for (i = 0; i < n; i++) {
+        d_vel_[i].set(0., 0.);
+    }
+}
+
+void NodeBlock::applyVelocityDeltaAndClear() {
+    long i;
+    const long n = num_nodes_;
+    if (!moved_.empty()) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1)
+#endif
+        for (i = 0; i < n; i++) {
+            if (d_vel_[i].x_ != 0. || d_vel_[i].y_ != 0.) {
+                moved_[i] = 1;
+            }
+        }
+    }
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1)
+#endif
+    for (i = 0; i < n; i++) {
+        // 変化量の適用
+        vel_[i].x_ += d_vel_[i].x_;
+        vel_[i].y_ += d_vel_[i].y_;
+        d_vel_[i].set(0., 0.);
+    }
+}
+
+size_t NodeBlock::memoryBytes() const {
+    return (pos_.capacity() + vel_.capacity() + d_vel_.capacity()) * sizeof(VectorXY)
+            + (m_.capacity() + inv_m_.capacity() + delta_t_by_m_.capacity()) * sizeof(double)
+            + moved_.capacity() * sizeof(uint8_t);
+}
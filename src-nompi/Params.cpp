@@ -41,6 +41,153 @@ void Params::init(int np, int rank, const char *filename) {
     rdr.readLabeledStringLine("outfile", output_file_name_);
     rdr.readLabeledStringLine("tmpfile", temporal_file_name_);
 
+    // 省略可能な設定。既定値を入れてから、残りの行を順不同で読む。
+    convection_ = "recompute";
+    precision_ = "double";
+    storage_ = "full";
+    renumber_ = "none";
+    assembly_ = "scatter";
+    threads_ = 1;
+    thread_chunk_ = 512;
+    thread_schedule_ = "dynamic";
+    halo_overlap_ = "off";
+    halo_exchange_ = "isend";
+    convergence_check_ = "blocking";
+    convergence_interval_ = 1;
+    correction_async_ = "off";
+    correction_order_ = "jacobi";
+    active_set_ = "off";
+    active_set_recheck_ = 16;
+    relaxation_adaptive_ = "off";
+    correction_acceleration_ = "off";
+    anderson_depth_ = 5;
+    correction_solver_ = "abmac";
+    pcg_preconditioner_ = "jacobi";
+    std::string label;
+    while (rdr.readNextLine()) {
+        rdr.readString(label, "label");
+        if (label == "convection") {
+            rdr.readString(convection_, "convection");
+            if (convection_ != "precomputed" && convection_ != "recompute") {
+                rdr.throwUnexpectedWord(convection_, "convection");
+            }
+        } else if (label == "precision") {
+            rdr.readString(precision_, "precision");
+            if (precision_ != "double" && precision_ != "mixed") {
+                rdr.throwUnexpectedWord(precision_, "precision");
+            }
+        } else if (label == "storage") {
+            rdr.readString(storage_, "storage");
+            if (storage_ != "full" && storage_ != "lean") {
+                rdr.throwUnexpectedWord(storage_, "storage");
+            }
+        } else if (label == "renumber") {
+            rdr.readString(renumber_, "renumber");
+            if (renumber_ != "none" && renumber_ != "rcm" && renumber_ != "hilbert") {
+                rdr.throwUnexpectedWord(renumber_, "renumber");
+            }
+        } else if (label == "assembly") {
+            rdr.readString(assembly_, "assembly");
+            if (assembly_ != "scatter" && assembly_ != "gather") {
+                rdr.throwUnexpectedWord(assembly_, "assembly");
+            }
+        } else if (label == "threads") {
+            rdr.readInt(threads_, "threads");
+            if (threads_ < 1) {
+                std::ostringstream word;
+                word << threads_;
+                rdr.throwUnexpectedWord(word.str(), "threads");
+            }
+        } else if (label == "thread_chunk") {
+            rdr.readInt(thread_chunk_, "thread_chunk");
+            if (thread_chunk_ < 1) {
+                std::ostringstream word;
+                word << thread_chunk_;
+                rdr.throwUnexpectedWord(word.str(), "thread_chunk");
+            }
+        } else if (label == "thread_schedule") {
+            rdr.readString(thread_schedule_, "thread_schedule");
+            if (thread_schedule_ != "dynamic" && thread_schedule_ != "stealing") {
+                rdr.throwUnexpectedWord(thread_schedule_, "thread_schedule");
+            }
+        } else if (label == "halo_overlap") {
+            rdr.readString(halo_overlap_, "halo_overlap");
+            if (halo_overlap_ != "off" && halo_overlap_ != "on") {
+                rdr.throwUnexpectedWord(halo_overlap_, "halo_overlap");
+            }
+        } else if (label == "halo_exchange") {
+            rdr.readString(halo_exchange_, "halo_exchange");
+            if (halo_exchange_ != "isend" && halo_exchange_ != "persistent" && halo_exchange_ != "neighbor"
+                    && halo_exchange_ != "shared") {
+                rdr.throwUnexpectedWord(halo_exchange_, "halo_exchange");
+            }
+        } else if (label == "convergence_check") {
+            rdr.readString(convergence_check_, "convergence_check");
+            if (convergence_check_ != "blocking" && convergence_check_ != "pipelined"
+                    && convergence_check_ != "piggyback") {
+                rdr.throwUnexpectedWord(convergence_check_, "convergence_check");
+            }
+        } else if (label == "convergence_interval") {
+            rdr.readInt(convergence_interval_, "convergence_interval");
+            if (convergence_interval_ < 1) {
+                std::ostringstream word;
+                word << convergence_interval_;
+                rdr.throwUnexpectedWord(word.str(), "convergence_interval");
+            }
+        } else if (label == "correction_async") {
+            rdr.readString(correction_async_, "correction_async");
+            if (correction_async_ != "off" && correction_async_ != "on") {
+                rdr.throwUnexpectedWord(correction_async_, "correction_async");
+            }
+        } else if (label == "correction_order") {
+            rdr.readString(correction_order_, "correction_order");
+            if (correction_order_ != "jacobi" && correction_order_ != "multicolor") {
+                rdr.throwUnexpectedWord(correction_order_, "correction_order");
+            }
+        } else if (label == "active_set") {
+            rdr.readString(active_set_, "active_set");
+            if (active_set_ != "off" && active_set_ != "on") {
+                rdr.throwUnexpectedWord(active_set_, "active_set");
+            }
+        } else if (label == "active_set_recheck") {
+            rdr.readInt(active_set_recheck_, "active_set_recheck");
+            if (active_set_recheck_ < 1) {
+                std::ostringstream word;
+                word << active_set_recheck_;
+                rdr.throwUnexpectedWord(word.str(), "active_set_recheck");
+            }
+        } else if (label == "relaxation_adaptive") {
+            rdr.readString(relaxation_adaptive_, "relaxation_adaptive");
+            if (relaxation_adaptive_ != "off" && relaxation_adaptive_ != "on") {
+                rdr.throwUnexpectedWord(relaxation_adaptive_, "relaxation_adaptive");
+            }
+        } else if (label == "correction_acceleration") {
+            rdr.readString(correction_acceleration_, "correction_acceleration");
+            if (correction_acceleration_ != "off" && correction_acceleration_ != "anderson") {
+                rdr.throwUnexpectedWord(correction_acceleration_, "correction_acceleration");
+            }
+        } else if (label == "anderson_depth") {
+            rdr.readInt(anderson_depth_, "anderson_depth");
+            if (anderson_depth_ < 1) {
+                std::ostringstream word;
+                word << anderson_depth_;
+                rdr.throwUnexpectedWord(word.str(), "anderson_depth");
+            }
+        } else if (label == "correction_solver") {
+            rdr.readString(correction_solver_, "correction_solver");
+            if (correction_solver_ != "abmac" && correction_solver_ != "pcg") {
+                rdr.throwUnexpectedWord(correction_solver_, "correction_solver");
+            }
+        } else if (label == "pcg_preconditioner") {
+            rdr.readString(pcg_preconditioner_, "pcg_preconditioner");
+            if (pcg_preconditioner_ != "jacobi" && pcg_preconditioner_ != "ilu") {
+                rdr.throwUnexpectedWord(pcg_preconditioner_, "pcg_preconditioner");
+            }
+        } else {
+            rdr.throwUnexpectedWord(label, "label");
+        }
+    }
+
     // ファイルをクローズする
     rdr.close();
 }
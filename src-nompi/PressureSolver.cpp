@@ -0,0 +1,334 @@
+/*
+ * PressureSolver.cpp
+ */
+
+#include <PressureSolver.h>
+#include <algorithm>
+#include <utility>
+
+// ILU(0) のピボットがこの割合 x 元の対角成分以下なら、元の対角成分に置き換える。
+// K は半正定値なので、不完全分解ではピボットが0や負になることがある
+static const double PIVOT_MIN = 1.0e-8;
+
+// 組み立て中の行の成分 (列番号, 値)
+typedef std::pair<int32_t, double> Entry;
+
+static bool entryColumnLess(const Entry &a, const Entry &b) {
+    return a.first < b.first;
+}
+
+PressureSolver::PressureSolver() {
+    n_ = 0;
+    num_threads_ = 1;
+    preconditioner_ = PRECONDITIONER_JACOBI;
+    pivot_fixes_ = 0;
+    num_fixed_elements_ = 0;
+    rz_ = 0;
+    have_direction_ = false;
+}
+
+void PressureSolver::assemble(const ElementBlock &elements, const NodeBlock &nodes, const std::vector<uint8_t> &fixed,
+        const std::vector<int32_t> &interface_nodes, Preconditioner preconditioner, int num_threads) {
+    size_t e, s, j;
+    int i;
+    n_ = elements.num_elements_;
+    num_threads_ = num_threads;
+    preconditioner_ = preconditioner;
+
+    // Hx = a_Ny/2, Hy = -a_Nx/2 (1/2 倍は丸め誤差を生じないので ElementBlock の hx_, hy_ と同じ値)
+    const AlignedDoubleArray &a_Ny = elements.a_Ny_;
+    const AlignedDoubleArray &a_Nx = elements.a_Nx_;
+
+    // 局所行列。行eの成分を、要素eの節点kを持つ自プロセスの要素fごとに集め、列番号順に足し合わせる
+    row_begin_.assign(n_ + 1, 0);
+    cols_.clear();
+    vals_.clear();
+    diag_pos_.assign(n_, 0);
+    std::vector<Entry> row;
+    for (e = 0; e < n_; e++) {
+        row.clear();
+        row.push_back(Entry((int32_t)e, 0.0));
+        for (i = 0; i < 4; i++) {
+            int32_t k = elements.nodes_[4*e + i];
+            if (fixed[k]) {
+                continue;
+            }
+            double dt_by_m = nodes.delta_t_by_m_[k];
+            double hx = 0.5*a_Ny[4*e + i];
+            double hy = -0.5*a_Nx[4*e + i];
+            for (s = elements.node_slot_begin_[k]; s < elements.node_slot_begin_[k + 1]; s++) {
+                int32_t slot = elements.node_slots_[s];
+                row.push_back(Entry(slot / 4, dt_by_m*(hx*0.5*a_Ny[slot] + hy*(-0.5*a_Nx[slot]))));
+            }
+        }
+        // 同じ列の成分は要素の節点順に足す
+        std::stable_sort(row.begin(), row.end(), entryColumnLess);
+        for (s = 0; s < row.size(); s++) {
+            if (s > 0 && row[s].first == row[s - 1].first) {
+                vals_.back() += row[s].second;
+                continue;
+            }
+            if (row[s].first == (int32_t)e) {
+                diag_pos_[e] = cols_.size();
+            }
+            cols_.push_back(row[s].first);
+            vals_.push_back(row[s].second);
+        }
+        row_begin_[e + 1] = cols_.size();
+    }
+
+    // 対角成分が0の要素は、四隅の節点の速度がすべて境界条件で与えられる
+    inv_diag_.assign(n_, 0.0);
+    num_fixed_elements_ = 0;
+    for (e = 0; e < n_; e++) {
+        double d = vals_[diag_pos_[e]];
+        if (d > 0) {
+            inv_diag_[e] = 1.0 / d;
+        } else {
+            num_fixed_elements_++;
+        }
+    }
+
+    // インターフェース行列
+    iface_nodes_.clear();
+    iface_begin_.assign(1, 0);
+    iface_elements_.clear();
+    iface_hx_.clear();
+    iface_hy_.clear();
+    iface_dt_by_m_.clear();
+    for (j = 0; j < interface_nodes.size(); j++) {
+        int32_t k = interface_nodes[j];
+        if (fixed[k]) {
+            continue;
+        }
+        iface_nodes_.push_back(k);
+        iface_dt_by_m_.push_back(nodes.delta_t_by_m_[k]);
+        for (s = elements.node_slot_begin_[k]; s < elements.node_slot_begin_[k + 1]; s++) {
+            int32_t slot = elements.node_slots_[s];
+            iface_elements_.push_back(slot / 4);
+            iface_hx_.push_back(0.5*a_Ny[slot]);
+            iface_hy_.push_back(-0.5*a_Nx[slot]);
+        }
+        iface_begin_.push_back(iface_elements_.size());
+    }
+
+    area_.assign(elements.size_.begin(), elements.size_.end());
+    x_.assign(n_, 0.0);
+    r_.assign(n_, 0.0);
+    z_.assign(n_, 0.0);
+    p_.assign(n_, 0.0);
+    q_.assign(n_, 0.0);
+    rz_ = 0;
+    have_direction_ = false;
+
+    pivot_fixes_ = 0;
+    if (preconditioner_ == PRECONDITIONER_ILU) {
+        factorize();
+    } else {
+        AlignedDoubleArray().swap(lu_);
+    }
+}
+
+/*
+ * 局所行列の ILU(0) 分解 (IKJ 順)。非ゼロの位置は局所行列と同じで、それ以外の fill-in は捨てる。
+ * K が対称なので U = diag(U) L^T となり、ピボットが正なら前処理は対称正定値になる。
+ */
+void PressureSolver::factorize() {
+    size_t i, kk, jj;
+    const size_t none = (size_t)-1;
+    lu_.assign(vals_.begin(), vals_.end());
+    // 行iの列番号 -> lu_ での位置
+    std::vector<size_t> pos(n_, none);
+    for (i = 0; i < n_; i++) {
+        for (jj = row_begin_[i]; jj < row_begin_[i + 1]; jj++) {
+            pos[cols_[jj]] = jj;
+        }
+        for (kk = row_begin_[i]; kk < diag_pos_[i]; kk++) {
+            size_t k = cols_[kk];
+            lu_[kk] /= lu_[diag_pos_[k]];
+            for (jj = diag_pos_[k] + 1; jj < row_begin_[k + 1]; jj++) {
+                size_t p = pos[cols_[jj]];
+                if (p != none) {
+                    lu_[p] -= lu_[kk] * lu_[jj];
+                }
+            }
+        }
+        double d = vals_[diag_pos_[i]];
+        if (!(lu_[diag_pos_[i]] > PIVOT_MIN * d)) {
+            // 方程式から外した要素の行と列は0なので、ピボットは何でもよい
+            if (d > 0) {
+                pivot_fixes_++;
+                lu_[diag_pos_[i]] = d;
+            } else {
+                lu_[diag_pos_[i]] = 1.0;
+            }
+        }
+        for (jj = row_begin_[i]; jj < row_begin_[i + 1]; jj++) {
+            pos[cols_[jj]] = none;
+        }
+    }
+}
+
+void PressureSolver::precondition(double epsilon, double *dots) {
+    long e;
+    const long n = n_;
+    if (preconditioner_ == PRECONDITIONER_ILU) {
+        size_t jj;
+        // 前進代入 (L の対角は1)
+        for (e = 0; e < n; e++) {
+            double s = r_[e];
+            for (jj = row_begin_[e]; jj < diag_pos_[e]; jj++) {
+                s -= lu_[jj] * z_[cols_[jj]];
+            }
+            z_[e] = s;
+        }
+        // 後退代入
+        for (e = n - 1; e >= 0; e--) {
+            double s = z_[e];
+            for (jj = diag_pos_[e] + 1; jj < row_begin_[e + 1]; jj++) {
+                s -= lu_[jj] * z_[cols_[jj]];
+            }
+            z_[e] = s / lu_[diag_pos_[e]];
+        }
+    }
+    double rz = 0;
+    double exceeds = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1) reduction(+:rz,exceeds)
+#endif
+    for (e = 0; e < n; e++) {
+        if (preconditioner_ == PRECONDITIONER_JACOBI) {
+            z_[e] = inv_diag_[e] * r_[e];
+        }
+        rz += r_[e] * z_[e];
+        // 判別式 D = -r/A
+        double limit = epsilon * area_[e];
+        if (r_[e] > limit || r_[e] < (-limit)) {
+            exceeds += 1;
+        }
+    }
+    dots[0] = rz;
+    dots[1] = exceeds;
+}
+
+void PressureSolver::begin(const ElementBlock &elements, const NodeBlock &nodes, double epsilon, double *dots) {
+    long e;
+    const long n = n_;
+    const AlignedDoubleArray &a_Ny = elements.a_Ny_;
+    const AlignedDoubleArray &a_Nx = elements.a_Nx_;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1)
+#endif
+    for (e = 0; e < n; e++) {
+        x_[e] = 0;
+        if (inv_diag_[e] == 0) {
+            r_[e] = 0;
+            continue;
+        }
+        double s = 0;
+        for (int i = 0; i < 4; i++) {
+            const VectorXY &vel = nodes.vel_[elements.nodes_[4*e + i]];
+            s += 0.5*a_Ny[4*e + i]*vel.x_ - 0.5*a_Nx[4*e + i]*vel.y_;
+        }
+        r_[e] = -s;
+    }
+    have_direction_ = false;
+    precondition(epsilon, dots);
+}
+
+void PressureSolver::nextDirection(const double *dots) {
+    long e;
+    const long n = n_;
+    double rz = dots[0];
+    double beta = have_direction_ ? rz / rz_ : 0.0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1)
+#endif
+    for (e = 0; e < n; e++) {
+        p_[e] = z_[e] + beta * p_[e];
+    }
+    rz_ = rz;
+    have_direction_ = true;
+}
+
+void PressureSolver::scatterInterface(NodeBlock &nodes) const {
+    size_t j, s;
+    for (j = 0; j < iface_nodes_.size(); j++) {
+        double wx = 0, wy = 0;
+        for (s = iface_begin_[j]; s < iface_begin_[j + 1]; s++) {
+            double p = p_[iface_elements_[s]];
+            wx += iface_hx_[s] * p;
+            wy += iface_hy_[s] * p;
+        }
+        VectorXY &d_vel = nodes.d_vel_[iface_nodes_[j]];
+        d_vel.x_ = iface_dt_by_m_[j] * wx;
+        d_vel.y_ = iface_dt_by_m_[j] * wy;
+    }
+}
+
+void PressureSolver::multiplyLocal(NodeBlock &nodes) {
+    long e;
+    const long n = n_;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1)
+#endif
+    for (e = 0; e < n; e++) {
+        double s = 0;
+        for (size_t jj = row_begin_[e]; jj < row_begin_[e + 1]; jj++) {
+            s += vals_[jj] * p_[cols_[jj]];
+        }
+        q_[e] = s;
+    }
+    for (size_t j = 0; j < iface_nodes_.size(); j++) {
+        nodes.d_vel_[iface_nodes_[j]].set(0., 0.);
+    }
+}
+
+void PressureSolver::multiplyInterface(NodeBlock &nodes, double *dots) {
+    size_t j, s;
+    long e;
+    const long n = n_;
+    for (j = 0; j < iface_nodes_.size(); j++) {
+        VectorXY &d_vel = nodes.d_vel_[iface_nodes_[j]];
+        for (s = iface_begin_[j]; s < iface_begin_[j + 1]; s++) {
+            q_[iface_elements_[s]] += iface_hx_[s] * d_vel.x_ + iface_hy_[s] * d_vel.y_;
+        }
+        d_vel.set(0., 0.);
+    }
+    double pq = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1) reduction(+:pq)
+#endif
+    for (e = 0; e < n; e++) {
+        pq += p_[e] * q_[e];
+    }
+    dots[0] = pq;
+}
+
+bool PressureSolver::update(const double *dots, double epsilon, double *next) {
+    long e;
+    const long n = n_;
+    double pq = dots[0];
+    if (!(pq > 0) || !(rz_ > 0)) {
+        return false;
+    }
+    double alpha = rz_ / pq;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads_) if(num_threads_ > 1)
+#endif
+    for (e = 0; e < n; e++) {
+        x_[e] += alpha * p_[e];
+        r_[e] -= alpha * q_[e];
+    }
+    precondition(epsilon, next);
+    return true;
+}
+
+size_t PressureSolver::memoryBytes() const {
+    size_t bytes = (row_begin_.capacity() + diag_pos_.capacity() + iface_begin_.capacity()) * sizeof(size_t);
+    bytes += (cols_.capacity() + iface_nodes_.capacity() + iface_elements_.capacity()) * sizeof(int32_t);
+    bytes += (vals_.capacity() + inv_diag_.capacity() + lu_.capacity() + iface_hx_.capacity()
+            + iface_hy_.capacity() + iface_dt_by_m_.capacity() + area_.capacity() + x_.capacity()
+            + r_.capacity() + z_.capacity() + p_.capacity() + q_.capacity()) * sizeof(double);
+    return bytes;
+}
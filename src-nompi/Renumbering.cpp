@@ -0,0 +1,295 @@
+/*
+ * Renumbering.cpp
+ */
+
+#include <Renumbering.h>
+#include <algorithm>
+#include <list>
+#include <cstdlib>
+
+namespace {
+
+// 節点の隣接リスト。同じ要素に属する節点どうしを隣接しているとみなす。
+void makeAdjacency(size_t num_nodes, const std::vector<int32_t> &elem_nodes,
+        std::vector<std::vector<int32_t> > &adj) {
+    size_t e;
+    int i, j;
+    adj.assign(num_nodes, std::vector<int32_t>());
+    for (e = 0; e < elem_nodes.size() / 4; e++) {
+        for (i = 0; i < 4; i++) {
+            for (j = 0; j < 4; j++) {
+                if (i != j) {
+                    adj[elem_nodes[4*e + i]].push_back(elem_nodes[4*e + j]);
+                }
+            }
+        }
+    }
+    for (size_t k = 0; k < num_nodes; k++) {
+        std::sort(adj[k].begin(), adj[k].end());
+        adj[k].erase(std::unique(adj[k].begin(), adj[k].end()), adj[k].end());
+    }
+}
+
+// 次数の小さい順 (同じなら番号順) に並べるための比較
+class ByDegree {
+    const std::vector<std::vector<int32_t> > &adj_;
+public:
+    explicit ByDegree(const std::vector<std::vector<int32_t> > &adj) : adj_(adj) {}
+    bool operator()(int32_t a, int32_t b) const {
+        if (adj_[a].size() != adj_[b].size()) {
+            return adj_[a].size() < adj_[b].size();
+        }
+        return a < b;
+    }
+};
+
+// start から幅優先探索し、最後の段の節点のうち次数が最小のものを返す。
+// depth には最後の段の深さを返す。level は全て -1 で渡し、-1 に戻して返す。
+int32_t farthestNode(const std::vector<std::vector<int32_t> > &adj, int32_t start,
+        std::vector<int> &level, int &depth) {
+    std::vector<int32_t> queue;
+    size_t head = 0;
+    queue.push_back(start);
+    level[start] = 0;
+    while (head < queue.size()) {
+        int32_t v = queue[head++];
+        for (size_t k = 0; k < adj[v].size(); k++) {
+            int32_t w = adj[v][k];
+            if (level[w] < 0) {
+                level[w] = level[v] + 1;
+                queue.push_back(w);
+            }
+        }
+    }
+    depth = level[queue.back()];
+    int32_t best = queue.back();
+    for (size_t k = 0; k < queue.size(); k++) {
+        int32_t v = queue[k];
+        if (level[v] == depth && ByDegree(adj)(v, best)) {
+            best = v;
+        }
+    }
+    for (size_t k = 0; k < queue.size(); k++) {
+        level[queue[k]] = -1;
+    }
+    return best;
+}
+
+// (x, y) in [0, n)^2 の Hilbert 曲線上の位置。n は2のべき乗。
+uint64_t hilbertIndex(uint32_t n, uint32_t x, uint32_t y) {
+    uint64_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += (uint64_t)s * s * ((3 * rx) ^ ry);
+        // 部分正方形の向きに合わせて回転する
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+// key の小さい順 (同じなら元の番号順) の並び順を返す
+template <class Key>
+std::vector<int32_t> sortByKey(const std::vector<Key> &key) {
+    std::vector<std::pair<Key, int32_t> > items(key.size());
+    for (size_t k = 0; k < key.size(); k++) {
+        items[k] = std::make_pair(key[k], (int32_t)k);
+    }
+    std::sort(items.begin(), items.end());
+    std::vector<int32_t> order(key.size());
+    for (size_t k = 0; k < key.size(); k++) {
+        order[k] = items[k].second;
+    }
+    return order;
+}
+
+} // namespace
+
+std::vector<int32_t> Renumbering::rcmNodeOrder(size_t num_nodes, const std::vector<int32_t> &elem_nodes) {
+    std::vector<std::vector<int32_t> > adj;
+    makeAdjacency(num_nodes, elem_nodes, adj);
+
+    std::vector<int32_t> candidates(num_nodes);
+    size_t k;
+    for (k = 0; k < num_nodes; k++) {
+        candidates[k] = k;
+    }
+    std::sort(candidates.begin(), candidates.end(), ByDegree(adj));
+
+    std::vector<int32_t> order;
+    order.reserve(num_nodes);
+    std::vector<char> visited(num_nodes, 0);
+    std::vector<int> level(num_nodes, -1);
+    std::vector<int32_t> next;
+    for (k = 0; k < num_nodes; k++) {
+        if (visited[candidates[k]]) {
+            continue;
+        }
+        // 新しい連結成分。次数最小の節点から、最も遠い節点をたどって周辺の節点を探す。
+        int32_t start = candidates[k];
+        int depth, new_depth;
+        int32_t far = farthestNode(adj, start, level, depth);
+        while (far != start) {
+            int32_t far2 = farthestNode(adj, far, level, new_depth);
+            if (new_depth <= depth) {
+                break;
+            }
+            start = far;
+            far = far2;
+            depth = new_depth;
+        }
+
+        // Cuthill-McKee : 幅優先探索で、隣接する未訪問の節点を次数の小さい順に加える
+        size_t head = order.size();
+        order.push_back(start);
+        visited[start] = 1;
+        while (head < order.size()) {
+            int32_t v = order[head++];
+            next.clear();
+            for (size_t j = 0; j < adj[v].size(); j++) {
+                int32_t w = adj[v][j];
+                if (!visited[w]) {
+                    visited[w] = 1;
+                    next.push_back(w);
+                }
+            }
+            std::sort(next.begin(), next.end(), ByDegree(adj));
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+std::vector<int32_t> Renumbering::hilbertElementOrder(const std::vector<int32_t> &elem_nodes,
+        const std::vector<VectorXY> &pos) {
+    size_t num_elements = elem_nodes.size() / 4;
+    size_t e;
+    int i;
+    std::vector<VectorXY> center(num_elements);
+    double x_min = 0, x_max = 0, y_min = 0, y_max = 0;
+    for (e = 0; e < num_elements; e++) {
+        double x = 0, y = 0;
+        for (i = 0; i < 4; i++) {
+            x += 0.25*pos[elem_nodes[4*e + i]].x_;
+            y += 0.25*pos[elem_nodes[4*e + i]].y_;
+        }
+        center[e].set(x, y);
+        if (e == 0 || x < x_min) x_min = x;
+        if (e == 0 || x > x_max) x_max = x;
+        if (e == 0 || y < y_min) y_min = y;
+        if (e == 0 || y > y_max) y_max = y;
+    }
+
+    // 重心を含む正方形を 65536 x 65536 の格子に分けて Hilbert 曲線上の位置を求める
+    const uint32_t n = 65536;
+    double width = std::max(x_max - x_min, y_max - y_min);
+    double scale = width > 0 ? (n - 1) / width : 0;
+    std::vector<uint64_t> key(num_elements);
+    for (e = 0; e < num_elements; e++) {
+        uint32_t x = (uint32_t)((center[e].x_ - x_min) * scale);
+        uint32_t y = (uint32_t)((center[e].y_ - y_min) * scale);
+        key[e] = hilbertIndex(n, std::min(x, n - 1), std::min(y, n - 1));
+    }
+    return sortByKey(key);
+}
+
+std::vector<int32_t> Renumbering::elementOrderByNodes(size_t num_nodes, const std::vector<int32_t> &node_order,
+        const std::vector<int32_t> &elem_nodes) {
+    std::vector<int32_t> new_index = inverse(node_order);
+    size_t num_elements = elem_nodes.size() / 4;
+    std::vector<int32_t> key(num_elements);
+    for (size_t e = 0; e < num_elements; e++) {
+        int32_t m = (int32_t)num_nodes;
+        for (int i = 0; i < 4; i++) {
+            m = std::min(m, new_index[elem_nodes[4*e + i]]);
+        }
+        key[e] = m;
+    }
+    return sortByKey(key);
+}
+
+std::vector<int32_t> Renumbering::nodeOrderByElements(size_t num_nodes, const std::vector<int32_t> &element_order,
+        const std::vector<int32_t> &elem_nodes) {
+    std::vector<int32_t> order;
+    order.reserve(num_nodes);
+    std::vector<char> placed(num_nodes, 0);
+    size_t k;
+    for (k = 0; k < element_order.size(); k++) {
+        const int32_t *n = &elem_nodes[4*element_order[k]];
+        for (int i = 0; i < 4; i++) {
+            if (!placed[n[i]]) {
+                placed[n[i]] = 1;
+                order.push_back(n[i]);
+            }
+        }
+    }
+    for (k = 0; k < num_nodes; k++) {
+        if (!placed[k]) {
+            order.push_back(k);
+        }
+    }
+    return order;
+}
+
+std::vector<int32_t> Renumbering::inverse(const std::vector<int32_t> &order) {
+    std::vector<int32_t> result(order.size());
+    for (size_t k = 0; k < order.size(); k++) {
+        result[order[k]] = k;
+    }
+    return result;
+}
+
+Renumbering::Locality Renumbering::measure(size_t num_nodes, const std::vector<int32_t> &elem_nodes,
+        size_t cache_bytes) {
+    Locality result;
+    size_t num_elements = elem_nodes.size() / 4;
+    size_t e;
+    int i;
+    long total_span = 0;
+    result.bandwidth_ = 0;
+    result.cache_misses_ = 0;
+    result.cache_bytes_ = cache_bytes;
+
+    // LRUキャッシュ。先頭が最後に使ったライン。
+    const size_t line_bytes = 64;
+    const size_t node_bytes = 16;
+    size_t capacity = std::max(cache_bytes / line_bytes, (size_t)1);
+    size_t num_lines = (num_nodes * node_bytes + line_bytes - 1) / line_bytes;
+    std::list<size_t> lru;
+    std::vector<std::list<size_t>::iterator> where(num_lines);
+    std::vector<char> cached(num_lines, 0);
+
+    for (e = 0; e < num_elements; e++) {
+        const int32_t *n = &elem_nodes[4*e];
+        int32_t lo = n[0], hi = n[0];
+        for (i = 0; i < 4; i++) {
+            lo = std::min(lo, n[i]);
+            hi = std::max(hi, n[i]);
+
+            size_t line = n[i] * node_bytes / line_bytes;
+            if (cached[line]) {
+                lru.splice(lru.begin(), lru, where[line]);
+                continue;
+            }
+            result.cache_misses_++;
+            lru.push_front(line);
+            where[line] = lru.begin();
+            cached[line] = 1;
+            if (lru.size() > capacity) {
+                cached[lru.back()] = 0;
+                lru.pop_back();
+            }
+        }
+        result.bandwidth_ = std::max(result.bandwidth_, hi - lo);
+        total_span += hi - lo;
+    }
+    result.mean_span_ = num_elements > 0 ? (double)total_span / num_elements : 0;
+    return result;
+}
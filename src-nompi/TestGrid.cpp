@@ -0,0 +1,32 @@
+/*
+ * TestGrid.cpp
+ */
+
+#include <TestGrid.h>
+
+void TestGrid::make(int nx, int ny)
+{
+    int i, j;
+    nodes_.assign((nx+1)*(ny+1), Node());
+    elems_.assign(nx*ny, QuadElement());
+    node_list_.clear();
+    elem_list_.clear();
+    for (j = 0; j <= ny; j++) {
+        for (i = 0; i <= nx; i++) {
+            Node &node = nodes_[j*(nx+1) + i];
+            node.pos_.set(i + 0.1*((i*7 + j*3) % 5), j + 0.07*((i*5 + j*11) % 4));
+            node.local_index_ = node_list_.size();
+            node_list_.push_back(&node);
+        }
+    }
+    for (j = 0; j < ny; j++) {
+        for (i = 0; i < nx; i++) {
+            QuadElement &elem = elems_[j*nx + i];
+            elem.nodes_[0] = &nodes_[j*(nx+1) + i];
+            elem.nodes_[1] = &nodes_[j*(nx+1) + i + 1];
+            elem.nodes_[2] = &nodes_[(j+1)*(nx+1) + i + 1];
+            elem.nodes_[3] = &nodes_[(j+1)*(nx+1) + i];
+            elem_list_.push_back(&elem);
+        }
+    }
+}
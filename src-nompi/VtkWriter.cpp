@@ -15,9 +15,12 @@ VtkWriter::~VtkWriter(){
     }
 }
 
-void VtkWriter::init(const std::vector<Node *> my_nodes, const std::vector<QuadElement *> my_elements) {
-    my_nodes_ = my_nodes;
-    my_elements_ = my_elements;
+void VtkWriter::init(const NodeBlock *node_block, const ElementBlock *element_block,
+        const std::vector<int32_t> *node_order, const std::vector<int32_t> *element_order) {
+    node_block_ = node_block;
+    element_block_ = element_block;
+    node_order_ = node_order;
+    element_order_ = element_order;
 }
 
 std::string format_string(const std::string format, ...){
@@ -67,9 +70,10 @@ void VtkWriter::writeHeader() {
 
 void VtkWriter::writePoints() {
     Logger::out << "start VtkWriter::writePoints() in " << file_name_ << std::endl;
-    out_ << "POINTS " << my_nodes_.size() << " double" << std::endl;
-    for(int i = 0; i < my_nodes_.size(); i++){
-        out_ << my_nodes_[i]->pos_.x_ << " " << my_nodes_[i]->pos_.y_ << " 0.0" << std::endl;
+    out_ << "POINTS " << node_block_->num_nodes_ << " double" << std::endl;
+    for(int i = 0; i < node_block_->num_nodes_; i++){
+        const VectorXY &pos = node_block_->pos_[(*node_order_)[i]];
+        out_ << pos.x_ << " " << pos.y_ << " 0.0" << std::endl;
     }
     out_ << std::endl;
     Logger::out << "end VtkWriter::writePoints() in " << file_name_ << std::endl;
@@ -77,18 +81,24 @@ void VtkWriter::writePoints() {
 
 void VtkWriter::writeCells() {
     Logger::out << "start VtkWriter::writeCells() in " << file_name_ << std::endl;
-    out_ << "CELLS " << my_elements_.size() << " " << my_elements_.size()*5 << std::endl;
-    for(int i = 0; i < my_elements_.size(); i++){
+    out_ << "CELLS " << element_block_->num_elements_ << " " << element_block_->num_elements_*5 << std::endl;
+    // ローカルな節点番号から、出力での節点の番号への対応
+    std::vector<int32_t> point_index(node_order_->size());
+    for(size_t k = 0; k < node_order_->size(); k++){
+        point_index[(*node_order_)[k]] = k;
+    }
+    for(int i = 0; i < element_block_->num_elements_; i++){
+        int32_t e = (*element_order_)[i];
         out_ << "4 ";
         for(int j = 0; j < 4; j++){
-            out_ << my_elements_[i]->nodes_[j]->local_index_ << " ";
+            out_ << point_index[element_block_->nodes_[4*e + j]] << " ";
         }
         out_ << std::endl;
     }
     out_ << std::endl;
 
-    out_ << "CELL_TYPES " << my_elements_.size() << std::endl;
-    for(int i = 0; i < my_elements_.size(); i++){
+    out_ << "CELL_TYPES " << element_block_->num_elements_ << std::endl;
+    for(int i = 0; i < element_block_->num_elements_; i++){
         out_ << "9" << std::endl;
     }
     out_ << std::endl;
@@ -97,10 +107,11 @@ void VtkWriter::writeCells() {
 
 void VtkWriter::writeVelocityData() {
     Logger::out << "start VtkWriter::writeVelocityData() in " << file_name_ << std::endl;
-    out_ << "POINT_DATA " << my_nodes_.size() << std::endl;
+    out_ << "POINT_DATA " << node_block_->num_nodes_ << std::endl;
     out_ << "VECTORS velocity double" << std::endl;
-    for(int i = 0; i < my_nodes_.size(); i++){
-        out_ << my_nodes_[i]->vel_.x_ << " " << my_nodes_[i]->vel_.y_ << " 0" << std::endl;
+    for(int i = 0; i < node_block_->num_nodes_; i++){
+        const VectorXY &vel = node_block_->vel_[(*node_order_)[i]];
+        out_ << vel.x_ << " " << vel.y_ << " 0" << std::endl;
     }
     out_ << std::endl;
     Logger::out << "end VtkWriter::writeVelocityData() in " << file_name_ << std::endl;
@@ -108,11 +119,11 @@ void VtkWriter::writeVelocityData() {
 
 void VtkWriter::writePressureData() {
     Logger::out << "start VtkWriter::writePressureData() in " << file_name_ << std::endl;
-    out_ << "CELL_DATA " << my_elements_.size() << std::endl;
+    out_ << "CELL_DATA " << element_block_->num_elements_ << std::endl;
     out_ << "SCALARS pressure double" << std::endl;
     out_ << "LOOKUP_TABLE default" << std::endl;
-    for(int i = 0; i < my_elements_.size(); i++){
-        out_ << my_elements_[i]->p_ << std::endl;
+    for(int i = 0; i < element_block_->num_elements_; i++){
+        out_ << element_block_->p_[(*element_order_)[i]] << std::endl;
     }
     out_ << std::endl;
     Logger::out << "end VtkWriter::writePressureData() in " << file_name_ << std::endl;
@@ -0,0 +1,90 @@
+/*
+ * WorkStealingScheduler.cpp
+ */
+
+#include <WorkStealingScheduler.h>
+#include <chrono>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+WorkStealingScheduler::WorkStealingScheduler() {
+    init(1);
+}
+
+void WorkStealingScheduler::init(int num_threads) {
+    size_t n = num_threads > 1 ? num_threads : 1;
+    std::vector<Queue>(n).swap(queues_);
+    counters_.resize(n);
+    clearCounters();
+}
+
+void WorkStealingScheduler::clearCounters() {
+    for (size_t t = 0; t < counters_.size(); t++) {
+        Counters &counters = counters_[t].counters_;
+        counters.busy_ = 0;
+        counters.idle_ = 0;
+        counters.tasks_ = 0;
+        counters.steals_ = 0;
+    }
+}
+
+int WorkStealingScheduler::threadNum() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+int WorkStealingScheduler::numThreads() {
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+double WorkStealingScheduler::now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void WorkStealingScheduler::fill(int thread, int num_threads, size_t num_tasks) {
+    Queue &queue = queues_[thread];
+    std::lock_guard<std::mutex> guard(queue.lock_);
+    queue.head_ = num_tasks * thread / num_threads;
+    queue.tail_ = num_tasks * (thread + 1) / num_threads;
+}
+
+bool WorkStealingScheduler::pop(int thread, size_t &task) {
+    Queue &queue = queues_[thread];
+    std::lock_guard<std::mutex> guard(queue.lock_);
+    if (queue.head_ >= queue.tail_) {
+        return false;
+    }
+    task = queue.head_++;
+    return true;
+}
+
+bool WorkStealingScheduler::steal(int thread, int num_threads) {
+    // 自分の次のスレッドから順に見る
+    for (int i = 1; i < num_threads; i++) {
+        Queue &victim = queues_[(thread + i) % num_threads];
+        size_t head, tail;
+        {
+            std::lock_guard<std::mutex> guard(victim.lock_);
+            if (victim.head_ >= victim.tail_) {
+                continue;
+            }
+            tail = victim.tail_;
+            head = tail - (tail - victim.head_ + 1) / 2;
+            victim.tail_ = head;
+        }
+        Queue &queue = queues_[thread];
+        std::lock_guard<std::mutex> guard(queue.lock_);
+        queue.head_ = head;
+        queue.tail_ = tail;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,255 @@
+/*
+ * bench_ElementBlock.cpp
+ *
+ * ElementBlockの速度予測・速度補正の計算時間を、命令セットごとに測るプログラム。
+ *
+ * 使い方:
+ *   bench_ElementBlock [nx ny [repeat]]   nx x ny 要素の歪んだ格子で測る
+ *   bench_ElementBlock -c casefile [repeat]  計算条件ファイルのメッシュ全体で測る
+ *
+ * 実行中のCPUで使える命令セット(scalar, avx2, avx512)と移流項の計算方法
+ * (recompute, precomputed)の組み合わせ、速度補正ループのループ不変量を
+ * floatで格納する場合 (mixed)、要素の派生量を配列に持たない場合 (lean)、
+ * 節点への加算を要素の配列を経由して節点ごとに足し込む場合 (gather) について、
+ * 同じ速度場から calcVelocityPrediction() と calcDivergenceAndCorrect() を
+ * repeat 回ずつ実行した時間と、スカラー版との結果の差の最大値を表示する。
+ * check は閾値を大きくして判別式の計算だけを行った時間。
+ * OpenMPを有効にしてコンパイルした場合は、最も幅の広い命令セットで
+ * 2, 4, ... スレッド (CPU数まで) に分担した場合を、色分けしたチャンク単位で分担する方法と
+ * gather の場合、チャンクをワークスティーリングで割り当てる場合 (stealing) について測る。
+ *
+ * -c の場合は計算条件ファイルの省略可能な設定 (renumber など) も反映され、
+ * 読み込みの経過は bench_ElementBlock.log.0.txt に出力される。
+ */
+
+#include <CfdProcData.h>
+#include <ElementBlock.h>
+#include <NodeBlock.h>
+#include <Logger.h>
+#include <TestGrid.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+double elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+class BenchElementBlock {
+
+    // 計算条件ファイルを使う場合に必要なオブジェクト
+    Params params_;
+    State state_;
+    CfdCommData commData_;
+    CfdProcData procData_;
+
+    // 格子の節点・要素 (計算条件ファイルを使わない場合)
+    TestGrid grid_;
+
+    // 計測対象の節点・要素
+    std::vector<Node *> node_list_;
+    std::vector<QuadElement *> elem_list_;
+
+    struct Result {
+        double t_prediction;
+        double t_correction;
+        double t_check;
+        AlignedXYArray d_vel;
+        AlignedDoubleArray p;
+        size_t bytes;
+    };
+
+    Result measure(ElementBlock::SimdIsa isa, bool precompute_convection,
+            ElementBlock::Precision precision, ElementBlock::Storage storage,
+            ElementBlock::Assembly assembly, int threads, int repeat,
+            ElementBlock::Schedule schedule = ElementBlock::SCHEDULE_DYNAMIC);
+    void report(const char *name, const Result &result, const Result &scalar);
+
+public:
+    // nx x ny 要素の歪んだ格子を作る
+    void makeGrid(int nx, int ny);
+    // 計算条件ファイルのメッシュを読み、1プロセスで全体を担当する
+    void readCase(const char *filename);
+    void run(int repeat);
+};
+
+void BenchElementBlock::makeGrid(int nx, int ny) {
+    grid_.make(nx, ny);
+    node_list_ = grid_.node_list_;
+    elem_list_ = grid_.elem_list_;
+}
+
+void BenchElementBlock::readCase(const char *filename) {
+    Logger::openLog("bench_ElementBlock", 0);
+    params_.init(1, 0, filename);
+    state_.reset();
+    commData_.init(&params_, &state_);
+    procData_.init(&params_, &state_, &commData_);
+    procData_.readMeshFile();
+    procData_.findOwnData();
+    node_list_ = procData_.my_nodes_;
+    elem_list_ = procData_.my_elements_;
+}
+
+/*
+ * 1つの命令セットで計測する。
+ * 速度補正は epsilon = 0 として毎回全要素を補正する場合(最も重い場合)と、
+ * 閾値を大きくして判別式の計算だけを行う場合(収束間近の場合)を測る。
+ */
+BenchElementBlock::Result BenchElementBlock::measure(ElementBlock::SimdIsa isa, bool precompute_convection,
+        ElementBlock::Precision precision, ElementBlock::Storage storage,
+        ElementBlock::Assembly assembly, int threads, int repeat, ElementBlock::Schedule schedule) {
+    NodeBlock nodes;
+    ElementBlock block;
+    Result result;
+    size_t k;
+    int r;
+
+    nodes.init(node_list_);
+    block.init(elem_list_);
+    block.simd_isa_ = isa;
+    block.precompute_convection_ = precompute_convection;
+    block.precision_ = precision;
+    block.storage_ = storage;
+    block.assembly_ = assembly;
+    block.num_threads_ = threads;
+    block.schedule_ = schedule;
+    nodes.num_threads_ = threads;
+    if (threads > 1) {
+        block.colorElements(512);
+    }
+    block.calcInvariants1(nodes, 100.0);
+    nodes.calcInvMass();
+    nodes.calcDtByM(1.0e-3);
+    block.calcInvariants2(nodes, 1.0e-3, 1.0);
+
+    for (k = 0; k < nodes.num_nodes_; k++) {
+        nodes.vel_[k].set(0.3*std::sin(0.01*k), 0.2*std::cos(0.007*k));
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (r = 0; r < repeat; r++) {
+        nodes.clearVelocityDelta();
+        block.calcVelocityPrediction(nodes);
+    }
+    result.t_prediction = elapsed(start);
+    result.d_vel = nodes.d_vel_;
+
+    start = std::chrono::steady_clock::now();
+    for (r = 0; r < repeat; r++) {
+        block.calcDivergenceAndCorrect(nodes, 0.0);
+    }
+    result.t_correction = elapsed(start);
+    result.p = block.p_;
+
+    start = std::chrono::steady_clock::now();
+    for (r = 0; r < repeat; r++) {
+        block.calcDivergenceAndCorrect(nodes, 1.0e30);
+    }
+    result.t_check = elapsed(start);
+    result.bytes = block.memoryBytes();
+    return result;
+}
+
+void BenchElementBlock::report(const char *name, const Result &result, const Result &scalar) {
+    double diff_vel = 0, diff_p = 0;
+    size_t k;
+    for (k = 0; k < result.d_vel.size(); k++) {
+        diff_vel = std::max(diff_vel, (result.d_vel[k] - scalar.d_vel[k]).norm());
+    }
+    for (k = 0; k < result.p.size(); k++) {
+        diff_p = std::max(diff_p, std::fabs(result.p[k] - scalar.p[k]));
+    }
+    std::cout << name
+            << " : prediction " << result.t_prediction << " s (x"
+            << scalar.t_prediction / result.t_prediction << ")"
+            << ", correction " << result.t_correction << " s (x"
+            << scalar.t_correction / result.t_correction << ")"
+            << ", check " << result.t_check << " s (x"
+            << scalar.t_check / result.t_check << ")"
+            << ", max diff d_vel " << diff_vel << ", p " << diff_p
+            << ", " << result.bytes / elem_list_.size() << " bytes/element" << std::endl;
+}
+
+void BenchElementBlock::run(int repeat) {
+    std::cout << "elements : " << elem_list_.size() << ", nodes : " << node_list_.size()
+            << ", repeat : " << repeat << std::endl;
+
+    const ElementBlock::Precision dbl = ElementBlock::PRECISION_DOUBLE, mixed = ElementBlock::PRECISION_MIXED;
+    const ElementBlock::Storage full = ElementBlock::STORAGE_FULL, lean = ElementBlock::STORAGE_LEAN;
+    const ElementBlock::Assembly scatter = ElementBlock::ASSEMBLY_SCATTER, gather = ElementBlock::ASSEMBLY_GATHER;
+
+    // 比較の基準は、スカラー版で移流項を毎回計算する場合
+    ElementBlock::SimdIsa detected = ElementBlock::detectSimdIsa();
+    Result scalar = measure(ElementBlock::SIMD_SCALAR, false, dbl, full, scatter, 1, repeat);
+    int i;
+    for (i = ElementBlock::SIMD_SCALAR; i <= detected; i++) {
+        ElementBlock::SimdIsa isa = (ElementBlock::SimdIsa)i;
+        std::string name = ElementBlock::simdIsaName(isa);
+        if (isa == ElementBlock::SIMD_SCALAR) {
+            report((name + " recompute").c_str(), scalar, scalar);
+        } else {
+            report((name + " recompute").c_str(), measure(isa, false, dbl, full, scatter, 1, repeat), scalar);
+        }
+        report((name + " precomputed").c_str(), measure(isa, true, dbl, full, scatter, 1, repeat), scalar);
+        report((name + " mixed").c_str(), measure(isa, false, mixed, full, scatter, 1, repeat), scalar);
+        report((name + " lean").c_str(), measure(isa, false, dbl, lean, scatter, 1, repeat), scalar);
+        report((name + " gather").c_str(), measure(isa, false, dbl, full, gather, 1, repeat), scalar);
+    }
+
+#ifdef _OPENMP
+    // 512要素のチャンク単位で色分けし、スレッド数を倍々に増やす
+    int max_threads = std::max(omp_get_num_procs(), 2);
+    for (int threads = 2; threads <= max_threads; threads *= 2) {
+        std::ostringstream name;
+        name << ElementBlock::simdIsaName(detected) << " threads " << threads;
+        report(name.str().c_str(), measure(detected, false, dbl, full, scatter, threads, repeat), scalar);
+        report((name.str() + " gather").c_str(), measure(detected, false, dbl, full, gather, threads, repeat), scalar);
+        report((name.str() + " stealing").c_str(),
+                measure(detected, false, dbl, full, scatter, threads, repeat, ElementBlock::SCHEDULE_STEALING), scalar);
+    }
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    BenchElementBlock bench;
+    int repeat = 100;
+
+    try {
+        if (argc >= 3 && std::strcmp(argv[1], "-c") == 0) {
+            bench.readCase(argv[2]);
+            if (argc >= 4) {
+                repeat = std::atoi(argv[3]);
+            }
+        } else {
+            int nx = argc >= 3 ? std::atoi(argv[1]) : 400;
+            int ny = argc >= 3 ? std::atoi(argv[2]) : 200;
+            if (argc >= 4) {
+                repeat = std::atoi(argv[3]);
+            }
+            bench.makeGrid(nx, ny);
+        }
+    } catch (IoException &exp) {
+        std::cerr << exp << std::endl;
+        return 1;
+    } catch (DataException &exp) {
+        std::cerr << exp << std::endl;
+        return 1;
+    }
+
+    bench.run(repeat);
+    return 0;
+}
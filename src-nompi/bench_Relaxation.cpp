@@ -0,0 +1,263 @@
+/*
+ * bench_Relaxation.cpp
+ *
+ * 計算条件ファイルの緩和係数 (relaxation) を選ぶための試行計算を行うプログラム。
+ *
+ * 使い方:
+ *   bench_Relaxation casefile [steps [from to step]]
+ *
+ * 計算条件ファイルのメッシュのうち rank 0 の要素を1プロセスで担当し (全体で試すには
+ * プロセス数1に分割したメッシュを使う)、速度と圧力をゼロから始めて
+ * steps ステップ (既定値は計算条件ファイルの T まで) を、緩和係数 from, from+step, ..., to
+ * (既定値は 0.1 から 1.5 まで 0.1 刻み) のそれぞれで計算し、速度補正の反復数の合計、
+ * max_corrections に達したステップ数、発散したか (速度が有限でなくなったか) を表示する。
+ * それぞれの緩和係数で、反復を Anderson法で加速した場合 (correction_acceleration anderson、
+ * 覚えておく反復の数は計算条件ファイルの anderson_depth) も計算して表示する。
+ * 加速しない場合のうち発散しなかった中で反復数の合計が最も少ないものを選ぶ。計算条件ファイルの値と選んだ値の
+ * それぞれから始めて、要素ごとに緩和係数を調整した場合 (relaxation_adaptive on) も計算して表示する。
+ * 比較のため、圧力補正量を前処理付き共役勾配法で解く場合 (correction_solver pcg) の反復数の合計も
+ * 前処理 jacobi, ilu のそれぞれで表示する (緩和係数は使わない)。
+ * 速度補正は correction_order jacobi の順序で行う。この順序では反復数はプロセス数によらない。
+ *
+ * 計算条件ファイルの省略可能な設定 (storage, threads など) も反映され、
+ * 読み込みの経過は bench_Relaxation.log.0.txt に出力される。
+ */
+
+#include <CfdProcData.h>
+#include <Logger.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+class BenchRelaxation {
+
+    Params params_;
+    State state_;
+    CfdCommData commData_;
+    CfdProcData procData_;
+    // 計算条件ファイルの緩和係数
+    double case_relaxation_;
+
+    struct Result {
+        long corrections;
+        int capped;
+        bool diverged;
+        double mean_relaxation;
+    };
+
+    // pcg が NULL でなければ、correction_solver pcg の前処理 pcg で解く
+    Result measure(double relaxation, bool adaptive, bool anderson, const char *pcg, int steps);
+    int solvePressure(int max_corrections, bool &unconverged);
+    // relaxation が負なら緩和係数は表示しない
+    void report(const char *name, double relaxation, const Result &result);
+
+public:
+    // 計算条件ファイルのメッシュと境界条件を読み、集中化質量まで計算する
+    void readCase(const char *filename);
+    // 計算条件ファイルの T までのステップ数
+    int defaultSteps() const;
+    void run(int steps, double from, double to, double step);
+};
+
+void BenchRelaxation::readCase(const char *filename) {
+    Logger::openLog("bench_Relaxation", 0);
+    params_.init(1, 0, filename);
+    state_.reset();
+    commData_.init(&params_, &state_);
+    procData_.init(&params_, &state_, &commData_);
+    procData_.readMeshFile();
+    procData_.findOwnData();
+    procData_.readBoundaryFile();
+    // 1プロセスなので質量の送受信はない
+    procData_.calcInvariants1();
+    case_relaxation_ = params_.relaxation_;
+}
+
+int BenchRelaxation::defaultSteps() const {
+    return (int)(params_.duration_ / params_.delta_t_) + 1;
+}
+
+/*
+ * correction_solver pcg の速度補正を CfdDriver_sp と同じ手順で行い、反復数を返す。
+ * 閾値を超える要素が残った (max_corrections に達したか途中で打ち切った) 場合は unconverged を true にする。
+ */
+int BenchRelaxation::solvePressure(int max_corrections, bool &unconverged) {
+    std::vector<double> dots(procData_.numPressureSolverDots());
+    std::vector<double> next(dots.size());
+    int i;
+    procData_.beginPressureSolve(dots.data());
+    for (i = 0; i < max_corrections && dots[1] > 0; i++) {
+        procData_.nextPressureDirection(dots.data());
+        procData_.gatherPressureDirection();
+        procData_.multiplyPressureLocal();
+        procData_.multiplyPressureInterface(dots.data());
+        if (!procData_.updatePressureSolution(dots.data(), next.data())) {
+            break;
+        }
+        dots = next;
+    }
+    if (i > 0) {
+        procData_.applyPressureSolution();
+        procData_.applyVelocityDeltaAndClear();
+        procData_.applyBoundaryConditions();
+    }
+    unconverged = (dots[1] > 0);
+    return i;
+}
+
+/*
+ * 1つの緩和係数で steps ステップ計算する。
+ * 速度予測と速度補正は CfdDriver_sp と同じ手順で行い、結果のファイルは書かない。
+ */
+BenchRelaxation::Result BenchRelaxation::measure(double relaxation, bool adaptive, bool anderson, const char *pcg,
+        int steps) {
+    Result result;
+    int max_corrections = params_.max_corrections_;
+    int s, i;
+    size_t k;
+
+    params_.relaxation_ = relaxation;
+    params_.relaxation_adaptive_ = adaptive ? "on" : "off";
+    params_.correction_acceleration_ = anderson ? "anderson" : "off";
+    params_.correction_solver_ = pcg ? "pcg" : "abmac";
+    if (pcg) {
+        params_.pcg_preconditioner_ = pcg;
+    }
+    procData_.calcInvariants2();
+    std::vector<double> dots(procData_.numAccelerationDots());
+    anderson = procData_.accelerationEnabled();
+    procData_.clearFieldData();
+    state_.reset();
+
+    result.corrections = 0;
+    result.capped = 0;
+    for (s = 0; s < steps; s++) {
+        procData_.calcVelocityPrediction();
+        procData_.applyVelocityDeltaAndClear();
+        procData_.applyBoundaryConditions();
+        procData_.clearRelaxationHistory();
+        procData_.clearAccelerationHistory();
+        if (pcg) {
+            bool unconverged;
+            result.corrections += solvePressure(max_corrections, unconverged);
+            if (unconverged) {
+                result.capped++;
+            }
+            state_.nextRound(params_.delta_t_);
+            continue;
+        }
+        for (i = 0; i < max_corrections; i++) {
+            bool corrected;
+            if (anderson) {
+                procData_.beginAcceleration();
+                corrected = procData_.calcDivergenceAndCorrectAll();
+                if (corrected) {
+                    procData_.calcAccelerationDots(dots.data());
+                    procData_.accelerate(dots.data());
+                } else {
+                    procData_.cancelAcceleration();
+                }
+            } else {
+                corrected = procData_.calcDivergenceAndCorrect();
+            }
+            procData_.adaptRelaxation();
+            if (!corrected) {
+                procData_.clearVelocityDelta();
+                break;
+            }
+            procData_.applyVelocityDeltaAndClear();
+            procData_.applyBoundaryConditions();
+        }
+        result.corrections += i;
+        if (i == max_corrections) {
+            result.capped++;
+        }
+        state_.nextRound(params_.delta_t_);
+    }
+
+    // 発散すると速度が有限でなくなり、判別式が閾値との比較で補正不要と判定されてしまう
+    result.diverged = false;
+    const NodeBlock &nodes = procData_.node_block_;
+    for (k = 0; k < nodes.num_nodes_; k++) {
+        if (!std::isfinite(nodes.vel_[k].x_) || !std::isfinite(nodes.vel_[k].y_)) {
+            result.diverged = true;
+            break;
+        }
+    }
+    result.mean_relaxation = procData_.meanRelaxation();
+    return result;
+}
+
+void BenchRelaxation::report(const char *name, double relaxation, const Result &result) {
+    std::cout << name;
+    if (relaxation >= 0) {
+        std::cout << " " << relaxation;
+    }
+    std::cout << " : corrections " << result.corrections
+            << ", capped steps " << result.capped;
+    if (result.diverged) {
+        std::cout << ", diverged";
+    }
+    if (params_.relaxation_adaptive_ == "on") {
+        std::cout << ", mean relaxation " << result.mean_relaxation;
+    }
+    std::cout << std::endl;
+}
+
+void BenchRelaxation::run(int steps, double from, double to, double step) {
+    std::cout << "elements : " << procData_.my_elements_.size() << ", steps : " << steps
+            << ", epsilon : " << params_.epsilon_ << ", max_corrections : " << params_.max_corrections_
+            << std::endl;
+
+    double best = -1;
+    long best_corrections = 0;
+    // 刻みの丸め誤差で to を取りこぼさないように、半刻み分の余裕を持たせる
+    for (double relaxation = from; relaxation <= to + 0.5 * step; relaxation += step) {
+        Result result = measure(relaxation, false, false, NULL, steps);
+        report("relaxation", relaxation, result);
+        report("anderson", relaxation, measure(relaxation, false, true, NULL, steps));
+        if (!result.diverged && (best < 0 || result.corrections < best_corrections)) {
+            best = relaxation;
+            best_corrections = result.corrections;
+        }
+    }
+    // 緩和係数を使わないので1回ずつ
+    report("pcg jacobi", -1, measure(case_relaxation_, false, false, "jacobi", steps));
+    report("pcg ilu", -1, measure(case_relaxation_, false, false, "ilu", steps));
+    if (best < 0) {
+        std::cout << "all candidates diverged" << std::endl;
+        return;
+    }
+    report("adaptive from", case_relaxation_, measure(case_relaxation_, true, false, NULL, steps));
+    report("adaptive from", best, measure(best, true, false, NULL, steps));
+    std::cout << "best : relaxation " << best << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    BenchRelaxation bench;
+
+    if (argc < 2) {
+        std::cerr << "Usage : bench_Relaxation casefile [steps [from to step]]\n";
+        return 1;
+    }
+    try {
+        bench.readCase(argv[1]);
+    } catch (IoException &exp) {
+        std::cerr << exp << std::endl;
+        return 1;
+    } catch (DataException &exp) {
+        std::cerr << exp << std::endl;
+        return 1;
+    }
+    int steps = argc >= 3 ? std::atoi(argv[2]) : bench.defaultSteps();
+    double from = 0.1, to = 1.5, step = 0.1;
+    if (argc >= 6) {
+        from = std::atof(argv[3]);
+        to = std::atof(argv[4]);
+        step = std::atof(argv[5]);
+    }
+    bench.run(steps, from, to, step);
+    Logger::closeLog();
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * test_AndersonAcceleration.cpp
+ */
+
+#include <TestBase.h>
+#include <AndersonAcceleration.h>
+#include <cmath>
+#include <vector>
+
+class TestAndersonAcceleration : public TestBase {
+
+    static const size_t N = 40;
+
+    // 1次元のJacobi法 x_k <- (x_{k-1} + x_{k+1} + b_k) / 2 を緩和係数 omega で緩和した反復。
+    // 両端は0に固定する。反復が遅く収束する例として使う
+    static void jacobiStep(const std::vector<double> &x, std::vector<double> &g, double omega);
+    // |g - x| の最大値
+    static double residual(const std::vector<double> &x, const std::vector<double> &g);
+
+    // tolerance 未満になるまでの反復数。accelerate なら Anderson法で加速する
+    int iterate(bool accelerate, int depth, double tolerance, std::vector<double> &x);
+
+public:
+
+    void testConvergence();
+    void testSplit();
+    void testRestart();
+    void run();
+};
+
+void TestAndersonAcceleration::jacobiStep(const std::vector<double> &x, std::vector<double> &g, double omega)
+{
+    size_t n = x.size();
+    for (size_t k = 0; k < n; k++) {
+        double left = k > 0 ? x[k - 1] : 0;
+        double right = k + 1 < n ? x[k + 1] : 0;
+        double b = 0.01 * std::sin(0.3 * k);
+        g[k] = x[k] + omega * ((left + right + b) / 2 - x[k]);
+    }
+}
+
+double TestAndersonAcceleration::residual(const std::vector<double> &x, const std::vector<double> &g)
+{
+    double r = 0;
+    for (size_t k = 0; k < x.size(); k++) {
+        r = std::max(r, std::fabs(g[k] - x[k]));
+    }
+    return r;
+}
+
+int TestAndersonAcceleration::iterate(bool accelerate, int depth, double tolerance, std::vector<double> &x)
+{
+    AndersonAcceleration anderson;
+    anderson.init(N, depth);
+    std::vector<double> g(N), dx(N), dots(anderson.numDots());
+    x.assign(N, 0.0);
+    int i;
+    for (i = 0; i < 100000; i++) {
+        anderson.begin(x.data());
+        jacobiStep(x, g, 0.8);
+        if (residual(x, g) < tolerance) {
+            break;
+        }
+        if (accelerate) {
+            anderson.localDots(g.data(), dots.data());
+            if (anderson.extrapolate(dots.data(), dx.data())) {
+                for (size_t k = 0; k < N; k++) {
+                    g[k] += dx[k];
+                }
+            }
+        }
+        x = g;
+    }
+    return i;
+}
+
+void TestAndersonAcceleration::testConvergence()
+{
+    // 加速すると少ない反復で同じ不動点に収束する
+    std::vector<double> plain, accelerated;
+    int plain_steps = iterate(false, 5, 1.0e-10, plain);
+    int accelerated_steps = iterate(true, 5, 1.0e-10, accelerated);
+    test_true(plain_steps < 100000);
+    test_true(accelerated_steps * 5 < plain_steps);
+    double diff = 0;
+    for (size_t k = 0; k < N; k++) {
+        diff = std::max(diff, std::fabs(accelerated[k] - plain[k]));
+    }
+    test_true(diff < 1.0e-7);
+}
+
+void TestAndersonAcceleration::testSplit()
+{
+    // 値を2つに分けて持ち、内積の和を渡しても、まとめて持つ場合と同じ補正量になる
+    const size_t half = N / 2;
+    AndersonAcceleration whole, first, second;
+    whole.init(N, 3);
+    first.init(half, 3);
+    second.init(N - half, 3);
+    size_equals(whole.numDots(), 6);
+    std::vector<double> x(N, 0.0), g(N), dx(N), dx_split(N);
+    std::vector<double> dots(6), dots_first(6), dots_second(6);
+    bool same = true;
+    for (int i = 0; i < 8; i++) {
+        whole.begin(x.data());
+        first.begin(x.data());
+        second.begin(x.data() + half);
+        jacobiStep(x, g, 0.8);
+        whole.localDots(g.data(), dots.data());
+        first.localDots(g.data(), dots_first.data());
+        second.localDots(g.data() + half, dots_second.data());
+        for (size_t j = 0; j < dots.size(); j++) {
+            dots_first[j] += dots_second[j];
+        }
+        bool extrapolated = whole.extrapolate(dots.data(), dx.data());
+        test_true(first.extrapolate(dots_first.data(), dx_split.data()) == extrapolated);
+        test_true(second.extrapolate(dots_first.data(), dx_split.data() + half) == extrapolated);
+        // 最初の反復は差分がないので補正しない
+        test_true(extrapolated == (i > 0));
+        for (size_t k = 0; k < N; k++) {
+            if (extrapolated) {
+                if (std::fabs(dx[k] - dx_split[k]) > 1.0e-12 * (1 + std::fabs(dx[k]))) {
+                    same = false;
+                }
+                g[k] += dx[k];
+            }
+        }
+        int_equals(whole.historySize(), std::min(i, 3));
+        x = g;
+    }
+    test_true(same);
+}
+
+void TestAndersonAcceleration::testRestart()
+{
+    AndersonAcceleration anderson;
+    anderson.init(4, 2);
+    double x[4] = {1, 2, 3, 4};
+    double g[4] = {1, 2, 3, 4};
+    double dx[4] = {0, 0, 0, 0};
+    double dots[4];
+
+    // 残差が0なら補正しないが、履歴は捨てない
+    for (int i = 0; i < 2; i++) {
+        anderson.begin(x);
+        anderson.localDots(g, dots);
+        test_false(anderson.extrapolate(dots, dx));
+    }
+    int_equals(anderson.historySize(), 1);
+    int_equals((int)anderson.restarts(), 0);
+
+    // 値が有限でなければ係数が求まらないので履歴を捨てる
+    g[2] = NAN;
+    anderson.begin(x);
+    anderson.localDots(g, dots);
+    test_false(anderson.extrapolate(dots, dx));
+    int_equals(anderson.historySize(), 0);
+    int_equals((int)anderson.restarts(), 1);
+    dbl_equals(dx[2], 0);
+
+    // restore() で begin() の値に戻る
+    double y[4] = {0, 0, 0, 0};
+    anderson.restore(y);
+    dbl_equals(y[3], 4);
+
+    // clear() の後は差分がないので補正しない
+    g[2] = 5;
+    anderson.clear();
+    anderson.begin(x);
+    anderson.localDots(g, dots);
+    test_false(anderson.extrapolate(dots, dx));
+    int_equals(anderson.historySize(), 0);
+}
+
+void TestAndersonAcceleration::run()
+{
+    testConvergence();
+    testSplit();
+    testRestart();
+}
+
+int main(int argc, char *argv[])
+{
+    TestAndersonAcceleration test;
+    test.run();
+    return test.report();
+}
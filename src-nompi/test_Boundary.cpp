@@ -4,6 +4,7 @@
 
 #include <TestBase.h>
 #include <Boundary.h>
+#include <NodeBlock.h>
 
 /*
  * 境界条件クラス用の単体テストプログラム
@@ -15,6 +16,7 @@ class TestBoundary : public TestBase {
     Boundary bd_;
     // 動作させるために必要な最低限のオブジェクト
     Node nodes_[4];
+    NodeBlock node_block_;
 
 public:
     void setup();
@@ -29,10 +31,16 @@ void TestBoundary::setup()
     nodes_[1].pos_.set(1,0);
     nodes_[2].pos_.set(2,1);
     nodes_[3].pos_.set(3,1);
-    bd_.addNode(&nodes_[0]);
-    bd_.addNode(&nodes_[1]);
-    bd_.addNode(&nodes_[2]);
-    bd_.addNode(&nodes_[3]);
+    std::vector<Node *> nodes;
+    for (int i = 0; i < 4; i++) {
+        nodes.push_back(&nodes_[i]);
+    }
+    node_block_.init(nodes);
+    // ローカルな節点番号で境界上の節点を登録する
+    bd_.addNode(0);
+    bd_.addNode(1);
+    bd_.addNode(2);
+    bd_.addNode(3);
     // 速度を定める多項式の係数
     bd_.a0_ = 6.0;
     bd_.a1_ = 5.0;
@@ -50,9 +58,9 @@ void TestBoundary::setup()
 
 void TestBoundary::testApply()
 {
-    bd_.apply(1.0, 1.0);
+    bd_.apply(node_block_, 1.0, 1.0);
     // 計算された速度を確認する (TestBase.hを参照)
-    xy_equals(nodes_[0].vel_, VectorXY(6.0, 0.6));
+    xy_equals(node_block_.vel_[0], VectorXY(6.0, 0.6));
 }
 
 void TestBoundary::run()
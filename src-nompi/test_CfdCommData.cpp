@@ -17,10 +17,12 @@ class TestCfdCommData : public TestBase {
     Params params_;
     State state_;
     Node nodes_[4];
+    NodeBlock node_block_;
 
 public:
     void setup();
     void testBoundaryNode();
+    void testPiggyback();
     void run();
 };
 
@@ -34,17 +36,22 @@ void TestCfdCommData::setup()
     // テスト用の node データにダミーのデータを設定する
     // 全部同じ内容だったり、内容が0だったりすると、値のコピー処理などに
     // バグがあった時に気づきにくいので、規則的で個性のあるデータを入れる。
+    std::vector<Node *> nodes;
     for (int i = 0; i < 4; i++) {
         nodes_[i].pos_.set(i*10, i*2);
-        nodes_[i].m_ = 1 + i * 0.01;
-        nodes_[i].vel_.set(i*0.1, i*0.2);
+        nodes.push_back(&nodes_[i]);
     }
-    // 当プロセスのrankは0だが、rank=1のプロセスと接する境界上に、nodes_[0] が存在する旨を登録する。
-    commData_.addBoundaryNode(1, &nodes_[0]);
-    // rank=2 のプロセスと接する境界上に、nodes_[1,2,3] が存在する旨を登録する
-    commData_.addBoundaryNode(2, &nodes_[1]);
-    commData_.addBoundaryNode(2, &nodes_[2]);
-    commData_.addBoundaryNode(2, &nodes_[3]);
+    node_block_.init(nodes);
+    for (int i = 0; i < 4; i++) {
+        node_block_.m_[i] = 1 + i * 0.01;
+        node_block_.vel_[i].set(i*0.1, i*0.2);
+    }
+    // 当プロセスのrankは0だが、rank=1のプロセスと接する境界上に、節点0 が存在する旨を登録する。
+    commData_.addBoundaryNode(1, 0);
+    // rank=2 のプロセスと接する境界上に、節点1,2,3 が存在する旨を登録する
+    commData_.addBoundaryNode(2, 1);
+    commData_.addBoundaryNode(2, 2);
+    commData_.addBoundaryNode(2, 3);
 }
 
 void TestCfdCommData::testBoundaryNode()
@@ -60,7 +67,7 @@ void TestCfdCommData::testBoundaryNode()
     int_equals(buff2->nodes_.size(), 3);
 
     // 全境界上の質量データを送信バッファに集めさせる。
-    commData_.gatherBoundaryNodeMass();
+    commData_.gatherBoundaryNodeMass(node_block_);
     int_equals(buff1->send_buffer_.size(), 1);
     dbl_equals(buff1->send_buffer_[0], 1.00);
     int_equals(buff2->send_buffer_.size(), 3);
@@ -70,10 +77,42 @@ void TestCfdCommData::testBoundaryNode()
 
 }
 
+void TestCfdCommData::testPiggyback()
+{
+    CfdCommPeerBuffer *buff1 = commData_.findOrCreatePeerBufferForRank(1);
+    CfdCommPeerBuffer *buff2 = commData_.findOrCreatePeerBufferForRank(2);
+    // 計算条件ファイルでは convergence_check を省略しているので、末尾に値を付けない
+    int_equals(commData_.piggyback_, 0);
+    commData_.gatherBoundaryNodeVelocityDelta(node_block_);
+    int_equals(buff2->send_buffer_.size(), 6);
+    int_equals(commData_.velocityPayloadSize(*buff2), 6);
+
+    // 末尾に1つ付け足す
+    commData_.piggyback_ = 1;
+    node_block_.d_vel_[3].set(0.5, 0.25);
+    commData_.gatherBoundaryNodeVelocityDelta(node_block_);
+    int_equals(buff1->send_buffer_.size(), 3);
+    int_equals(buff2->send_buffer_.size(), 7);
+    int_equals(buff2->recv_buffer_.size(), 7);
+    int_equals(commData_.velocityPayloadSize(*buff2), 7);
+    dbl_equals(buff2->send_buffer_[5], 0.25);
+    dbl_equals(buff2->send_buffer_[6], 0);
+    commData_.setPiggyback(5);
+    dbl_equals(buff1->send_buffer_[2], 5);
+    dbl_equals(buff2->send_buffer_[6], 5);
+
+    // 受信した末尾の値の最小値
+    buff1->recv_buffer_.back() = 3;
+    buff2->recv_buffer_.back() = 2;
+    dbl_equals(commData_.minPiggyback(10), 2);
+    commData_.piggyback_ = 0;
+}
+
 void TestCfdCommData::run()
 {
     setup();
     testBoundaryNode();
+    testPiggyback();
 }
 
 // このテストプログラムのmain関数。
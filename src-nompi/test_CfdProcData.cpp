@@ -30,8 +30,8 @@ void TestCfdProcData::setup()
     commData_.init(&params_, &state_);
     procData_.init(&params_, &state_, &commData_);
     procData_.readMeshFile();
-    procData_.readBoundaryFile();
     procData_.findOwnData();
+    procData_.readBoundaryFile();
 }
 
 void TestCfdProcData::test()
@@ -43,6 +43,8 @@ void TestCfdProcData::test()
     size_equals(procData_.my_nodes_.size(), 9);
     xy_equals(procData_.my_nodes_[0]->pos_, VectorXY(0, 0));
     xy_equals(procData_.my_nodes_[1]->pos_, VectorXY(1, 0));
+    size_equals(procData_.node_block_.num_nodes_, 9);
+    xy_equals(procData_.node_block_.pos_[1], VectorXY(1, 0));
 
     procData_.calcInvariants1();
 }
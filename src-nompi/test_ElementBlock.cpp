@@ -0,0 +1,693 @@
+/*
+ * test_ElementBlock.cpp
+ */
+
+#include <TestBase.h>
+#include <ElementBlock.h>
+#include <NodeBlock.h>
+#include <QuadElement.h>
+#include <TestGrid.h>
+#include <Matrix4.h>
+#include <Vector4.h>
+#include <cmath>
+
+class TestElementBlock : public TestBase {
+
+    /*
+     * Test target
+     */
+    ElementBlock block_;
+
+    /*
+     * Requisite objects to make test target operate.
+     */
+    QuadElement elem_;
+    Node nodes_[4];
+    NodeBlock node_block_;
+
+public:
+    void setup();
+    // test calcInvariants1
+    void testMass();
+    void testDiffusionMatrix();
+    void testHxy();
+    void testSize();
+
+    // test calcInvariants2
+    void testDtHxByM();
+    void testLambda();
+
+    // test calcDivergenceAndCorrect
+    void testCorrection();
+
+    // test colorElements
+    void testColoring();
+
+    // test setBoundaryElements : PART_BOUNDARY と PART_INTERIOR に分けて計算しても、
+    // PART_ALL と同じ結果になることを確認する
+    void testSplit(ElementBlock::Assembly assembly, int threads);
+
+    // test calcDivergenceAndCorrectColor : 色ごとに反映せずに全色を計算すると
+    // calcDivergenceAndCorrect() と同じ結果になり、色ごとに反映すると少ない反復で収束する
+    void testMulticolor(int threads);
+
+    // test updateActiveElements : 速度が変わった節点を持つ要素だけを計算しても、
+    // 全要素を計算する場合と同じ反復で収束し、同じ結果になる
+    void testActiveSet(ElementBlock::Storage storage, int threads);
+
+    // test adaptRelaxation : 要素ごとに緩和係数を上げると、同じ緩和係数のままより少ない反復で収束する。
+    // STORAGE_LEAN では何もしない
+    void testAdaptiveRelaxation(ElementBlock::Storage storage, int threads);
+
+    // test addPressureDelta : 補正で変わった圧力を与えると、補正と同じ圧力と速度変化量になる
+    void testPressureDelta(ElementBlock::Storage storage, ElementBlock::Assembly assembly, int threads);
+
+    // SIMD版とスカラー版の結果が一致することを確認する
+    void testSimd();
+    void testSimdIsa(ElementBlock::SimdIsa isa, bool precompute_convection,
+            ElementBlock::Precision precision, ElementBlock::Storage storage,
+            ElementBlock::Assembly assembly, int threads,
+            ElementBlock::Schedule schedule = ElementBlock::SCHEDULE_DYNAMIC);
+
+    void run();
+
+private:
+    // 比べる ElementBlock の設定。threads が2以上なら chunk 要素のチャンク単位で色分けする
+    struct BlockOptions {
+        ElementBlock::SimdIsa isa;
+        bool precompute_convection;
+        ElementBlock::Precision precision;
+        ElementBlock::Storage storage;
+        ElementBlock::Assembly assembly;
+        int threads;
+        size_t chunk;
+        ElementBlock::Schedule schedule;
+        BlockOptions(ElementBlock::Storage storage = ElementBlock::STORAGE_FULL,
+                ElementBlock::Assembly assembly = ElementBlock::ASSEMBLY_SCATTER, int threads = 1, size_t chunk = 8)
+            : isa(ElementBlock::detectSimdIsa()), precompute_convection(false),
+              precision(ElementBlock::PRECISION_DOUBLE), storage(storage), assembly(assembly),
+              threads(threads), chunk(chunk), schedule(ElementBlock::SCHEDULE_DYNAMIC) {}
+    };
+
+    // 同じ格子から作った2組の節点と要素。node_blocks[i] と blocks[i] が組になる
+    struct BlockPair {
+        TestGrid grid;
+        NodeBlock node_blocks[2];
+        ElementBlock blocks[2];
+    };
+
+    void makeBlockPair(int nx, int ny, const BlockOptions &first, const BlockOptions &second, double relaxation,
+            BlockPair &pair);
+};
+
+void TestElementBlock::setup()
+{
+    /* setup */
+    nodes_[0].pos_.set(0,-2);
+    nodes_[1].pos_.set(2,-2);
+    nodes_[2].pos_.set(2,0);
+    nodes_[3].pos_.set(0,0);
+
+    elem_.nodes_[0] = &nodes_[0];
+    elem_.nodes_[1] = &nodes_[1];
+    elem_.nodes_[2] = &nodes_[2];
+    elem_.nodes_[3] = &nodes_[3];
+
+    std::vector<Node *> nodes;
+    for (int i = 0; i < 4; i++) {
+        nodes_[i].local_index_ = i;
+        nodes.push_back(&nodes_[i]);
+    }
+    node_block_.init(nodes);
+    size_equals(node_block_.num_nodes_, 4);
+
+    std::vector<QuadElement *> elements;
+    elements.push_back(&elem_);
+    block_.init(elements);
+    size_equals(block_.num_elements_, 1);
+    int_equals(block_.nodes_[2], 2);
+}
+
+
+void TestElementBlock::testMass()
+{
+    dbl_equals(node_block_.m_[0], 1.0);
+    dbl_equals(node_block_.m_[1], 1.0);
+    dbl_equals(node_block_.m_[2], 1.0);
+    dbl_equals(node_block_.m_[3], 1.0);
+}
+
+void TestElementBlock::testDiffusionMatrix()
+{
+    dbl_equals(block_.d_[0*4 + 0], 2.0/3.0);
+    dbl_equals(block_.d_[0*4 + 1], -1.0/6.0);
+    dbl_equals(block_.d_[0*4 + 2], -1.0/3.0);
+    dbl_equals(block_.d_[0*4 + 3], -1.0/6.0);
+}
+
+void TestElementBlock::testHxy()
+{
+    Vector4 hx, hy;
+    int i;
+    hx.set(0,-1);
+    hx.set(1,1);
+    hx.set(2,1);
+    hx.set(3,-1);
+    hy.set(0,-1);
+    hy.set(1,-1);
+    hy.set(2,1);
+    hy.set(3,1);
+    for(int i = 0; i < 4; i++){
+        dbl_equals(block_.hx_[i], hx.get(i));
+        dbl_equals(block_.hy_[i], hy.get(i));
+    }
+}
+
+void TestElementBlock::testSize(){
+    double size = 4;
+    dbl_equals(block_.size_[0], size);
+}
+
+void TestElementBlock::testDtHxByM(){
+    // delta_t * inv_m * hx, inv_m = 1
+    for(int i = 0; i < 4; i++){
+        dbl_equals(block_.corr_.dt_hx_by_m_[i], 0.1*block_.hx_[i]);
+        dbl_equals(block_.corr_.dt_hy_by_m_[i], 0.1*block_.hy_[i]);
+    }
+}
+
+void TestElementBlock::testLambda(){
+    // size * relaxation / (delta_t * (hx.M^-1.hx + hy.M^-1.hy)) = 4*0.5/(0.1*(4+4))
+    dbl_equals(block_.corr_.lambda_relaxation_[0], 2.5);
+}
+
+void TestElementBlock::testCorrection(){
+    node_block_.clearVelocity();
+    block_.clearPressure();
+
+    // 発散のない速度場では補正しない
+    test_false(block_.calcDivergenceAndCorrect(node_block_, 0.1));
+
+    // 節点1だけが x 方向に動く場合 D = hx_by_a[1] = 1/4
+    node_block_.vel_[1].set(1, 0);
+    test_false(block_.calcDivergenceAndCorrect(node_block_, 0.3));
+    dbl_equals(block_.D_[0], 0.25);
+    test_true(block_.calcDivergenceAndCorrect(node_block_, 0.1));
+    // div = -lambda * D
+    dbl_equals(block_.p_[0], -0.625);
+    dbl_equals(node_block_.d_vel_[1].x_, 0.1*1*(-0.625));
+    dbl_equals(node_block_.d_vel_[2].y_, 0.1*1*(-0.625));
+}
+
+/*
+ * nx x ny 要素の歪んだ格子 (TestGrid) から pair の2組を作り、1組目に first、2組目に second の設定をして、
+ * Re = 10, delta_t = 0.01 と relaxation でループ不変量まで計算する。
+ * 節点kの速度はどちらの組も (0.3 sin k, 0.2 cos 0.7k) にする。
+ */
+void TestElementBlock::makeBlockPair(int nx, int ny, const BlockOptions &first, const BlockOptions &second,
+        double relaxation, BlockPair &pair)
+{
+    pair.grid.make(nx, ny);
+    const BlockOptions *options[2] = {&first, &second};
+    for (int i = 0; i < 2; i++) {
+        NodeBlock &nodes = pair.node_blocks[i];
+        ElementBlock &block = pair.blocks[i];
+        nodes.init(pair.grid.node_list_);
+        block.init(pair.grid.elem_list_);
+        block.simd_isa_ = options[i]->isa;
+        block.precompute_convection_ = options[i]->precompute_convection;
+        block.precision_ = options[i]->precision;
+        block.storage_ = options[i]->storage;
+        block.assembly_ = options[i]->assembly;
+        block.num_threads_ = options[i]->threads;
+        block.schedule_ = options[i]->schedule;
+        if (options[i]->threads > 1) {
+            block.colorElements(options[i]->chunk);
+        }
+        block.calcInvariants1(nodes, 10.0);
+        nodes.calcInvMass();
+        nodes.calcDtByM(0.01);
+        block.calcInvariants2(nodes, 0.01, relaxation);
+        for (size_t k = 0; k < pair.grid.node_list_.size(); k++) {
+            nodes.vel_[k].set(0.3*std::sin(1.0*k), 0.2*std::cos(0.7*k));
+        }
+    }
+}
+
+/*
+ * 全要素がちょうど1つの色に入り、同じ色の要素が節点を共有しないことを確認する。
+ */
+void TestElementBlock::testColoring()
+{
+    const int nx = 6, ny = 4;
+    TestGrid grid;
+    grid.make(nx, ny);
+    ElementBlock block;
+    block.init(grid.elem_list_);
+
+    // 構造格子なら2x2の模様の4色になり、各色の要素数は等しい
+    size_equals(block.numColors(), 4);
+    size_equals(block.color_begin_[block.numColors()], nx*ny);
+    std::vector<int> seen(nx*ny, 0);
+    size_t c, k;
+    for (c = 0; c < block.numColors(); c++) {
+        size_equals(block.color_begin_[c + 1] - block.color_begin_[c], nx*ny/4);
+        std::vector<int> node_used(grid.node_list_.size(), 0);
+        bool shared = false;
+        for (k = block.color_begin_[c]; k < block.color_begin_[c + 1]; k++) {
+            int32_t e = block.color_elements_[k];
+            seen[e]++;
+            for (int i = 0; i < 4; i++) {
+                if (node_used[block.nodes_[4*e + i]]++) {
+                    shared = true;
+                }
+            }
+        }
+        test_false(shared);
+    }
+    for (k = 0; k < seen.size(); k++) {
+        int_equals(seen[k], 1);
+    }
+
+    // 8要素のチャンク単位の色分けでも、同じ色のチャンクは節点を共有しない
+    block.colorElements(8);
+    test_true(block.numColors() >= 2);
+    size_equals(block.color_begin_[block.numColors()], nx*ny);
+    for (c = 0; c < block.numColors(); c++) {
+        std::vector<int> node_used(grid.node_list_.size(), 0);
+        bool shared = false;
+        for (k = block.color_begin_[c]; k < block.color_begin_[c + 1]; k++) {
+            int32_t e = block.color_elements_[k];
+            // チャンクの要素は連続して並ぶ
+            if (e % 8 != 0) {
+                int_equals(block.color_elements_[k - 1], e - 1);
+            }
+            for (int i = 0; i < 4; i++) {
+                int32_t node = block.nodes_[4*e + i];
+                if (node_used[node] != 0 && node_used[node] != e / 8 + 1) {
+                    shared = true;
+                }
+                node_used[node] = e / 8 + 1;
+            }
+        }
+        test_false(shared);
+    }
+
+    // 要素がなければ色もない
+    ElementBlock empty;
+    empty.init(std::vector<QuadElement *>());
+    size_equals(empty.numColors(), 0);
+}
+
+void TestElementBlock::testSplit(ElementBlock::Assembly assembly, int threads)
+{
+    const int nx = 6, ny = 4;
+    BlockOptions options(ElementBlock::STORAGE_FULL, assembly, threads);
+    BlockPair pair;
+    makeBlockPair(nx, ny, options, options, 1.0, pair);
+    const std::vector<Node *> &node_list = pair.grid.node_list_;
+    NodeBlock &all_nodes = pair.node_blocks[0], &split_nodes = pair.node_blocks[1];
+    ElementBlock &all_block = pair.blocks[0], &split_block = pair.blocks[1];
+    size_t k;
+
+    // 分かれ目はSIMDの組の幅 (8要素) とチャンクの要素数の倍数に切り上げる
+    split_block.setBoundaryElements(3);
+    size_equals(split_block.split_, 8);
+    if (threads > 1) {
+        split_block.setBoundaryElements(9);
+        size_equals(split_block.split_, 16);
+    }
+
+    all_block.calcVelocityPrediction(all_nodes);
+    split_block.calcVelocityPrediction(split_nodes, ElementBlock::PART_BOUNDARY);
+    split_block.calcVelocityPrediction(split_nodes, ElementBlock::PART_INTERIOR);
+    for (k = 0; k < node_list.size(); k++) {
+        xy_equals(split_nodes.d_vel_[k], all_nodes.d_vel_[k]);
+    }
+
+    all_nodes.applyVelocityDeltaAndClear();
+    split_nodes.applyVelocityDeltaAndClear();
+    bool all_corrected = all_block.calcDivergenceAndCorrect(all_nodes, 1.0e-3);
+    bool split_corrected = split_block.calcDivergenceAndCorrect(split_nodes, 1.0e-3, ElementBlock::PART_BOUNDARY);
+    if (split_block.calcDivergenceAndCorrect(split_nodes, 1.0e-3, ElementBlock::PART_INTERIOR)) {
+        split_corrected = true;
+    }
+    test_true(all_corrected);
+    test_true(split_corrected);
+    for (k = 0; k < (size_t)nx*ny; k++) {
+        dbl_equals(split_block.p_[k], all_block.p_[k]);
+    }
+    for (k = 0; k < node_list.size(); k++) {
+        xy_equals(split_nodes.d_vel_[k], all_nodes.d_vel_[k]);
+    }
+
+    // 全要素が境界の要素なら内部の要素はない
+    split_block.setBoundaryElements(nx*ny + 1);
+    size_equals(split_block.split_, nx*ny);
+}
+
+void TestElementBlock::testMulticolor(int threads)
+{
+    const int nx = 12, ny = 8;
+    const double epsilon = 1.0e-6;
+    BlockOptions options(ElementBlock::STORAGE_FULL, ElementBlock::ASSEMBLY_SCATTER, threads);
+    BlockPair pair;
+    makeBlockPair(nx, ny, options, options, 1.0, pair);
+    const std::vector<Node *> &node_list = pair.grid.node_list_;
+    NodeBlock &jacobi_nodes = pair.node_blocks[0], &color_nodes = pair.node_blocks[1];
+    ElementBlock &jacobi_block = pair.blocks[0], &color_block = pair.blocks[1];
+    size_t k;
+
+    // 色の数以上を指定しても何もしない
+    test_false(color_block.calcDivergenceAndCorrectColor(color_nodes, epsilon, color_block.numColors()));
+
+    // 反映せずに全色を計算すれば、判別式はどれも補正前の速度から求まる
+    bool jacobi_corrected = jacobi_block.calcDivergenceAndCorrect(jacobi_nodes, epsilon);
+    bool color_corrected = false;
+    for (size_t c = 0; c < color_block.numColors(); c++) {
+        if (color_block.calcDivergenceAndCorrectColor(color_nodes, epsilon, c)) {
+            color_corrected = true;
+        }
+    }
+    test_true(jacobi_corrected);
+    test_true(color_corrected);
+    for (k = 0; k < (size_t)nx*ny; k++) {
+        dbl_equals(color_block.p_[k], jacobi_block.p_[k]);
+    }
+    for (k = 0; k < node_list.size(); k++) {
+        xy_equals(color_nodes.d_vel_[k], jacobi_nodes.d_vel_[k]);
+    }
+
+    // 反復ごとに反映して収束するまでの反復数を比べる
+    int jacobi_sweeps = 1, color_sweeps = 1;
+    while (jacobi_sweeps < 10000) {
+        jacobi_nodes.applyVelocityDeltaAndClear();
+        if (!jacobi_block.calcDivergenceAndCorrect(jacobi_nodes, epsilon)) {
+            break;
+        }
+        jacobi_sweeps++;
+    }
+    while (color_sweeps < 10000) {
+        color_nodes.applyVelocityDeltaAndClear();
+        color_corrected = false;
+        for (size_t c = 0; c < color_block.numColors(); c++) {
+            if (color_block.calcDivergenceAndCorrectColor(color_nodes, epsilon, c)) {
+                color_nodes.applyVelocityDeltaAndClear();
+                color_corrected = true;
+            }
+        }
+        if (!color_corrected) {
+            break;
+        }
+        color_sweeps++;
+    }
+    test_true(jacobi_sweeps < 10000);
+    test_true(color_sweeps < jacobi_sweeps);
+}
+
+void TestElementBlock::testActiveSet(ElementBlock::Storage storage, int threads)
+{
+    const int nx = 20, ny = 12;
+    const double epsilon = 1.0e-4;
+    BlockOptions options(storage, ElementBlock::ASSEMBLY_SCATTER, threads, 16);
+    BlockPair pair;
+    makeBlockPair(nx, ny, options, options, 1.0, pair);
+    const std::vector<Node *> &node_list = pair.grid.node_list_;
+    NodeBlock &all_nodes = pair.node_blocks[0], &active_nodes = pair.node_blocks[1];
+    ElementBlock &all_block = pair.blocks[0], &active_block = pair.blocks[1];
+    size_t k;
+
+    // 速度の乱れを格子の一隅に置き、補正が必要な範囲を狭くする
+    for (k = 0; k < node_list.size(); k++) {
+        double r = node_list[k]->pos_.x_ + node_list[k]->pos_.y_;
+        VectorXY vel(0.3*std::sin(1.0*k)*std::exp(-r), 0.2*std::cos(0.7*k)*std::exp(-r));
+        all_nodes.vel_[k] = vel;
+        active_nodes.vel_[k] = vel;
+    }
+
+    int all_sweeps = 0, active_sweeps = 0;
+    size_t min_active = nx*ny;
+    bool corrected = true;
+    while (corrected && all_sweeps < 10000) {
+        corrected = all_block.calcDivergenceAndCorrect(all_nodes, epsilon);
+        all_nodes.applyVelocityDeltaAndClear();
+        all_sweeps++;
+    }
+    corrected = true;
+    while (corrected && active_sweeps < 10000) {
+        // 最初の反復は全要素を計算する
+        active_block.updateActiveElements(active_nodes, active_sweeps == 0);
+        min_active = std::min(min_active, active_block.numActiveElements());
+        corrected = active_block.calcDivergenceAndCorrect(active_nodes, epsilon);
+        active_nodes.applyVelocityDeltaAndClear();
+        active_sweeps++;
+    }
+    int_equals(active_sweeps, all_sweeps);
+    test_true(min_active < (size_t)nx*ny / 2);
+    for (k = 0; k < (size_t)nx*ny; k++) {
+        dbl_equals(active_block.p_[k], all_block.p_[k]);
+    }
+    for (k = 0; k < node_list.size(); k++) {
+        xy_equals(active_nodes.vel_[k], all_nodes.vel_[k]);
+    }
+    // 全要素を加えると全要素が対象になる
+    active_block.updateActiveElements(active_nodes, true);
+    size_equals(active_block.numActiveElements(), nx*ny);
+}
+
+void TestElementBlock::testSimd()
+{
+    ElementBlock::SimdIsa detected = ElementBlock::detectSimdIsa();
+    // 移流項テンソル・floatのループ不変量・STORAGE_LEAN を使う場合は、スカラー版どうしでも比較する
+    const ElementBlock::Precision dbl = ElementBlock::PRECISION_DOUBLE, mixed = ElementBlock::PRECISION_MIXED;
+    const ElementBlock::Storage full = ElementBlock::STORAGE_FULL, lean = ElementBlock::STORAGE_LEAN;
+    const ElementBlock::Assembly scatter = ElementBlock::ASSEMBLY_SCATTER, gather = ElementBlock::ASSEMBLY_GATHER;
+    testSimdIsa(ElementBlock::SIMD_SCALAR, true, dbl, full, scatter, 1);
+    testSimdIsa(ElementBlock::SIMD_SCALAR, false, mixed, full, scatter, 1);
+    testSimdIsa(ElementBlock::SIMD_SCALAR, false, dbl, lean, scatter, 1);
+    testSimdIsa(ElementBlock::SIMD_SCALAR, true, dbl, lean, scatter, 1);
+    if (detected >= ElementBlock::SIMD_AVX2) {
+        testSimdIsa(ElementBlock::SIMD_AVX2, false, dbl, full, scatter, 1);
+        testSimdIsa(ElementBlock::SIMD_AVX2, true, dbl, full, scatter, 1);
+        testSimdIsa(ElementBlock::SIMD_AVX2, false, mixed, full, scatter, 1);
+        testSimdIsa(ElementBlock::SIMD_AVX2, false, dbl, lean, scatter, 1);
+        testSimdIsa(ElementBlock::SIMD_AVX2, true, dbl, lean, scatter, 1);
+    }
+    if (detected >= ElementBlock::SIMD_AVX512) {
+        testSimdIsa(ElementBlock::SIMD_AVX512, false, dbl, full, scatter, 1);
+        testSimdIsa(ElementBlock::SIMD_AVX512, true, dbl, full, scatter, 1);
+        testSimdIsa(ElementBlock::SIMD_AVX512, false, mixed, full, scatter, 1);
+        testSimdIsa(ElementBlock::SIMD_AVX512, false, dbl, lean, scatter, 1);
+        testSimdIsa(ElementBlock::SIMD_AVX512, false, mixed, lean, scatter, 1);
+    }
+    // スレッドで分担する場合
+    testSimdIsa(ElementBlock::SIMD_SCALAR, false, dbl, full, scatter, 3);
+    testSimdIsa(ElementBlock::SIMD_SCALAR, true, dbl, lean, scatter, 3);
+    testSimdIsa(detected, false, dbl, full, scatter, 3);
+    testSimdIsa(detected, false, mixed, lean, scatter, 3);
+    // 節点ごとに足し込む場合
+    testSimdIsa(ElementBlock::SIMD_SCALAR, false, dbl, full, gather, 1);
+    testSimdIsa(detected, false, dbl, full, gather, 1);
+    testSimdIsa(detected, true, dbl, lean, gather, 3);
+    testSimdIsa(detected, false, mixed, full, gather, 3);
+    // チャンクを盗み合って分担する場合
+    const ElementBlock::Schedule stealing = ElementBlock::SCHEDULE_STEALING;
+    testSimdIsa(ElementBlock::SIMD_SCALAR, false, dbl, full, scatter, 3, stealing);
+    testSimdIsa(detected, false, dbl, full, scatter, 3, stealing);
+    testSimdIsa(detected, false, dbl, full, gather, 3, stealing);
+}
+
+/*
+ * isa, precompute_convection, precision, storage, assembly, threads, schedule の組み合わせで計算した結果を、
+ * スカラー版・doubleのループ不変量・STORAGE_FULL・ASSEMBLY_SCATTER・1スレッドで計算した結果と比較する。
+ * threads が2以上なら8要素のチャンク単位で色分けし、色ごとにスレッドで分担する。
+ * PRECISION_MIXED の場合はfloatの丸め誤差の分だけ許容誤差を広げる。
+ */
+void TestElementBlock::testSimdIsa(ElementBlock::SimdIsa isa, bool precompute_convection,
+        ElementBlock::Precision precision, ElementBlock::Storage storage,
+        ElementBlock::Assembly assembly, int threads, ElementBlock::Schedule schedule)
+{
+    // 5x3 = 15要素の歪んだ格子。8要素の組にも4要素の組にも端数が出る。
+    // スレッドで分担する場合は、同じ色のチャンクを並列に計算するように、どの色にもチャンクが
+    // 複数ある 21x11 = 231要素の格子にする (こちらも端数が出る)
+    const int nx = threads > 1 ? 21 : 5, ny = threads > 1 ? 11 : 3;
+    BlockOptions scalar;
+    scalar.isa = ElementBlock::SIMD_SCALAR;
+    BlockOptions simd(storage, assembly, threads);
+    simd.isa = isa;
+    simd.precompute_convection = precompute_convection;
+    simd.precision = precision;
+    simd.schedule = schedule;
+    BlockPair pair;
+    makeBlockPair(nx, ny, scalar, simd, 1.0, pair);
+    const std::vector<Node *> &node_list = pair.grid.node_list_;
+    NodeBlock &scalar_nodes = pair.node_blocks[0], &simd_nodes = pair.node_blocks[1];
+    ElementBlock &scalar_block = pair.blocks[0], &simd_block = pair.blocks[1];
+    int k;
+
+    if (threads > 1) {
+        size_t min_chunks = pair.grid.elem_list_.size();
+        for (size_t c = 0; c < simd_block.numColors(); c++) {
+            size_t count = simd_block.color_begin_[c + 1] - simd_block.color_begin_[c];
+            min_chunks = std::min(min_chunks, (count + 7) / 8);
+        }
+        test_true(min_chunks >= 2);
+    }
+    for (k = 0; k < (int)node_list.size(); k++) {
+        dbl_equals(simd_nodes.m_[k], scalar_nodes.m_[k]);
+    }
+    for (k = 0; k < nx*ny; k++) {
+        scalar_block.p_[k] = 0.01*k;
+        simd_block.p_[k] = 0.01*k;
+    }
+
+    scalar_block.calcVelocityPrediction(scalar_nodes);
+    simd_block.calcVelocityPrediction(simd_nodes);
+    for (k = 0; k < (int)node_list.size(); k++) {
+        xy_equals(simd_nodes.d_vel_[k], scalar_nodes.d_vel_[k]);
+    }
+
+    scalar_nodes.applyVelocityDeltaAndClear();
+    simd_nodes.applyVelocityDeltaAndClear();
+    if (precision == ElementBlock::PRECISION_MIXED) {
+        // 大きい格子では圧力の補正量も大きく、丸め誤差もそれに比例する
+        setTolerance(threads > 1 ? 1.0e-5 : 1.0e-6);
+    }
+    bool scalar_corrected = scalar_block.calcDivergenceAndCorrect(scalar_nodes, 1.0e-3);
+    bool simd_corrected = simd_block.calcDivergenceAndCorrect(simd_nodes, 1.0e-3);
+    test_true(scalar_corrected);
+    test_true(simd_corrected);
+    for (k = 0; k < nx*ny; k++) {
+        if (storage == ElementBlock::STORAGE_FULL) {
+            dbl_equals(simd_block.D_[k], scalar_block.D_[k]);
+        }
+        dbl_equals(simd_block.p_[k], scalar_block.p_[k]);
+    }
+    for (k = 0; k < (int)node_list.size(); k++) {
+        xy_equals(simd_nodes.d_vel_[k], scalar_nodes.d_vel_[k]);
+    }
+    setTolerance(TESTBASE_DEFAULT_TOLERANCE);
+}
+
+void TestElementBlock::testAdaptiveRelaxation(ElementBlock::Storage storage, int threads)
+{
+    const int nx = 12, ny = 8;
+    const double epsilon = 1.0e-6;
+    const double relaxation = 0.5;
+    BlockOptions options(storage, ElementBlock::ASSEMBLY_SCATTER, threads);
+    BlockPair pair;
+    makeBlockPair(nx, ny, options, options, relaxation, pair);
+    NodeBlock &fixed_nodes = pair.node_blocks[0], &adaptive_nodes = pair.node_blocks[1];
+    ElementBlock &fixed_block = pair.blocks[0], &adaptive_block = pair.blocks[1];
+    size_t k;
+
+    int fixed_sweeps = 0, adaptive_sweeps = 0;
+    bool corrected = true;
+    while (corrected && fixed_sweeps < 10000) {
+        corrected = fixed_block.calcDivergenceAndCorrect(fixed_nodes, epsilon);
+        fixed_nodes.applyVelocityDeltaAndClear();
+        fixed_sweeps++;
+    }
+    corrected = true;
+    adaptive_block.clearRelaxationHistory();
+    while (corrected && adaptive_sweeps < 10000) {
+        corrected = adaptive_block.calcDivergenceAndCorrect(adaptive_nodes, epsilon);
+        adaptive_block.adaptRelaxation(epsilon);
+        adaptive_nodes.applyVelocityDeltaAndClear();
+        adaptive_sweeps++;
+    }
+    double mean = adaptive_block.meanRelaxation();
+    test_true(fixed_sweeps < 10000);
+    if (storage == ElementBlock::STORAGE_LEAN) {
+        int_equals(adaptive_sweeps, fixed_sweeps);
+        dbl_equals(mean, relaxation);
+        return;
+    }
+    test_true(adaptive_sweeps < fixed_sweeps);
+    test_true(mean > relaxation);
+    test_true(mean <= ElementBlock::RELAX_MAX);
+    bool in_range = true;
+    for (k = 0; k < adaptive_block.relax_factor_.size(); k++) {
+        double factor = adaptive_block.relax_factor_[k];
+        if (factor < 1.0 || factor * relaxation > ElementBlock::RELAX_MAX) {
+            in_range = false;
+        }
+    }
+    test_true(in_range);
+
+    // calcInvariants2() で全要素の緩和係数が戻る
+    adaptive_block.calcInvariants2(adaptive_nodes, 0.01, relaxation);
+    size_equals(adaptive_block.relax_factor_.size(), 0);
+    dbl_equals(adaptive_block.meanRelaxation(), relaxation);
+}
+
+void TestElementBlock::testPressureDelta(ElementBlock::Storage storage, ElementBlock::Assembly assembly, int threads)
+{
+    const int nx = 12, ny = 8;
+    BlockOptions options(storage, assembly, threads);
+    BlockPair pair;
+    makeBlockPair(nx, ny, options, options, 0.5, pair);
+    const std::vector<Node *> &node_list = pair.grid.node_list_;
+    NodeBlock &correct_nodes = pair.node_blocks[0], &delta_nodes = pair.node_blocks[1];
+    ElementBlock &correct_block = pair.blocks[0], &delta_block = pair.blocks[1];
+    size_t k;
+
+    // 閾値0で全要素を補正する
+    test_true(correct_block.calcDivergenceAndCorrect(correct_nodes, 0.0));
+    std::vector<double> dp(correct_block.p_.begin(), correct_block.p_.end());
+    delta_block.addPressureDelta(delta_nodes, dp.data());
+    for (k = 0; k < (size_t)nx*ny; k++) {
+        dbl_equals(delta_block.p_[k], correct_block.p_[k]);
+    }
+    for (k = 0; k < node_list.size(); k++) {
+        xy_equals(delta_nodes.d_vel_[k], correct_nodes.d_vel_[k]);
+    }
+
+    if (storage == ElementBlock::STORAGE_FULL) {
+        test_true(correct_block.discriminantExceeds(0.0));
+        test_false(correct_block.discriminantExceeds(1.0e30));
+    }
+}
+
+void TestElementBlock::run()
+{
+    double Re = 1;
+    double delta_t = 0.1;
+    double relaxation = 0.5;
+    setup();
+    block_.calcInvariants1(node_block_, Re);
+    node_block_.calcInvMass();
+    node_block_.calcDtByM(delta_t);
+    block_.calcInvariants2(node_block_, delta_t, relaxation);
+    testMass();
+    testDiffusionMatrix();
+    testHxy();
+    testSize();
+    testDtHxByM();
+    testLambda();
+    testCorrection();
+    testColoring();
+    testSplit(ElementBlock::ASSEMBLY_SCATTER, 1);
+    testSplit(ElementBlock::ASSEMBLY_SCATTER, 3);
+    testSplit(ElementBlock::ASSEMBLY_GATHER, 3);
+    testMulticolor(1);
+    testMulticolor(3);
+    testActiveSet(ElementBlock::STORAGE_FULL, 1);
+    testActiveSet(ElementBlock::STORAGE_LEAN, 1);
+    testActiveSet(ElementBlock::STORAGE_FULL, 3);
+    testAdaptiveRelaxation(ElementBlock::STORAGE_FULL, 1);
+    testAdaptiveRelaxation(ElementBlock::STORAGE_LEAN, 1);
+    testAdaptiveRelaxation(ElementBlock::STORAGE_FULL, 3);
+    testPressureDelta(ElementBlock::STORAGE_FULL, ElementBlock::ASSEMBLY_SCATTER, 1);
+    testPressureDelta(ElementBlock::STORAGE_LEAN, ElementBlock::ASSEMBLY_SCATTER, 1);
+    testPressureDelta(ElementBlock::STORAGE_FULL, ElementBlock::ASSEMBLY_SCATTER, 3);
+    testPressureDelta(ElementBlock::STORAGE_FULL, ElementBlock::ASSEMBLY_GATHER, 3);
+    testSimd();
+}
+
+int main(int argc, char *argv[])
+{
+    TestElementBlock test;
+    test.run();
+    return test.report();
+}
@@ -0,0 +1,118 @@
+/*
+ * test_Matrix4.cpp
+ */
+
+#include <TestBase.h>
+#include <Matrix4.h>
+#include <Vector4.h>
+#include <stdint.h>
+
+class TestMatrix4 : public TestBase {
+
+    /*
+     * Test target
+     */
+    Matrix4 m_;
+    Vector4 v_;
+
+public:
+    void setup();
+    void testVector();
+    void testMatrixVector();
+    void testMatrixMatrix();
+    void testAlignment();
+    void run();
+};
+
+void TestMatrix4::setup()
+{
+    // m_(i,j) = 10*i + j
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            m_.set(i, j, 10*i + j);
+        }
+    }
+    v_ = Vector4(1, 2, 3, 4);
+}
+
+void TestMatrix4::testVector()
+{
+    // 4成分を指定するコンストラクタは各成分をそのまま保持する
+    dbl_equals(v_.get(0), 1);
+    dbl_equals(v_.get(1), 2);
+    dbl_equals(v_.get(2), 3);
+    dbl_equals(v_.get(3), 4);
+
+    Vector4 w(0.5, -1, 2, 0);
+    dbl_equals(v_.dot(w), 0.5 - 2 + 6);
+    dbl_equals(dot(w, v_), 0.5 - 2 + 6);
+
+    Vector4 s = v_ + w*2 - v_*0.5;
+    dbl_equals(s.get(0), 1.5);
+    dbl_equals(s.get(1), -1);
+    dbl_equals(s.get(2), 5.5);
+    dbl_equals(s.get(3), 2);
+
+    // 既定のコンストラクタは零ベクトル
+    Vector4 z;
+    z[2] += 3;
+    dbl_equals(z.get(0), 0);
+    dbl_equals(z.get(2), 3);
+}
+
+void TestMatrix4::testMatrixVector()
+{
+    // (m v)_i = sum_j (10i+j)*v_j = 10i*10 + 20
+    Vector4 mv = m_*v_;
+    for (int i = 0; i < 4; i++) {
+        dbl_equals(mv.get(i), 100*i + 20);
+    }
+    // (v^T m)_j = sum_i v_i*(10i+j) = 200 + 10j
+    Vector4 vm = v_*m_;
+    for (int j = 0; j < 4; j++) {
+        dbl_equals(vm.get(j), 200 + 10*j);
+    }
+    // 転置した行列との積は v^T m に等しい
+    Vector4 tv = m_.T()*v_;
+    for (int j = 0; j < 4; j++) {
+        dbl_equals(tv.get(j), vm.get(j));
+    }
+}
+
+void TestMatrix4::testMatrixMatrix()
+{
+    Matrix4 e;
+    e.unit();
+    Matrix4 me = m_*e;
+    Matrix4 sum = m_ + e*2 - 2.0*e;
+    for (int k = 0; k < 16; k++) {
+        dbl_equals(me.get(k), m_.get(k));
+        dbl_equals(sum.get(k), m_.get(k));
+    }
+}
+
+void TestMatrix4::testAlignment()
+{
+    // AVX2のロード命令が要求する32バイト境界に揃っていること
+    Vector4 vs[3];
+    for (int i = 0; i < 3; i++) {
+        size_equals(((uintptr_t)vs[i].data()) % 32, 0);
+    }
+    test_true(sizeof(Matrix4) == 16*sizeof(double));
+}
+
+void TestMatrix4::run()
+{
+    setup();
+    testVector();
+    testMatrixVector();
+    testMatrixMatrix();
+    testAlignment();
+}
+
+int main(int argc, char *argv[])
+{
+    TestMatrix4 test;
+    test.run();
+    return test.report();
+}
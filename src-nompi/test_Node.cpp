@@ -14,7 +14,6 @@ public:
 
     void run();
     void testRank();
-    void testMass();
 };
 
 void TestNode::testRank()
@@ -40,17 +39,9 @@ void TestNode::testRank()
 
 }
 
-void TestNode::testMass()
-{
-    node_.m_ = 2.0;
-    node_.calcInvMass();
-    dbl_equals(node_.inv_m_, 1/2.0);
-}
-
 void TestNode::run()
 {
     testRank();
-    testMass();
 }
 
 int main(int argc, char *argv[])
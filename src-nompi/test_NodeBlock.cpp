@@ -0,0 +1,88 @@
+/*
+ * test_NodeBlock.cpp
+ */
+
+#include <TestBase.h>
+#include <NodeBlock.h>
+
+class TestNodeBlock : public TestBase {
+
+    /* test target */
+    NodeBlock block_;
+
+    Node nodes_[2];
+
+public:
+
+    void setup();
+    void testMass();
+    void testVelocityDelta();
+    void testMemory();
+    void run();
+};
+
+void TestNodeBlock::setup()
+{
+    std::vector<Node *> nodes;
+    nodes_[0].pos_.set(1, 2);
+    nodes_[1].pos_.set(3, 4);
+    nodes.push_back(&nodes_[0]);
+    nodes.push_back(&nodes_[1]);
+    block_.init(nodes);
+    size_equals(block_.num_nodes_, 2);
+    xy_equals(block_.pos_[1], VectorXY(3, 4));
+    xy_equals(block_.vel_[1], VectorXY(0, 0));
+}
+
+void TestNodeBlock::testMass()
+{
+    block_.m_[0] = 2.0;
+    block_.m_[1] = 4.0;
+    block_.calcInvMass();
+    dbl_equals(block_.inv_m_[0], 1/2.0);
+    dbl_equals(block_.inv_m_[1], 1/4.0);
+    block_.calcDtByM(0.1);
+    dbl_equals(block_.delta_t_by_m_[1], 0.1/4.0);
+    block_.clearMass();
+    dbl_equals(block_.m_[0], 0.0);
+}
+
+void TestNodeBlock::testVelocityDelta()
+{
+    block_.vel_[0].set(1, 1);
+    block_.d_vel_[0].set(0.5, -0.5);
+    block_.applyVelocityDeltaAndClear();
+    xy_equals(block_.vel_[0], VectorXY(1.5, 0.5));
+    xy_equals(block_.d_vel_[0], VectorXY(0, 0));
+    block_.clearVelocity();
+    xy_equals(block_.vel_[0], VectorXY(0, 0));
+
+    // moved_ を確保すると、速度補正がゼロでない節点を記録する
+    block_.moved_.assign(2, 0);
+    block_.d_vel_[1].set(0, 0.25);
+    block_.applyVelocityDeltaAndClear();
+    int_equals(block_.moved_[0], 0);
+    int_equals(block_.moved_[1], 1);
+    std::vector<uint8_t>().swap(block_.moved_);
+}
+
+void TestNodeBlock::testMemory()
+{
+    // 2節点 x (pos_, vel_, d_vel_ の16バイト + m_, inv_m_, delta_t_by_m_ の8バイト)
+    size_equals(block_.memoryBytes(), 2*(3*16 + 3*8));
+}
+
+void TestNodeBlock::run()
+{
+    setup();
+    testMass();
+    testVelocityDelta();
+    testMemory();
+}
+
+int main(int argc, char *argv[])
+{
+    TestNodeBlock test;
+    test.run();
+    return test.report();
+}
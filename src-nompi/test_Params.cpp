@@ -14,6 +14,8 @@ public:
     void run();
     void setup();
     void test();
+    // 省略可能な設定
+    void testOptions();
 };
 
 void TestParams::setup()
@@ -25,12 +27,72 @@ void TestParams::test()
 {
     // investigate results.
     dbl_equals(par_.re_, 10);
+    dbl_equals(par_.relaxation_, 1.0);
+    // 省略した設定は既定値になる
+    test_true(par_.convection_ == "recompute");
+    test_true(par_.precision_ == "double");
+    test_true(par_.storage_ == "full");
+    test_true(par_.renumber_ == "none");
+    test_true(par_.assembly_ == "scatter");
+    int_equals(par_.threads_, 1);
+    int_equals(par_.thread_chunk_, 512);
+    test_true(par_.thread_schedule_ == "dynamic");
+    test_true(par_.halo_overlap_ == "off");
+    test_true(par_.halo_exchange_ == "isend");
+    test_true(par_.convergence_check_ == "blocking");
+    int_equals(par_.convergence_interval_, 1);
+    test_true(par_.correction_async_ == "off");
+    test_true(par_.correction_order_ == "jacobi");
+    test_true(par_.active_set_ == "off");
+    int_equals(par_.active_set_recheck_, 16);
+    test_true(par_.relaxation_adaptive_ == "off");
+    test_true(par_.correction_acceleration_ == "off");
+    int_equals(par_.anderson_depth_, 5);
+    test_true(par_.correction_solver_ == "abmac");
+    test_true(par_.pcg_preconditioner_ == "jacobi");
+}
+
+void TestParams::testOptions()
+{
+    Params par;
+    par.init(0, 4, "testdata/params/case_options.txt");
+    test_true(par.convection_ == "precomputed");
+    test_true(par.precision_ == "mixed");
+    test_true(par.storage_ == "lean");
+    test_true(par.renumber_ == "rcm");
+    test_true(par.assembly_ == "gather");
+    int_equals(par.threads_, 4);
+    int_equals(par.thread_chunk_, 100);
+    test_true(par.thread_schedule_ == "stealing");
+    test_true(par.halo_overlap_ == "on");
+    test_true(par.halo_exchange_ == "persistent");
+    test_true(par.convergence_check_ == "pipelined");
+    int_equals(par.convergence_interval_, 4);
+    test_true(par.correction_async_ == "on");
+    test_true(par.correction_order_ == "multicolor");
+    test_true(par.active_set_ == "on");
+    int_equals(par.active_set_recheck_, 8);
+    test_true(par.relaxation_adaptive_ == "on");
+    test_true(par.correction_acceleration_ == "anderson");
+    int_equals(par.anderson_depth_, 3);
+    test_true(par.correction_solver_ == "pcg");
+    test_true(par.pcg_preconditioner_ == "ilu");
+
+    // 想定していない値はDataExceptionになる
+    bool thrown = false;
+    try {
+        par.init(0, 4, "testdata/params/case_bad_option.txt");
+    } catch (DataException &exp) {
+        thrown = true;
+    }
+    test_true(thrown);
 }
 
 void TestParams::run()
 {
     setup();
     test();
+    testOptions();
 }
 
 
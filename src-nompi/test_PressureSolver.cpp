@@ -0,0 +1,323 @@
+/*
+ * test_PressureSolver.cpp
+ */
+
+#include <TestBase.h>
+#include <PressureSolver.h>
+#include <ElementBlock.h>
+#include <NodeBlock.h>
+#include <QuadElement.h>
+#include <TestGrid.h>
+#include <cmath>
+
+class TestPressureSolver : public TestBase {
+
+    static const int NX = 12;
+    static const int NY = 8;
+
+    // 格子を2つのプロセスに分けたものとみなした一方の分
+    struct Part {
+        std::vector<Node *> node_list;
+        std::vector<QuadElement *> elem_list;
+        // 要素のローカルな番号 -> 格子全体での番号
+        std::vector<int> elements;
+        NodeBlock nodes;
+        ElementBlock block;
+        std::vector<uint8_t> fixed;
+        std::vector<int32_t> interface_nodes;
+        PressureSolver solver;
+    };
+
+    // NX x NY 要素の歪んだ格子
+    TestGrid grid_;
+
+    // 境界条件で速度を与える節点。要素 (0, 0) は四隅がすべてそうなる
+    static bool isFixed(int i, int j) { return i == 0 || j == 0 || (i == 1 && j == 1); }
+    // 格子の要素のうち、列 [i_begin, i_end) のものを part に取り出し、ループ不変量まで求める。
+    // 他の part と共有する節点の質量は、全体の要素から求めた値を使う
+    void makePart(int i_begin, int i_end, int threads, Part &part);
+    // 格子全体での節点の初期速度
+    static VectorXY initialVelocity(int k);
+    // 全要素の判別式の絶対値の最大値。四隅の節点の速度がすべて境界条件で与えられる要素は除く
+    double maxDiscriminant(const Part &part);
+    // 共有節点の速度変化量を送信バッファの代わりに sent に写す
+    static void gatherInterface(const Part &part, std::vector<VectorXY> &sent);
+    // 他の part の sent を共有節点の速度変化量に足す。共有節点は、どちらの part でも同じ列の節点を
+    // 下から順に並べている
+    static void distributeInterface(std::vector<Part *> &parts, const std::vector<std::vector<VectorXY> > &sent);
+    // part ごとに解いて、補正量を圧力と速度に反映し、反復数を返す。
+    // 共有節点の速度変化量と内積は、プロセス間の送受信と MPI_Allreduce の代わりにここで足し合わせる
+    int solve(std::vector<Part *> &parts, PressureSolver::Preconditioner preconditioner, int threads, double epsilon);
+
+public:
+
+    // 1つの part で解くと、判別式が閾値以下になる
+    void testSolve(PressureSolver::Preconditioner preconditioner, int threads);
+    // 2つの part に分けて解いても、Jacobi前処理なら1つの場合と同じ反復数と補正量になる
+    void testSplit();
+    void run();
+};
+
+VectorXY TestPressureSolver::initialVelocity(int k)
+{
+    return VectorXY(0.3*std::sin(1.0*k), 0.2*std::cos(0.7*k));
+}
+
+void TestPressureSolver::makePart(int i_begin, int i_end, int threads, Part &part)
+{
+    int i, j, c;
+    size_t k;
+    // 節点の全体での番号 -> part でのローカルな番号
+    std::vector<int> local(grid_.nodes_.size(), -1);
+    for (j = 0; j < NY; j++) {
+        for (i = i_begin; i < i_end; i++) {
+            QuadElement &elem = grid_.elems_[j*NX + i];
+            for (c = 0; c < 4; c++) {
+                int global = elem.nodes_[c] - &grid_.nodes_[0];
+                if (local[global] < 0) {
+                    local[global] = part.node_list.size();
+                    part.node_list.push_back(elem.nodes_[c]);
+                }
+            }
+            part.elem_list.push_back(&elem);
+            part.elements.push_back(j*NX + i);
+        }
+    }
+    for (k = 0; k < part.node_list.size(); k++) {
+        part.node_list[k]->local_index_ = k;
+    }
+    part.nodes.init(part.node_list);
+    part.block.init(part.elem_list);
+    if (threads > 1) {
+        part.block.colorElements(8);
+    }
+    part.block.num_threads_ = threads;
+    part.block.calcInvariants1(part.nodes, 10.0);
+
+    // 質量は全体の要素から求め直す (プロセス間の質量の送受信の代わり)
+    std::vector<double> mass(grid_.nodes_.size(), 0.0);
+    {
+        // part が書き換えた local_index_ を格子全体での番号に戻す
+        for (k = 0; k < grid_.nodes_.size(); k++) {
+            grid_.nodes_[k].local_index_ = k;
+        }
+        NodeBlock all;
+        ElementBlock all_block;
+        all.init(grid_.node_list_);
+        all_block.init(grid_.elem_list_);
+        all_block.calcInvariants1(all, 10.0);
+        for (k = 0; k < grid_.nodes_.size(); k++) {
+            mass[k] = all.m_[k];
+        }
+    }
+    part.fixed.assign(part.node_list.size(), 0);
+    for (k = 0; k < part.node_list.size(); k++) {
+        int global = part.node_list[k] - &grid_.nodes_[0];
+        part.nodes.m_[k] = mass[global];
+        part.nodes.vel_[k] = initialVelocity(global);
+        if (isFixed(global % (NX+1), global / (NX+1))) {
+            part.fixed[k] = 1;
+        }
+        // 分けた境界の列の節点は、両方の part が持つ
+        int column = global % (NX+1);
+        if ((column == i_begin && i_begin > 0) || (column == i_end && i_end < NX)) {
+            part.interface_nodes.push_back(k);
+        }
+    }
+    part.nodes.calcInvMass();
+    part.nodes.calcDtByM(0.01);
+    part.block.calcInvariants2(part.nodes, 0.01, 0.5);
+}
+
+double TestPressureSolver::maxDiscriminant(const Part &part)
+{
+    double D_max = 0;
+    for (size_t e = 0; e < part.block.num_elements_; e++) {
+        double s = 0;
+        bool all_fixed = true;
+        for (int i = 0; i < 4; i++) {
+            int32_t k = part.block.nodes_[4*e + i];
+            const VectorXY &vel = part.nodes.vel_[k];
+            s += 0.5*part.block.a_Ny_[4*e + i]*vel.x_ - 0.5*part.block.a_Nx_[4*e + i]*vel.y_;
+            if (!part.fixed[k]) {
+                all_fixed = false;
+            }
+        }
+        if (!all_fixed) {
+            D_max = std::max(D_max, std::fabs(s / part.block.size_[e]));
+        }
+    }
+    return D_max;
+}
+
+void TestPressureSolver::gatherInterface(const Part &part, std::vector<VectorXY> &sent)
+{
+    sent.clear();
+    for (size_t j = 0; j < part.interface_nodes.size(); j++) {
+        sent.push_back(part.nodes.d_vel_[part.interface_nodes[j]]);
+    }
+}
+
+void TestPressureSolver::distributeInterface(std::vector<Part *> &parts, const std::vector<std::vector<VectorXY> > &sent)
+{
+    for (size_t n = 0; n < parts.size(); n++) {
+        Part &part = *parts[n];
+        for (size_t m = 0; m < parts.size(); m++) {
+            for (size_t j = 0; m != n && j < part.interface_nodes.size(); j++) {
+                VectorXY &d_vel = part.nodes.d_vel_[part.interface_nodes[j]];
+                d_vel.x_ += sent[m][j].x_;
+                d_vel.y_ += sent[m][j].y_;
+            }
+        }
+    }
+}
+
+int TestPressureSolver::solve(std::vector<Part *> &parts, PressureSolver::Preconditioner preconditioner,
+        int threads, double epsilon)
+{
+    size_t n;
+    std::vector<double> dots(PressureSolver::numDots()), sum(dots.size());
+    for (n = 0; n < parts.size(); n++) {
+        parts[n]->solver.assemble(parts[n]->block, parts[n]->nodes, parts[n]->fixed, parts[n]->interface_nodes,
+                preconditioner, threads);
+    }
+
+    std::fill(sum.begin(), sum.end(), 0.0);
+    for (n = 0; n < parts.size(); n++) {
+        parts[n]->solver.begin(parts[n]->block, parts[n]->nodes, epsilon, dots.data());
+        sum[0] += dots[0];
+        sum[1] += dots[1];
+    }
+    int i;
+    bool breakdown = false;
+    for (i = 0; i < 1000 && sum[1] > 0; i++) {
+        std::vector<std::vector<VectorXY> > sent(parts.size());
+        for (n = 0; n < parts.size(); n++) {
+            Part &part = *parts[n];
+            part.solver.nextDirection(sum.data());
+            part.solver.scatterInterface(part.nodes);
+            gatherInterface(part, sent[n]);
+            part.solver.multiplyLocal(part.nodes);
+        }
+        distributeInterface(parts, sent);
+        double pq = 0;
+        for (n = 0; n < parts.size(); n++) {
+            parts[n]->solver.multiplyInterface(parts[n]->nodes, dots.data());
+            pq += dots[0];
+        }
+        std::fill(sum.begin(), sum.end(), 0.0);
+        for (n = 0; n < parts.size(); n++) {
+            if (!parts[n]->solver.update(&pq, epsilon, dots.data())) {
+                breakdown = true;
+            }
+            sum[0] += dots[0];
+            sum[1] += dots[1];
+        }
+        if (breakdown) {
+            break;
+        }
+    }
+    test_false(breakdown);
+
+    // 補正量を反映する。共有節点の速度変化量は他の part の分も足し、境界条件で与えた速度は元に戻す
+    std::vector<std::vector<VectorXY> > sent(parts.size());
+    for (n = 0; n < parts.size(); n++) {
+        parts[n]->block.addPressureDelta(parts[n]->nodes, parts[n]->solver.solution());
+        gatherInterface(*parts[n], sent[n]);
+    }
+    distributeInterface(parts, sent);
+    for (n = 0; n < parts.size(); n++) {
+        Part &part = *parts[n];
+        part.nodes.applyVelocityDeltaAndClear();
+        for (size_t k = 0; k < part.node_list.size(); k++) {
+            if (part.fixed[k]) {
+                part.nodes.vel_[k] = initialVelocity(part.node_list[k] - &grid_.nodes_[0]);
+            }
+        }
+    }
+    return i;
+}
+
+void TestPressureSolver::testSolve(PressureSolver::Preconditioner preconditioner, int threads)
+{
+    const double epsilon = 1.0e-9;
+    Part part;
+    makePart(0, NX, threads, part);
+    std::vector<Part *> parts(1, &part);
+    double D_before = maxDiscriminant(part);
+    int iterations = solve(parts, preconditioner, threads, epsilon);
+    double D_after = maxDiscriminant(part);
+    size_equals(part.solver.numFixedElements(), 1);
+    size_equals(part.solver.numInterfaceNodes(), 0);
+    test_true(D_before > 1.0e-3);
+    // 漸化式で更新した残差と、反映した速度から求め直した判別式の丸め誤差の差を見込む
+    test_true(D_after < 2 * epsilon);
+    // 共役勾配法は要素数以下の反復で収束する
+    test_true(iterations > 0 && iterations < NX*NY);
+    // 四隅の節点の速度が与えられる要素の圧力は変えない
+    dbl_equals(part.block.p_[0], 0.0);
+}
+
+void TestPressureSolver::testSplit()
+{
+    const double epsilon = 1.0e-9;
+    Part whole, left, right;
+    makePart(0, NX, 1, whole);
+    makePart(0, NX/2, 1, left);
+    makePart(NX/2, NX, 1, right);
+    size_equals(left.interface_nodes.size(), NY+1);
+    size_equals(right.interface_nodes.size(), NY+1);
+
+    std::vector<Part *> one(1, &whole);
+    std::vector<Part *> two;
+    two.push_back(&left);
+    two.push_back(&right);
+    int whole_iterations = solve(one, PressureSolver::PRECONDITIONER_JACOBI, 1, epsilon);
+    int split_iterations = solve(two, PressureSolver::PRECONDITIONER_JACOBI, 1, epsilon);
+    int_equals(split_iterations, whole_iterations);
+    // 境界条件で速度を与える節点は共有節点から外す
+    size_equals(left.solver.numInterfaceNodes(), NY);
+
+    // 全体での要素番号で圧力を比べる
+    bool same = true;
+    for (size_t n = 0; n < two.size(); n++) {
+        for (size_t e = 0; e < two[n]->elements.size(); e++) {
+            double p = two[n]->block.p_[e];
+            double expected = whole.block.p_[two[n]->elements[e]];
+            if (std::fabs(p - expected) > 1.0e-9 * (1 + std::fabs(expected))) {
+                same = false;
+            }
+        }
+    }
+    test_true(same);
+    test_true(maxDiscriminant(left) < 2 * epsilon);
+    test_true(maxDiscriminant(right) < 2 * epsilon);
+
+    // ILU(0) は part ごとの分解になるので反復数は変わるが、同じ閾値まで収束する
+    Part left_ilu, right_ilu;
+    makePart(0, NX/2, 1, left_ilu);
+    makePart(NX/2, NX, 1, right_ilu);
+    std::vector<Part *> two_ilu;
+    two_ilu.push_back(&left_ilu);
+    two_ilu.push_back(&right_ilu);
+    int ilu_iterations = solve(two_ilu, PressureSolver::PRECONDITIONER_ILU, 1, epsilon);
+    test_true(ilu_iterations < split_iterations);
+    test_true(maxDiscriminant(left_ilu) < 2 * epsilon);
+    test_true(maxDiscriminant(right_ilu) < 2 * epsilon);
+}
+
+void TestPressureSolver::run()
+{
+    grid_.make(NX, NY);
+    testSolve(PressureSolver::PRECONDITIONER_JACOBI, 1);
+    testSolve(PressureSolver::PRECONDITIONER_ILU, 1);
+    testSolve(PressureSolver::PRECONDITIONER_JACOBI, 3);
+    testSplit();
+}
+
+int main(int argc, char *argv[])
+{
+    TestPressureSolver test;
+    test.run();
+    return test.report();
+}
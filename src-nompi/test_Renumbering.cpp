@@ -0,0 +1,146 @@
+/*
+ * test_Renumbering.cpp
+ */
+
+#include <TestBase.h>
+#include <Renumbering.h>
+#include <algorithm>
+
+class TestRenumbering : public TestBase {
+
+    // 4 x 3 要素の格子。節点番号はわざと飛び飛びに付ける。
+    static const int NX = 4;
+    static const int NY = 3;
+    static const size_t NUM_NODES = (NX+1)*(NY+1);
+
+    std::vector<int32_t> elem_nodes_;
+    std::vector<VectorXY> pos_;
+
+    bool isPermutation(const std::vector<int32_t> &order, size_t n);
+
+public:
+
+    void setup();
+    void testInverse();
+    void testRcm();
+    void testHilbert();
+    void testMeasure();
+    void run();
+};
+
+bool TestRenumbering::isPermutation(const std::vector<int32_t> &order, size_t n)
+{
+    std::vector<int32_t> sorted(order);
+    std::sort(sorted.begin(), sorted.end());
+    if (sorted.size() != n) {
+        return false;
+    }
+    for (size_t k = 0; k < n; k++) {
+        if (sorted[k] != (int32_t)k) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TestRenumbering::setup()
+{
+    int i, j;
+    // 格子点 (i, j) の節点番号は (7*(j*(NX+1) + i)) % 20
+    pos_.resize(NUM_NODES);
+    for (j = 0; j <= NY; j++) {
+        for (i = 0; i <= NX; i++) {
+            pos_[(7*(j*(NX+1) + i)) % NUM_NODES].set(i, j);
+        }
+    }
+    for (j = 0; j < NY; j++) {
+        for (i = 0; i < NX; i++) {
+            elem_nodes_.push_back((7*(j*(NX+1) + i)) % NUM_NODES);
+            elem_nodes_.push_back((7*(j*(NX+1) + i + 1)) % NUM_NODES);
+            elem_nodes_.push_back((7*((j+1)*(NX+1) + i + 1)) % NUM_NODES);
+            elem_nodes_.push_back((7*((j+1)*(NX+1) + i)) % NUM_NODES);
+        }
+    }
+}
+
+void TestRenumbering::testInverse()
+{
+    std::vector<int32_t> order;
+    order.push_back(2);
+    order.push_back(0);
+    order.push_back(1);
+    std::vector<int32_t> inv = Renumbering::inverse(order);
+    int_equals(inv[0], 1);
+    int_equals(inv[1], 2);
+    int_equals(inv[2], 0);
+}
+
+void TestRenumbering::testRcm()
+{
+    std::vector<int32_t> node_order = Renumbering::rcmNodeOrder(NUM_NODES, elem_nodes_);
+    test_true(isPermutation(node_order, NUM_NODES));
+    std::vector<int32_t> element_order = Renumbering::elementOrderByNodes(NUM_NODES, node_order, elem_nodes_);
+    test_true(isPermutation(element_order, NY*NX));
+
+    // 新しい番号で要素を組み直すと帯幅が小さくなる
+    std::vector<int32_t> new_index = Renumbering::inverse(node_order);
+    std::vector<int32_t> renumbered;
+    for (size_t k = 0; k < element_order.size(); k++) {
+        for (int i = 0; i < 4; i++) {
+            renumbered.push_back(new_index[elem_nodes_[4*element_order[k] + i]]);
+        }
+    }
+    int before = Renumbering::measure(NUM_NODES, elem_nodes_, 64).bandwidth_;
+    int after = Renumbering::measure(NUM_NODES, renumbered, 64).bandwidth_;
+    test_true(after < before);
+    // 飛び飛びの番号では節点数程度、RCM では短い辺の節点数の2倍以下
+    test_true(before > (int)NUM_NODES / 2);
+    test_true(after <= 2*(NY+1));
+}
+
+void TestRenumbering::testHilbert()
+{
+    std::vector<int32_t> element_order = Renumbering::hilbertElementOrder(elem_nodes_, pos_);
+    test_true(isPermutation(element_order, NY*NX));
+    // Hilbert曲線の順に並んだ要素は、隣り合う要素の重心の距離が1 (隣接する要素)
+    for (size_t k = 1; k < element_order.size(); k++) {
+        VectorXY c0 = pos_[elem_nodes_[4*element_order[k-1]]];
+        VectorXY c1 = pos_[elem_nodes_[4*element_order[k]]];
+        dbl_equals((c1 - c0).norm(), 1.0);
+    }
+    std::vector<int32_t> node_order = Renumbering::nodeOrderByElements(NUM_NODES, element_order, elem_nodes_);
+    test_true(isPermutation(node_order, NUM_NODES));
+    // 最初の要素の四隅が先頭に並ぶ
+    int_equals(node_order[0], elem_nodes_[4*element_order[0]]);
+}
+
+void TestRenumbering::testMeasure()
+{
+    // 2要素で節点 0-5 を使う。1ラインに節点4つ。
+    std::vector<int32_t> elem_nodes;
+    int32_t n[] = {0, 1, 5, 4, 1, 2, 3, 5};
+    elem_nodes.assign(n, n + 8);
+    Renumbering::Locality loc = Renumbering::measure(6, elem_nodes, 64);
+    int_equals(loc.bandwidth_, 5);
+    dbl_equals(loc.mean_span_, 4.5);
+    // 1ラインしか入らない : 0(ミス) 1 5(ミス) 4 1(ミス) 2 3 5(ミス)
+    size_equals(loc.cache_misses_, 4);
+    // 2ライン入れば最初の2回だけ
+    size_equals(Renumbering::measure(6, elem_nodes, 128).cache_misses_, 2);
+}
+
+void TestRenumbering::run()
+{
+    setup();
+    testInverse();
+    testRcm();
+    testHilbert();
+    testMeasure();
+}
+
+int main(int argc, char *argv[])
+{
+    TestRenumbering test;
+    test.run();
+    return test.report();
+}
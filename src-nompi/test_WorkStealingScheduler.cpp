@@ -0,0 +1,144 @@
+/*
+ * test_WorkStealingScheduler.cpp
+ */
+
+#include <TestBase.h>
+#include <WorkStealingScheduler.h>
+#include <vector>
+
+class TestWorkStealingScheduler : public TestBase {
+
+    static const int NUM_THREADS = 4;
+    static const size_t NUM_TASKS = 1000;
+
+    // タスクkを実行した回数を数える。タスクごとの重さは k % 7 で変える。
+    struct CountTask {
+        std::vector<int> &count_;
+        CountTask(std::vector<int> &count) : count_(count) {}
+        void operator()(size_t k) {
+            volatile double x = 0;
+            for (size_t j = 0; j < 1000 * (k % 7); j++) {
+                x += 1.0;
+            }
+            count_[k]++;
+        }
+    };
+
+    // 前の run() の結果を逆順に読む
+    struct ReverseTask {
+        const std::vector<int> &src_;
+        std::vector<int> &dst_;
+        ReverseTask(const std::vector<int> &src, std::vector<int> &dst) : src_(src), dst_(dst) {}
+        void operator()(size_t k) {
+            dst_[k] = src_[src_.size() - 1 - k] + 1;
+        }
+    };
+
+    size_t totalTasks(const WorkStealingScheduler &scheduler);
+
+public:
+
+    void testRunAll();
+    void testRunInOrder();
+    void testBarrier();
+    void run();
+};
+
+size_t TestWorkStealingScheduler::totalTasks(const WorkStealingScheduler &scheduler)
+{
+    size_t total = 0;
+    for (int t = 0; t < scheduler.maxThreads(); t++) {
+        total += scheduler.counters(t).tasks_;
+    }
+    return total;
+}
+
+void TestWorkStealingScheduler::testRunAll()
+{
+    // どのタスクもちょうど1回ずつ実行される
+    WorkStealingScheduler scheduler;
+    scheduler.init(NUM_THREADS);
+    int_equals(scheduler.maxThreads(), NUM_THREADS);
+    std::vector<int> count(NUM_TASKS, 0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(NUM_THREADS)
+#endif
+    {
+        CountTask task(count);
+        scheduler.run(NUM_TASKS, task);
+        scheduler.run(0, task);
+    }
+    bool once = true;
+    for (size_t k = 0; k < NUM_TASKS; k++) {
+        if (count[k] != 1) {
+            once = false;
+        }
+    }
+    test_true(once);
+    size_equals(totalTasks(scheduler), NUM_TASKS);
+    for (int t = 0; t < NUM_THREADS; t++) {
+        test_true(scheduler.counters(t).busy_ >= 0);
+        test_true(scheduler.counters(t).idle_ >= 0);
+    }
+
+    scheduler.clearCounters();
+    size_equals(totalTasks(scheduler), 0);
+}
+
+void TestWorkStealingScheduler::testRunInOrder()
+{
+    // 並列領域の外 (1スレッド) では番号順に実行し、盗むことはない
+    WorkStealingScheduler scheduler;
+    std::vector<int> src(10, 0), dst(10, 0);
+    for (size_t k = 0; k < src.size(); k++) {
+        src[k] = k;
+    }
+    ReverseTask task(src, dst);
+    scheduler.run(10, task);
+    int_equals(dst[0], 10);
+    int_equals(dst[9], 1);
+    size_equals(scheduler.counters(0).tasks_, 10);
+    size_equals(scheduler.counters(0).steals_, 0);
+}
+
+void TestWorkStealingScheduler::testBarrier()
+{
+    // run() から戻った時点で全スレッドのタスクが終わっているので、
+    // 次の run() で他のスレッドの結果を読める
+    WorkStealingScheduler scheduler;
+    scheduler.init(NUM_THREADS);
+    std::vector<int> a(NUM_TASKS, 0), b(NUM_TASKS, 0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(NUM_THREADS)
+#endif
+    {
+        ReverseTask forward(b, a);
+        ReverseTask backward(a, b);
+        for (int r = 0; r < 5; r++) {
+            scheduler.run(NUM_TASKS, forward);
+            scheduler.run(NUM_TASKS, backward);
+        }
+    }
+    bool ok = true;
+    for (size_t k = 0; k < NUM_TASKS; k++) {
+        if (b[k] != 10) {
+            ok = false;
+        }
+    }
+    test_true(ok);
+    size_equals(totalTasks(scheduler), 10 * NUM_TASKS);
+}
+
+void TestWorkStealingScheduler::run()
+{
+    testRunAll();
+    testRunInOrder();
+    testBarrier();
+}
+
+int main(int argc, char *argv[])
+{
+    TestWorkStealingScheduler test;
+    test.run();
+    return test.report();
+}